@@ -23,12 +23,14 @@ struct cli_options_s;   // Forward declaration of CLIOptions structure
 struct build_context_s; // Forward declaration of BuildContext structure
 struct build_config_s;  // Forward declaration of build_config_s structure
 struct build_target_s;  // Forward declaration of BuildTarget structure
+struct exec_job_s;      // Forward declaration of ExecJob structure
 
 typedef struct cli_state_s *CLIState;         // CLIState is the structure that holds the state of the command line interface
 typedef struct cli_options_s *CLIOptions;     // CLIOptions is the structure that holds the command line options
 typedef struct build_context_s *BuildContext; // BuildContext is the structure that holds the build context for the application
 typedef struct build_config_s *BuildConfig;   // BuildConfig is a pointer to the build_config_s structure
 typedef struct build_target_s *BuildTarget;   // BuildTarget is a pointer to the build_target_s structure
+typedef struct exec_job_s *ExecJob;           // ExecJob is a pointer to the exec_job_s structure
 
 #define SB_TRUE 1                // Boolean true value
 #define SB_FALSE 0               // Boolean false value
@@ -98,10 +100,23 @@ typedef struct cli_options_s {
    int show_help;          // Flag to indicate if help should be displayed
    int show_about;         // Flag to indicate if about information should be displayed
    string config_file;     // Path to the configuration file
-   string target_name;     // Name of the target to build
+   string *target_names;   // NULL-terminated names of the targets to build (NULL = default target)
+   string *variant_names;  // NULL-terminated names of the variants to build (NULL = every variant)
+   string file_path;       // Source or output file to build on its own (NULL = whole targets)
+   int is_pch_report;      // Report precompiled header candidates instead of building
+   int is_watch;           // Keep rebuilding as watched files change
+   int is_daemon;          // Serve builds from a resident build server
+   int is_git_index;       // Detect changes of tracked inputs through the git index
+   string cache_dir;       // Object cache directory ("": default location; NULL: no cache)
+   string remote_cache;    // Remote cache URL (NULL: none)
+   int cache_port;         // Port to serve the cache directory on instead of building (0 = build)
+   int is_lazy_objects;    // Leave cached objects in the cache until an action that runs reads them
    LogLevel log_level;     // Logging level for the application
    DebugLevel debug_level; // Debug level for the application
    int is_verbose;         // Flag for verbose logging (only observed with --about && --help)
+   int max_jobs;           // Maximum number of parallel jobs (0 = online CPUs)
+   int max_failures;       // Failed actions tolerated before stopping (1 = fail-fast, 0 = keep going)
+   int watchdog;           // Report actions running longer than this multiple of their usual duration (0 = off)
    FILE *log_stream;       // Stream for logging output
 } cli_options_s;
 /**
@@ -127,6 +142,13 @@ typedef struct build_context_s {
    char *current_target;     // Name of the current target being built
    char *config_file;        // Configuration being used
    BuildConfig config;       // Current Build Configuration
+   int max_jobs;             // Maximum number of parallel jobs (0 = online CPUs)
+   int max_failures;         // Failed actions tolerated before stopping (1 = fail-fast, 0 = keep going)
+   int watchdog;             // Report actions running longer than this multiple of their usual duration (0 = off)
+   int is_git_index;         // Detect changes of tracked inputs through the git index
+   const char *cache_dir;    // Object cache directory ("": default location; NULL: no cache)
+   const char *remote_cache; // Remote cache URL (NULL: none)
+   int is_lazy_objects;      // Leave cached objects in the cache until an action that runs reads them
    object data;              // Pointer to any additional data structure
 } build_context_s;
 
@@ -136,6 +158,23 @@ typedef struct build_context_s {
  * @param format :strftime format string (e.g., "%Y-%m-%dT%H:%M:%S")
  */
 void get_timestamp(char *, const char *);
+/**
+ * @brief Gets the current monotonic time in milliseconds (for durations and deadlines)
+ * @return :milliseconds since an arbitrary fixed point
+ */
+long get_monotonic_ms(void);
+/**
+ * @brief Computes a 64-bit FNV-1a hash of a string (command signatures, table keys)
+ * @param str :the string to hash
+ * @return :the hash value
+ */
+uint64_t get_string_hash(const char *);
+/**
+ * @brief Computes a 64-bit FNV-1a hash of an argument vector (argument boundaries included)
+ * @param argv :the NULL-terminated argument vector
+ * @return :the hash value
+ */
+uint64_t get_argv_hash(char **);
 
 /**
  * @brief Logger interface for writing messages to the context log stream.
@@ -238,6 +277,7 @@ typedef struct IResources {
  */
 typedef struct IFiles {
    size_t (*read)(const char *, char **); // Read file contents to buffer returning number of bytes read
+   int (*make_dirs)(const char *);        // Create a directory and its parents (like `mkdir -p`); returns 1 on success
 } IFiles;
 
 /**
@@ -0,0 +1,788 @@
+/* src/core/action_graph.c
+ * Sigma.Build Action Graph
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * Lowering walks the requested targets depth-first, dependencies before dependents, so
+ * action ids form a topological order. Strings and fixed-size vectors live in an arena
+ * owned by the graph and are released together with it.
+ */
+#include "action_graph.h"
+#include "loader.h"
+#include "string_map.h"
+#include "toolchain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ARENA_CHUNK_SIZE 65536
+
+typedef struct arena_chunk_s {
+   struct arena_chunk_s *next; // Previously filled chunk
+   size_t used;                // Bytes handed out from data
+   size_t size;                // Capacity of data
+   char data[];                // Storage
+} arena_chunk_s;
+
+static action_graph_s *graph = NULL;  // Graph being lowered
+static BuildConfig config = NULL;     // Configuration the targets come from
+static StringMap target_map = NULL;   // Target name -> lowered target
+static StringMap output_map = NULL;   // Output path -> action producing it
+static StringMap compile_map = NULL;  // Compile identity -> action (identical compiles are shared)
+static StringMap claim_map = NULL;    // Object path -> identity of the first configured compile writing it
+static int is_planning = 0;           // Set while lowering for inspection: nothing is written
+static char root_dir[4096];           // Workspace root: the directory builds run in (empty if it is `/`)
+static const char *home_dir = NULL;   // $HOME (NULL if unset or the root itself)
+static char *root_map = NULL;         // `-ffile-prefix-map=<root>=.`
+static char *home_map = NULL;         // `-ffile-prefix-map=<home>=~` (NULL without a home)
+
+static int graph_claim_objects(BuildTarget *);
+static graph_target_s *graph_lower_target(BuildTarget);
+static int graph_lower_binary(graph_target_s *);
+static int graph_lower_compile(graph_target_s *, char *, const char *, char **);
+static int graph_lower_pch(graph_target_s *);
+static int graph_lower_unity(graph_target_s *, int *, int *);
+static int graph_lower_commands(graph_target_s *);
+static void graph_dispose(ActionGraph);
+
+/* Allocate zeroed storage that lives as long as the graph */
+static void *graph_alloc(size_t size) {
+   arena_chunk_s *chunk = (arena_chunk_s *)graph->arena;
+   size = (size + 7) & ~(size_t)7;
+   if (!chunk || chunk->used + size > chunk->size) {
+      size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+      addr chunk_addr;
+      if (!Resources.alloc(&chunk_addr, sizeof(arena_chunk_s) + chunk_size)) return NULL;
+      arena_chunk_s *fresh = (arena_chunk_s *)chunk_addr;
+      fresh->size = chunk_size;
+      fresh->next = chunk;
+      graph->arena = chunk = fresh;
+   }
+   void *block = chunk->data + chunk->used;
+   chunk->used += size;
+   return block;
+}
+/* Allocate `a` + `b` + `c` in the arena */
+static char *graph_concat(const char *a, const char *b, const char *c) {
+   size_t a_len = strlen(a), b_len = strlen(b), c_len = strlen(c);
+   char *result = graph_alloc(a_len + b_len + c_len + 1);
+   if (!result) return NULL;
+   memcpy(result, a, a_len);
+   memcpy(result + a_len, b, b_len);
+   memcpy(result + a_len + b_len, c, c_len + 1);
+
+   return result;
+}
+/* Object path for a source: `<build_dir><src with '/' as '_' and no extension><ext>` */
+static char *graph_object_path(const char *build_dir, const char *src, const char *ext) {
+   const char *dot = strrchr(src, '.');
+   const char *slash = strrchr(src, '/');
+   size_t dir_len = strlen(build_dir), base_len = dot && (!slash || dot > slash) ? (size_t)(dot - src) : strlen(src);
+   char *path = graph_alloc(dir_len + base_len + strlen(ext) + 1);
+   if (!path) return NULL;
+
+   memcpy(path, build_dir, dir_len);
+   for (size_t i = 0; i < base_len; i++) path[dir_len + i] = src[i] == '/' ? '_' : src[i];
+   strcpy(path + dir_len + base_len, ext);
+   return path;
+}
+
+/* Length of the root or home directory `arg` starts with (up to a path boundary); `alias` names it */
+static size_t graph_match_prefix(const char *arg, const char **alias) {
+   size_t len = strlen(root_dir);
+   if (len && strncmp(arg, root_dir, len) == 0 && (arg[len] == '/' || arg[len] == '=' || !arg[len])) {
+      *alias = ".";
+      return len;
+   }
+   len = home_dir ? strlen(home_dir) : 0;
+   if (len && strncmp(arg, home_dir, len) == 0 && (arg[len] == '/' || arg[len] == '=' || !arg[len])) {
+      *alias = "~";
+      return len;
+   }
+   return 0;
+}
+/* Hash an argument vector like get_argv_hash, with the root spelled `.` and home `~`: keys match across checkouts */
+static uint64_t graph_hash_argv(char **argv) {
+   uint64_t hash = 1469598103934665603ULL;
+   for (; argv && *argv; argv++) {
+      for (const char *c = *argv;; c++) {
+         // Paths start an argument, follow `=` or follow a short flag (`-I/...`)
+         int is_path_start = *c == '/' && (c == *argv || c[-1] == '=' || (c == *argv + 2 && **argv == '-'));
+         const char *alias = NULL;
+         size_t len = is_path_start ? graph_match_prefix(c, &alias) : 0;
+         if (len) {
+            for (; *alias; alias++) hash = (hash ^ (unsigned char)*alias) * 1099511628211ULL;
+            c += len - 1;
+            continue;
+         }
+         hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+         if (!*c) break;
+      }
+   }
+   return hash;
+}
+/* Record the workspace root and home, and the prefix maps that hide them from objects */
+static int graph_set_root(void) {
+   if (!getcwd(root_dir, sizeof(root_dir))) return SB_FALSE;
+   if (strcmp(root_dir, "/") == 0) root_dir[0] = '\0';
+   home_dir = getenv("HOME");
+   size_t home_len = home_dir ? strlen(home_dir) : 0;
+   if (home_len <= 1 || home_dir[home_len - 1] == '/' || strcmp(home_dir, root_dir) == 0) home_dir = NULL;
+
+   root_map = root_dir[0] ? graph_concat("-ffile-prefix-map=", root_dir, "=.") : NULL;
+   home_map = home_dir ? graph_concat("-ffile-prefix-map=", home_dir, "=~") : NULL;
+   return (root_map || !root_dir[0]) && (home_map || !home_dir);
+}
+
+/* Append a new action to the graph */
+static graph_action_s *graph_new_action(graph_target_s *target, ActionKind kind, string label) {
+   graph_action_s **grown = realloc(graph->actions, (graph->action_count + 1) * sizeof(graph_action_s *));
+   if (!grown) return NULL;
+   graph->actions = grown;
+
+   graph_action_s *action = graph_alloc(sizeof(graph_action_s));
+   if (!action) return NULL;
+   action->id = graph->action_count;
+   action->kind = kind;
+   action->target = target;
+   action->label = label;
+   graph->actions[graph->action_count++] = action;
+   return action;
+}
+/* Drop the most recently created action (superseded by an identical one) */
+static void graph_discard_action(graph_action_s *action) {
+   if (graph->action_count > 0 && graph->actions[graph->action_count - 1] == action) graph->action_count--;
+}
+/* Make an action wait for another (no-op for a missing dependency) */
+static int graph_add_dependency(graph_action_s *action, int dependency_id) {
+   if (dependency_id < 0) return SB_TRUE;
+
+   graph_action_s *dependency = graph->actions[dependency_id];
+   int *grown = realloc(dependency->dependents, (dependency->dependent_count + 1) * sizeof(int));
+   if (!grown) return SB_FALSE;
+   dependency->dependents = grown;
+   grown[dependency->dependent_count++] = action->id;
+   action->dependency_count++;
+
+   return SB_TRUE;
+}
+/* Make an action wait for the final action of each of its target's dependencies */
+static int graph_depend_on_targets(graph_action_s *action, graph_target_s *target) {
+   for (char **name = target->target->dependencies; name && *name; name++) {
+      graph_target_s *dependency = StringMaps.get(target_map, *name);
+      if (dependency && !graph_add_dependency(action, dependency->final)) return SB_FALSE;
+   }
+
+   return SB_TRUE;
+}
+/* Compute an argv action's signature and length, switching to a response file when too long */
+static int graph_sign_action(graph_action_s *action) {
+   action->signature = graph_hash_argv(action->argv);
+   // A compiler upgraded in place changes every compile and link it runs
+   Toolchain toolchain = action->kind == ACTION_COMPILE || action->kind == ACTION_LINK ? Toolchains.probe(action->argv[0]) : NULL;
+   if (toolchain) action->signature = (action->signature ^ toolchain->fingerprint) * 1099511628211ULL;
+   for (char **arg = action->argv; *arg; arg++) action->argv_len += strlen(*arg) + 1;
+   if (action->argv_len > GRAPH_RSP_THRESHOLD && action->output) {
+      return (action->rsp_arg = graph_concat("@", action->output, GRAPH_RSP_SUFFIX)) != NULL;
+   }
+   return SB_TRUE;
+}
+/* Find a target of the configuration by name */
+static BuildTarget graph_find_target(const char *name) {
+   for (BuildTarget *target = config ? config->targets : NULL; target && *target; target++) {
+      if (strcmp((*target)->name, name) == 0) return *target;
+   }
+
+   return NULL;
+}
+
+/* Lower the requested targets and their dependencies */
+static ActionGraph graph_lower(BuildConfig build_config, BuildTarget *targets) {
+   addr graph_addr;
+   if (!targets || !*targets || !Resources.alloc(&graph_addr, sizeof(action_graph_s))) return NULL;
+   graph = (action_graph_s *)graph_addr;
+   config = build_config;
+   target_map = StringMaps.create();
+   output_map = StringMaps.create();
+   compile_map = StringMaps.create();
+   claim_map = StringMaps.create();
+
+   int is_lowered = target_map && output_map && compile_map && claim_map && graph_set_root() && graph_claim_objects(targets);
+   for (BuildTarget *target = targets; is_lowered && *target; target++) {
+      is_lowered = graph_lower_target(*target) != NULL;
+   }
+   StringMaps.dispose(target_map);
+   StringMaps.dispose(output_map);
+   StringMaps.dispose(compile_map);
+   StringMaps.dispose(claim_map);
+   target_map = output_map = compile_map = claim_map = NULL;
+
+   action_graph_s *result = graph;
+   graph = NULL;
+   if (!is_lowered) {
+      graph_dispose(result);
+      return NULL;
+   }
+   return result;
+}
+/* Lower the requested targets without creating directories or writing unity files */
+static ActionGraph graph_plan(BuildConfig build_config, BuildTarget *targets) {
+   is_planning = 1;
+   ActionGraph planned = graph_lower(build_config, targets);
+   is_planning = 0;
+
+   return planned;
+}
+/* Lower a target after its dependencies; a target reached more than once is lowered once */
+static graph_target_s *graph_lower_target(BuildTarget target) {
+   if (!target || !target->name) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Invalid build target specified.\n");
+      return NULL; // Return error if target is NULL or has no name
+   }
+   graph_target_s *lowered = StringMaps.get(target_map, target->name);
+   if (lowered) {
+      if (!lowered->is_visiting) return lowered;
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Dependency cycle through target: %s\n", target->name);
+      return NULL;
+   }
+
+   if (!(lowered = graph_alloc(sizeof(graph_target_s))) || !StringMaps.put(target_map, target->name, lowered)) return NULL;
+   lowered->target = target;
+   lowered->final = -1;
+   lowered->pch = -1;
+
+   // Dependencies first: their final actions must exist before this target's actions wait on them
+   lowered->is_visiting = 1;
+   for (char **name = target->dependencies; name && *name; name++) {
+      BuildTarget dependency = graph_find_target(*name);
+      if (!dependency) {
+         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Unknown dependency %s of target %s\n", *name, target->name);
+         return NULL;
+      }
+      if (!graph_lower_target(dependency)) return NULL;
+   }
+   lowered->is_visiting = 0;
+
+   lowered->action_timeout_ms = target->action_timeout_ms;
+   if (lowered->action_timeout_ms == 0 && config) lowered->action_timeout_ms = config->action_timeout_ms;
+
+   int is_lowered = strcmp(target->type, TARGET_TYPE_OP) == 0 ? graph_lower_commands(lowered) : graph_lower_binary(lowered);
+   graph_target_s **grown = is_lowered ? realloc(graph->targets, (graph->target_count + 1) * sizeof(graph_target_s *)) : NULL;
+   if (!grown) return NULL;
+   graph->targets = grown;
+   lowered->id = graph->target_count;
+   graph->targets[graph->target_count++] = lowered;
+
+   return lowered;
+}
+/* Check whether a flag list contains a flag */
+static int graph_has_flag(char **flags, const char *flag) {
+   for (; flags && *flags; flags++) {
+      if (strcmp(*flags, flag) == 0) return SB_TRUE;
+   }
+   return SB_FALSE;
+}
+/* Check whether a lib target is of the given kind */
+static int graph_is_kind(BuildTarget target, const char *kind) {
+   return target->kind && strcmp(target->kind, kind) == 0;
+}
+/* Check whether a compiler understands -ffile-prefix-map (GCC 8+, Clang 10+) */
+static int graph_has_prefix_map(const char *compiler) {
+   Toolchain toolchain = Toolchains.probe(compiler);
+   const char *gcc = toolchain ? strstr(toolchain->version, "gcc version ") : NULL;
+   const char *clang = toolchain ? strstr(toolchain->version, "clang version ") : NULL;
+
+   return gcc ? atoi(gcc + strlen("gcc version ")) >= 8 : clang && atoi(clang + strlen("clang version ")) >= 10;
+}
+/* Format a target's compile template once (`compiler [prefix maps] c_flags... [-fPIC]`) and name its precompiled header */
+static int graph_make_template(graph_target_s *lowered) {
+   BuildTarget target = lowered->target;
+   int c_flag_count = 0;
+   for (char **flag = target->c_flags; flag && *flag; flag++) c_flag_count++;
+
+   // Objects name sources relative to the root (and home): checkouts build identical objects.
+   // The maps come first so a target's own prefix maps take precedence
+   char *maps[2];
+   int map_count = 0;
+   if (graph_has_prefix_map(target->compiler)) {
+      if (home_map) maps[map_count++] = home_map;
+      if (root_map) maps[map_count++] = root_map;
+   }
+   // Shared libraries get position-independent code without spelling it out
+   int needs_pic = graph_is_kind(target, TARGET_KIND_SHARED) && !graph_has_flag(target->c_flags, "-fPIC");
+   lowered->template_count = 1 + map_count + c_flag_count + needs_pic;
+   // Spare slots: `-include <pch>`, then a source and terminator while an identity is hashed
+   if (!(lowered->compile_template = graph_alloc((lowered->template_count + 4) * sizeof(char *)))) return SB_FALSE;
+   lowered->compile_template[0] = target->compiler;
+   if (map_count > 0) memcpy(lowered->compile_template + 1, maps, map_count * sizeof(char *));
+   if (c_flag_count > 0) memcpy(lowered->compile_template + 1 + map_count, target->c_flags, c_flag_count * sizeof(char *));
+   if (needs_pic) lowered->compile_template[lowered->template_count - 1] = "-fPIC";
+   if (!target->pch) return SB_TRUE;
+
+   // The precompiled header's directory hashes the bare template and the header: identical flags share it
+   char dir[40];
+   const char *name = strrchr(target->pch, '/');
+   lowered->compile_template[lowered->template_count] = target->pch;
+   snprintf(dir, sizeof(dir), GRAPH_PCH_PREFIX "%016llx/", (unsigned long long)graph_hash_argv(lowered->compile_template));
+   lowered->compile_template[lowered->template_count] = NULL;
+
+   return (lowered->pch_include = graph_concat(target->build_dir, dir, name ? name + 1 : target->pch)) != NULL;
+}
+/* Make every compile of the target force-include its precompiled header */
+static void graph_include_pch(graph_target_s *lowered) {
+   if (!lowered->pch_include) return;
+   lowered->compile_template[lowered->template_count++] = "-include";
+   lowered->compile_template[lowered->template_count++] = lowered->pch_include;
+}
+/* Identity of compiling `src` with the target's template: compiler, flags and source */
+static uint64_t graph_compile_identity(graph_target_s *lowered, char *src) {
+   lowered->compile_template[lowered->template_count] = src;
+   uint64_t identity = graph_hash_argv(lowered->compile_template);
+   lowered->compile_template[lowered->template_count] = NULL;
+
+   return identity;
+}
+/* Check whether an existing compile runs the target's template on `src` (guards against identity collisions) */
+static int graph_is_same_compile(graph_action_s *compile, graph_target_s *lowered, const char *src) {
+   graph_target_s *other = compile->target;
+   if (other->template_count != lowered->template_count || strcmp(compile->inputs[0], src) != 0) return SB_FALSE;
+   for (int i = 0; i < lowered->template_count; i++) {
+      if (strcmp(other->compile_template[i], lowered->compile_template[i]) != 0) return SB_FALSE;
+   }
+   return SB_TRUE;
+}
+/* Claim the object paths of a target's sources that no earlier target claimed */
+static int graph_claim_target(BuildTarget claimer) {
+   graph_target_s *templated = graph_alloc(sizeof(graph_target_s));
+   if (!templated) return SB_FALSE;
+   templated->target = claimer;
+   if (!graph_make_template(templated)) return SB_FALSE;
+   graph_include_pch(templated);
+
+   for (char **src = claimer->sources; src && *src; src++) {
+      char *object = graph_object_path(claimer->build_dir, *src, ".o");
+      if (!object) return SB_FALSE;
+      if (StringMaps.get(claim_map, object)) continue;
+      uint64_t *identity = graph_alloc(sizeof(uint64_t));
+      if (!identity || !StringMaps.put(claim_map, object, identity)) return SB_FALSE;
+      *identity = graph_compile_identity(templated, *src);
+   }
+   return SB_TRUE;
+}
+/* Add the build directories of a target and its dependencies to `dirs` (each target once) */
+static int graph_add_build_dirs(BuildTarget target, StringMap seen, const char ***dirs, int *count) {
+   if (!target || !target->name || StringMaps.get(seen, target->name)) return SB_TRUE;
+   if (!StringMaps.put(seen, target->name, target)) return SB_FALSE;
+   if (target->build_dir) {
+      const char **grown = realloc(*dirs, (*count + 1) * sizeof(char *));
+      if (!grown) return SB_FALSE;
+      *dirs = grown;
+      (*dirs)[(*count)++] = target->build_dir;
+   }
+   for (char **name = target->dependencies; name && *name; name++) {
+      if (!graph_add_build_dirs(graph_find_target(*name), seen, dirs, count)) return SB_FALSE;
+   }
+   return SB_TRUE;
+}
+/* Check whether objects of a build directory can have the paths of objects of any of `dirs`: one directory
+   starts the other, and the rest of the longer one is no deeper (object names hold no '/') */
+static int graph_shares_objects(const char *build_dir, const char **dirs, int count) {
+   size_t len = strlen(build_dir);
+   for (int i = 0; i < count; i++) {
+      size_t other_len = strlen(dirs[i]);
+      const char *rest = len < other_len ? dirs[i] + len : build_dir + other_len;
+      if (strncmp(build_dir, dirs[i], len < other_len ? len : other_len) == 0 && !strchr(rest, '/')) return SB_TRUE;
+   }
+   return SB_FALSE;
+}
+/* Claim each object path for the first configured target compiling it, so a source's object path
+   does not depend on which targets are requested. Only targets that can write objects where the
+   requested ones do are templated: a template probes its compiler */
+static int graph_claim_objects(BuildTarget *targets) {
+   StringMap seen = StringMaps.create();
+   const char **dirs = NULL;
+   int dir_count = 0, is_claimed = seen != NULL;
+   for (BuildTarget *target = targets; is_claimed && *target; target++) {
+      is_claimed = graph_add_build_dirs(*target, seen, &dirs, &dir_count);
+   }
+   StringMaps.dispose(seen);
+
+   for (BuildTarget *target = config ? config->targets : NULL; is_claimed && target && *target; target++) {
+      BuildTarget claimer = *target;
+      if (strcmp(claimer->type, TARGET_TYPE_OP) == 0 || claimer->unity_batch_size > 1 || !claimer->build_dir || !claimer->compiler) {
+         continue; // Unity objects are named after their batches; collisions there fall back to lowering order
+      }
+      if (!graph_shares_objects(claimer->build_dir, dirs, dir_count)) continue;
+      is_claimed = graph_claim_target(claimer);
+   }
+   free(dirs);
+   return is_claimed;
+}
+/* One compile action per source and a link (or archive) action depending on all of them */
+static int graph_lower_binary(graph_target_s *lowered) {
+   BuildTarget target = lowered->target;
+   if (!is_planning && (!Files.make_dirs(target->build_dir) || !Files.make_dirs(target->out_dir))) return SB_FALSE;
+
+   int src_count = 0, ld_flag_count = 0;
+   for (char **src = target->sources; src && *src; src++) src_count++;
+   for (char **flag = target->ld_flags; flag && *flag; flag++) ld_flag_count++;
+
+   // Shared libraries are linked with -shared without spelling it out
+   int is_static = graph_is_kind(target, TARGET_KIND_STATIC);
+   int needs_shared = graph_is_kind(target, TARGET_KIND_SHARED) && !graph_has_flag(target->ld_flags, "-shared");
+
+   // The header is precompiled with the bare template; every compile then force-includes it
+   if (!graph_make_template(lowered) || (target->pch && !graph_lower_pch(lowered))) return SB_FALSE;
+   graph_include_pch(lowered);
+
+   int *compiles = calloc(src_count + 1, sizeof(int));
+   if (!compiles) return SB_FALSE;
+   int is_lowered = SB_TRUE, compile_count = 0;
+   if (target->unity_batch_size > 1) {
+      is_lowered = graph_lower_unity(lowered, compiles, &compile_count);
+   } else {
+      for (int i = 0; is_lowered && i < src_count; i++) {
+         compiles[compile_count] = graph_lower_compile(lowered, target->sources[i], target->sources[i], NULL);
+         is_lowered = compiles[compile_count++] >= 0;
+      }
+   }
+
+   // Link (or archive) object files: argv and inputs point at the compiles' object paths, nothing is copied per object
+   graph_action_s *link = is_lowered ? graph_new_action(lowered, is_static ? ACTION_ARCHIVE : ACTION_LINK, target->name) : NULL;
+   char **argv = link ? graph_alloc((ld_flag_count + compile_count + 5) * sizeof(char *)) : NULL;
+   is_lowered = argv && (link->output = graph_concat(target->out_dir, target->output, "")) &&
+                (link->tmp_path = graph_concat(link->output, GRAPH_TMP_SUFFIX, "")) &&
+                (link->inputs = graph_alloc((compile_count + 1) * sizeof(char *)));
+   if (is_lowered) {
+      link->argv = argv;
+      if (is_static) {
+         *argv++ = target->archiver;
+         *argv++ = target->is_thin ? GRAPH_THIN_ARCHIVE_FLAGS : GRAPH_ARCHIVE_FLAGS;
+         *argv++ = link->tmp_path;
+         link->member_index = 3;
+      } else {
+         *argv++ = target->compiler;
+         if (ld_flag_count > 0) memcpy(argv, target->ld_flags, ld_flag_count * sizeof(char *));
+         argv += ld_flag_count;
+         if (needs_shared) *argv++ = "-shared";
+         *argv++ = "-o";
+         *argv++ = link->tmp_path;
+      }
+      for (int i = 0; is_lowered && i < compile_count; i++) {
+         link->inputs[i] = *argv++ = graph->actions[compiles[i]]->output;
+         is_lowered = graph_add_dependency(link, compiles[i]);
+      }
+      lowered->final = link->id;
+      is_lowered = is_lowered && graph_sign_action(link) && graph_depend_on_targets(link, lowered);
+   }
+   free(compiles);
+
+   return is_lowered;
+}
+/* Fill a compile's argv: the target's template, then depfile, temp output and source */
+static int graph_compile_argv(graph_target_s *lowered, graph_action_s *compile, char *src) {
+   char **argv = graph_alloc((lowered->template_count + 7) * sizeof(char *));
+   if (!argv) return SB_FALSE;
+   compile->argv = argv;
+   memcpy(argv, lowered->compile_template, lowered->template_count * sizeof(char *));
+   argv += lowered->template_count;
+   *argv++ = "-MMD";
+   *argv++ = "-MF";
+   *argv++ = compile->dep_path;
+   *argv++ = "-o";
+   *argv++ = compile->tmp_path;
+   *argv++ = src;
+   compile->inputs[0] = src;
+
+   return graph_sign_action(compile);
+}
+/* Compile `src` (a source or a unity file) to an object named after `key`; returns the action id or -1 */
+static int graph_lower_compile(graph_target_s *lowered, char *src, const char *key, char **inputs) {
+   BuildTarget target = lowered->target;
+   uint64_t identity = graph_compile_identity(lowered, src);
+   char identity_key[17];
+   snprintf(identity_key, sizeof(identity_key), "%016llx", (unsigned long long)identity);
+
+   // An identical compile already lowered for another target is shared, not run twice
+   graph_action_s *previous = StringMaps.get(compile_map, identity_key);
+   if (previous && graph_is_same_compile(previous, lowered, src)) return previous->id;
+
+   // The object is named after its source unless a different compile of it owns that path: then the
+   // identity goes into the name, so each variant keeps its own object and neither overwrites the other
+   char object_ext[16] = ".o", dep_ext[16] = ".d";
+   char *output = graph_object_path(target->build_dir, key, object_ext);
+   uint64_t *claim = output ? StringMaps.get(claim_map, output) : NULL;
+   if (output && ((claim && *claim != identity) || StringMaps.get(output_map, output))) {
+      snprintf(object_ext, sizeof(object_ext), ".%08x.o", (unsigned)identity);
+      snprintf(dep_ext, sizeof(dep_ext), ".%08x.d", (unsigned)identity);
+      output = graph_object_path(target->build_dir, key, object_ext);
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s compiles %s with its own flags into %s\n", target->name,
+                   src, output ? output : "");
+   }
+
+   // Compile to a temp file that is renamed into place on success; record header deps
+   graph_action_s *compile = output ? graph_new_action(lowered, ACTION_COMPILE, src) : NULL;
+   int is_lowered = compile && (compile->output = output) &&
+                    (compile->dep_path = graph_object_path(target->build_dir, key, dep_ext)) &&
+                    (compile->tmp_path = graph_concat(compile->output, GRAPH_TMP_SUFFIX, "")) &&
+                    (compile->inputs = inputs ? inputs : graph_alloc(3 * sizeof(char *))) &&
+                    graph_compile_argv(lowered, compile, src) && StringMaps.put(output_map, output, compile) &&
+                    (previous || StringMaps.put(compile_map, identity_key, compile));
+   if (!is_lowered) return -1;
+   // The precompiled header is an input too: its depfile does not show up in the compile's
+   if (lowered->pch >= 0) {
+      char **end = compile->inputs;
+      while (*end) end++;
+      *end = graph->actions[lowered->pch]->output;
+      if (!graph_add_dependency(compile, lowered->pch)) return -1;
+   }
+   return compile->id;
+}
+/* Precompile the target's header once; targets with identical flags get the same path and share the action */
+static int graph_lower_pch(graph_target_s *lowered) {
+   BuildTarget target = lowered->target;
+   size_t dir_len = strrchr(lowered->pch_include, '/') - lowered->pch_include + 1;
+   char *pch_dir = graph_alloc(dir_len + 1);
+   if (!pch_dir) return SB_FALSE;
+   memcpy(pch_dir, lowered->pch_include, dir_len);
+   if (!is_planning && !Files.make_dirs(pch_dir)) return SB_FALSE;
+
+   graph_action_s *pch = graph_new_action(lowered, ACTION_COMPILE, target->pch);
+   int is_lowered = pch && (pch->output = graph_concat(lowered->pch_include, GRAPH_PCH_SUFFIX, "")) &&
+                    (pch->dep_path = graph_concat(lowered->pch_include, ".d", "")) &&
+                    (pch->tmp_path = graph_concat(pch->output, GRAPH_TMP_SUFFIX, "")) &&
+                    (pch->inputs = graph_alloc(2 * sizeof(char *))) && graph_compile_argv(lowered, pch, target->pch);
+   if (!is_lowered) return SB_FALSE;
+
+   graph_action_s *previous = StringMaps.get(output_map, pch->output);
+   if (previous && previous->signature == pch->signature) {
+      graph_discard_action(pch);
+      pch = previous;
+   } else if (!StringMaps.put(output_map, pch->output, pch)) {
+      return SB_FALSE;
+   }
+   lowered->pch = pch->id;
+   return SB_TRUE;
+}
+/* Length of a path's directory part (0 for a file in the working directory) */
+static size_t graph_dir_length(const char *path) {
+   const char *slash = strrchr(path, '/');
+   return slash ? (size_t)(slash - path) : 0;
+}
+/* Check whether two paths are in the same directory */
+static int graph_is_same_dir(const char *a, const char *b) {
+   size_t dir_len = graph_dir_length(a);
+   return graph_dir_length(b) == dir_len && strncmp(a, b, dir_len) == 0;
+}
+/* Extension of the unity file a source can be batched into: `.c` for C, its own for C++ (NULL: compiled on its own) */
+static const char *graph_unity_ext(const char *src) {
+   static const char *exts[] = {".c", ".cc", ".cp", ".cxx", ".cpp", ".CPP", ".c++", ".C", NULL};
+   const char *ext = strrchr(src, '.');
+   for (const char **known = exts; ext && *known; known++) {
+      if (strcmp(ext, *known) == 0) return *known;
+   }
+   return NULL;
+}
+/* Check whether two sources can share a unity file: same directory and same language (spelled the same) */
+static int graph_is_same_batch(const char *a, const char *b) {
+   return graph_is_same_dir(a, b) && strcmp(graph_unity_ext(a), graph_unity_ext(b)) == 0;
+}
+/* Order sources by directory, then by extension, then by path, so batches stay the same while files are edited */
+static int graph_compare_sources(const void *a, const void *b) {
+   const char *x = *(char *const *)a, *y = *(char *const *)b;
+   size_t x_dir = graph_dir_length(x), y_dir = graph_dir_length(y);
+   int order = memcmp(x, y, x_dir < y_dir ? x_dir : y_dir);
+   if (order == 0) order = (x_dir > y_dir) - (x_dir < y_dir);
+   if (order == 0) order = strcmp(graph_unity_ext(x), graph_unity_ext(y));
+
+   return order != 0 ? order : strcmp(x, y);
+}
+/* Check whether a unity target excludes a source from its batches */
+static int graph_is_excluded(BuildTarget target, const char *src) {
+   if (strncmp(src, "./", 2) == 0) src += 2;
+   for (char **excluded = target->unity_exclude; excluded && *excluded; excluded++) {
+      const char *path = strncmp(*excluded, "./", 2) == 0 ? *excluded + 2 : *excluded;
+      if (strcmp(path, src) == 0) return SB_TRUE;
+   }
+   return SB_FALSE;
+}
+/* Split a path (relative to the workspace root unless absolute) into its components, dropping `.` and applying `..`;
+ * returns the component count, or -1 if it does not fit */
+static int graph_split_path(const char *path, char *buffer, size_t size, char **parts, int max_parts) {
+   int len = snprintf(buffer, size, "%s%s%s", path[0] == '/' ? "" : root_dir, path[0] == '/' ? "" : "/", path);
+   if (len < 0 || (size_t)len >= size) return -1;
+
+   int count = 0;
+   char *save = NULL;
+   for (char *part = strtok_r(buffer, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+      if (strcmp(part, ".") == 0) continue;
+      if (strcmp(part, "..") == 0) {
+         if (count > 0) count--;
+         continue;
+      }
+      if (count == max_parts) return -1;
+      parts[count++] = part;
+   }
+   return count;
+}
+/* Path of a member relative to the unity file's directory; returns 0 if it does not fit */
+static int graph_unity_member(const char *unity, const char *member, char *path, size_t size) {
+   char unity_buffer[4096], member_buffer[4096];
+   char *unity_parts[256], *member_parts[256];
+   int unity_count = graph_split_path(unity, unity_buffer, sizeof(unity_buffer), unity_parts, 256) - 1; // Its directory
+   int member_count = graph_split_path(member, member_buffer, sizeof(member_buffer), member_parts, 256);
+   if (unity_count < 0 || member_count < 1) return SB_FALSE;
+
+   int common = 0;
+   while (common < unity_count && common < member_count - 1 && strcmp(unity_parts[common], member_parts[common]) == 0) common++;
+   size_t len = 0;
+   path[0] = '\0';
+   for (int i = common; i < unity_count && len < size; i++) len += snprintf(path + len, size - len, "../");
+   for (int i = common; i < member_count && len < size; i++) {
+      len += snprintf(path + len, size - len, "%s%s", member_parts[i], i + 1 < member_count ? "/" : "");
+   }
+   return len < size;
+}
+/* Write a unity file including its members, leaving it untouched (and its compile current) when unchanged */
+static int graph_write_unity(const char *path, char **members, int member_count) {
+   // Members are included relative to the unity file's directory (where quoted includes resolve first), so the
+   // checkout's path stays out of the preprocessed unit and the caches it keys
+   size_t len = 0, size = 0;
+   char *content = NULL, member[4096];
+   int is_written = SB_TRUE;
+   for (int i = 0; is_written && i < member_count; i++) {
+      is_written = graph_unity_member(path, members[i], member, sizeof(member));
+      size_t line_len = strlen(member) + 12;
+      if (is_written && len + line_len + 1 > size) {
+         char *grown = realloc(content, size = 2 * size + line_len + 1);
+         is_written = grown != NULL;
+         if (grown) content = grown;
+      }
+      if (is_written) len += sprintf(content + len, "#include \"%s\"\n", member);
+   }
+   char *existing = is_written ? malloc(len + 1) : NULL;
+   FILE *file = existing ? fopen(path, "r") : NULL;
+   size_t existing_len = file ? fread(existing, 1, len + 1, file) : 0;
+   if (file) fclose(file);
+   is_written = existing && existing_len == len && memcmp(existing, content, len) == 0;
+   if (!is_written && existing && (file = fopen(path, "w"))) {
+      is_written = fwrite(content, 1, len, file) == len;
+      is_written = fclose(file) == 0 && is_written;
+   }
+   if (!is_written) Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to write unity file %s\n", path);
+   free(content);
+   free(existing);
+
+   return is_written;
+}
+/* Batch a unity target's sources per directory and language; excluded sources, sources other than C/C++ and
+ * single-file batches compile on their own */
+static int graph_lower_unity(graph_target_s *lowered, int *compiles, int *compile_count) {
+   BuildTarget target = lowered->target;
+   int src_count = 0, batched_count = 0;
+   for (char **src = target->sources; src && *src; src++) src_count++;
+
+   char **batched = calloc(src_count + 1, sizeof(char *));
+   if (!batched) return SB_FALSE;
+   int is_lowered = SB_TRUE;
+   for (int i = 0; is_lowered && i < src_count; i++) {
+      char *src = target->sources[i];
+      if (!graph_is_excluded(target, src) && graph_unity_ext(src)) {
+         batched[batched_count++] = src;
+         continue;
+      }
+      compiles[*compile_count] = graph_lower_compile(lowered, src, src, NULL);
+      is_lowered = compiles[(*compile_count)++] >= 0;
+   }
+   qsort(batched, batched_count, sizeof(char *), graph_compare_sources);
+
+   for (int first = 0, dir_first = 0, count = 0; is_lowered && first < batched_count; first += count) {
+      // A batch never crosses a directory or language boundary; indices restart per directory and language so
+      // others are not renumbered
+      if (!graph_is_same_batch(batched[first], batched[dir_first])) dir_first = first;
+      for (count = 1; count < target->unity_batch_size && first + count < batched_count; count++) {
+         if (!graph_is_same_batch(batched[first + count], batched[first])) break;
+      }
+      if (count == 1) {
+         compiles[*compile_count] = graph_lower_compile(lowered, batched[first], batched[first], NULL);
+         is_lowered = compiles[(*compile_count)++] >= 0;
+         continue;
+      }
+
+      // Unity file and object are named after the directory, the language and the batch's index; the file takes the
+      // members' extension, so C++ members are compiled as C++
+      size_t dir_len = graph_dir_length(batched[first]);
+      const char *ext = graph_unity_ext(batched[first]);
+      char index[32];
+      snprintf(index, sizeof(index), "%s" GRAPH_UNITY_PREFIX "%s%s%d", dir_len ? "/" : "", strcmp(ext, ".c") == 0 ? "" : ext + 1,
+               strcmp(ext, ".c") == 0 ? "" : "_", (first - dir_first) / target->unity_batch_size);
+      char *dir = graph_alloc(dir_len + 1);
+      if (dir) memcpy(dir, batched[first], dir_len);
+      char *key = dir ? graph_concat(dir, index, "") : NULL;
+      char *unity = key ? graph_object_path(target->build_dir, key, ext) : NULL;
+      char **inputs = unity ? graph_alloc((count + 3) * sizeof(char *)) : NULL;
+      if (inputs) memcpy(inputs + 1, batched + first, count * sizeof(char *));
+      compiles[*compile_count] = inputs && (is_planning || graph_write_unity(unity, batched + first, count))
+                                     ? graph_lower_compile(lowered, unity, key, inputs)
+                                     : -1;
+      is_lowered = compiles[(*compile_count)++] >= 0;
+      if (is_lowered) graph->actions[compiles[*compile_count - 1]]->is_unity = SB_TRUE;
+   }
+   free(batched);
+
+   return is_lowered;
+}
+/* An op target's commands form a chain: each command runs after the previous one */
+static int graph_lower_commands(graph_target_s *lowered) {
+   int previous = -1;
+   for (char **cmd = lowered->target->commands; cmd && *cmd; cmd++) {
+      graph_action_s *action = graph_new_action(lowered, ACTION_COMMAND, lowered->target->name);
+      if (!action) return SB_FALSE;
+      action->command = *cmd;
+      action->signature = get_string_hash(*cmd);
+      int is_added = previous >= 0 ? graph_add_dependency(action, previous) : graph_depend_on_targets(action, lowered);
+      if (!is_added) return SB_FALSE;
+      previous = action->id;
+   }
+   lowered->final = previous;
+
+   return SB_TRUE;
+}
+
+/* Find the first action compiling a source or producing an output */
+static int graph_find_file(ActionGraph graph, const char *path) {
+   if (!graph || !path) return -1;
+   if (strncmp(path, "./", 2) == 0) path += 2;
+
+   for (int i = 0; i < graph->action_count; i++) {
+      graph_action_s *action = graph->actions[i];
+      if (action->output && strcmp(action->output, path) == 0) return i;
+      for (char **input = action->inputs; action->kind == ACTION_COMPILE && *input; input++) {
+         if (strcmp(*input, path) == 0) return i;
+      }
+   }
+   return -1;
+}
+
+/* Release the graph, its dependents lists and its arena */
+static void graph_dispose(ActionGraph graph) {
+   if (!graph) return;
+
+   action_graph_s *owned = (action_graph_s *)graph;
+   for (int i = 0; i < owned->action_count; i++) free(owned->actions[i]->dependents);
+   free(owned->actions);
+   free(owned->targets);
+   for (arena_chunk_s *chunk = owned->arena, *next; chunk; chunk = next) {
+      next = chunk->next;
+      free(chunk);
+   }
+   free(owned);
+}
+
+const IActionGraphs ActionGraphs = {
+    .lower = graph_lower,
+    .plan = graph_plan,
+    .find_file = graph_find_file,
+    .dispose = graph_dispose,
+};
@@ -0,0 +1,112 @@
+/* src/core/action_graph.h
+ * Sigma.Build Action Graph
+ * The immutable graph of actions lowered from the build configuration.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for lowering build targets into an action graph. Lowering
+ * happens once per configuration: every action carries its complete argument vector (built
+ * from a per-target template), its input and output paths and its signature, so running,
+ * checking and reporting an action never formats anything. The graph is read-only once
+ * lowered; per-build state is kept by its consumers.
+ */
+#ifndef ACTION_GRAPH_H
+#define ACTION_GRAPH_H
+
+#include "builder.h"
+
+#define GRAPH_TMP_SUFFIX ".tmp"   // Outputs are written here first and renamed into place on success
+#define GRAPH_RSP_SUFFIX ".rsp"   // Response file written next to the output of a long command
+#define GRAPH_RSP_THRESHOLD 32768 // Command lines longer than this pass their arguments via @file
+
+#define GRAPH_UNITY_PREFIX "_unity_" // Unity files are `<build_dir><dir>__unity_<batch>.c` (`__unity_cpp_<batch>.cpp` for C++)
+
+#define GRAPH_PCH_PREFIX "pch_"    // Precompiled headers live in `<build_dir>pch_<hash of flags and header>/`
+#define GRAPH_PCH_SUFFIX ".gch"    // Precompiled header next to the (absent) header named by -include
+
+#define GRAPH_ARCHIVE_FLAGS "rcs"      // Archiver flags: replace members, create silently, write the symbol index
+#define GRAPH_THIN_ARCHIVE_FLAGS "rcsT" // Same, for a thin archive (members referenced by path)
+
+typedef enum { ACTION_COMPILE, ACTION_LINK, ACTION_ARCHIVE, ACTION_COMMAND } ActionKind;
+
+typedef struct graph_target_s graph_target_s;
+typedef struct graph_action_s {
+   int id;                 // Index of the action; dependencies always have lower ids
+   ActionKind kind;        // What the action does
+   graph_target_s *target; // Target that first requested the action
+   string label;           // Short description (source file or target name)
+   string command;         // Shell command of an op action (NULL for argv actions)
+   char **argv;            // Argument vector: the target's template followed by per-action arguments
+   int member_index;       // Index in argv of an archive's first member (archives only)
+   size_t argv_len;        // Length of the command line argv would form
+   uint64_t signature;     // Hash of the full command (compared against the build log)
+   string output;          // Primary output (NULL for op commands)
+   string tmp_path;        // Temp output renamed into place on success (NULL for op commands)
+   string dep_path;        // Depfile listing the headers a compile read (optional)
+   string rsp_arg;         // `@<output>.rsp` when argv[1..] goes through a response file (optional)
+   string *inputs;         // Files the output must be newer than (a unity compile lists its members; NULL-terminated)
+   int is_unity;           // Set on the compile of a unity file (inputs[0]; its members follow)
+   int *dependents;        // Ids of the actions waiting on this one
+   int dependent_count;    // Number of waiting actions
+   int dependency_count;   // Number of actions this one waits on
+} graph_action_s;
+
+struct graph_target_s {
+   int id;                  // Index of the target; dependencies always have lower ids
+   BuildTarget target;      // Target the actions were lowered from
+   int final;               // Id of the target's last action (-1 if it has none)
+   long action_timeout_ms;  // Wall-clock limit for each action (target, else config default; 0 = none)
+   char **compile_template; // `compiler c_flags...` shared by every compile of the target
+   int template_count;      // Number of arguments in the template
+   int pch;                 // Id of the action precompiling the target's header (-1 if none)
+   string pch_include;      // Path passed to -include; the compiler picks up `<path>.gch` instead
+   int is_visiting;         // Set while the target's dependencies are lowered (cycle check)
+};
+
+typedef struct action_graph_s {
+   graph_action_s **actions; // Actions in dependency order
+   int action_count;         // Number of actions
+   graph_target_s **targets; // Lowered targets in dependency order
+   int target_count;         // Number of targets
+   object arena;             // Storage for the graph's strings and vectors
+} action_graph_s;
+typedef const struct action_graph_s *ActionGraph;
+
+/**
+ * @brief IActionGraphs interface.
+ * @details Provides an interface for lowering targets into action graphs.
+ */
+typedef struct IActionGraphs {
+   /**
+    * @brief Lowers the given targets and their dependencies into an action graph.
+    * @param config :the configuration holding every target (dependencies are looked up by name)
+    * @param targets :NULL-terminated array of the requested targets
+    * @return :the graph, or NULL if a target is invalid, a dependency is unknown or cyclic
+    */
+   ActionGraph (*lower)(BuildConfig, BuildTarget *);
+   /**
+    * @brief Lowers like lower() without writing anything, for inspecting what a build would do.
+    * @details Unity files are not written: a unity compile's source may be absent or stale.
+    * @param config :the configuration holding every target (dependencies are looked up by name)
+    * @param targets :NULL-terminated array of the requested targets
+    * @return :the graph, or NULL if a target is invalid, a dependency is unknown or cyclic
+    */
+   ActionGraph (*plan)(BuildConfig, BuildTarget *);
+   /**
+    * @brief Finds the first action compiling a source or producing an output.
+    * @param graph :the graph
+    * @param path :the source or output path
+    * @return :the action id, or -1 if no action builds the file
+    */
+   int (*find_file)(ActionGraph, const char *);
+   /**
+    * @brief Disposes of a graph.
+    * @param graph :the graph
+    */
+   void (*dispose)(ActionGraph);
+} IActionGraphs;
+
+extern const IActionGraphs ActionGraphs;
+
+#endif // ACTION_GRAPH_H
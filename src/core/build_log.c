@@ -0,0 +1,376 @@
+/* src/core/build_log.c
+ * Sigma.Build Build Log
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * The log is a binary file mapped read-only at open: a header, an open-addressed index of
+ * record numbers, then fixed-width records. Keys are stored as two independent 64-bit hashes,
+ * so every record has the same size and lookups never touch strings.
+ *
+ * The index covers the records written by the last compaction. Records of later builds are
+ * appended behind them as a journal (one write per completed action, each with a checksum):
+ * on open the journal is replayed into a small table in memory, stopping at - and cutting
+ * off - a record torn by a crash. On close, a journal grown past a fraction of the indexed
+ * records is compacted: live records are rewritten with a fresh index to a temp file that is
+ * synced and renamed over the log. Logs in another format are discarded.
+ *
+ * Builds in the same directory share the log: opening, each append and compaction hold an
+ * exclusive flock. An append that finds the log replaced by another build's compaction
+ * reopens it, and a build only compacts a log nobody else wrote to since it was opened.
+ */
+#include "build_log.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BUILD_LOG_MAGIC "SBSTATE\0"
+#define BUILD_LOG_VERSION 5
+#define BUILD_LOG_MIN_SLOTS 256
+#define BUILD_LOG_COMPACT_RATIO 8 // Compact once the journal holds over 1/8 as many records as the index
+
+typedef struct log_header_s {
+   char magic[8];         // BUILD_LOG_MAGIC
+   uint32_t version;      // BUILD_LOG_VERSION
+   uint32_t record_size;  // sizeof(log_record_s)
+   uint64_t slot_count;   // Index slots (power of two)
+   uint64_t record_count; // Records covered by the index
+   uint64_t checksum;     // Hash of the fields above
+} log_header_s;
+
+typedef struct log_record_s {
+   uint64_t key_hash;     // FNV-1a of the key (picks the index slot)
+   uint64_t key_check;    // Independent hash of the key (tells apart keys sharing key_hash)
+   int64_t duration_ms;   // Entry: wall-clock duration of the last successful run
+   int64_t mtime_ns;      // Entry: modification time of the output
+   uint64_t command_hash; // Entry: hash of the command that produced the output
+   uint64_t digest;       // Entry: hash of the output's contents
+   int64_t restat_ns;     // Entry: newest input an unchanged output was found current for
+   uint64_t cache_key[2]; // Entry: object cache key of the output
+   uint64_t checksum;     // Hash of the fields above (a torn record fails it)
+} log_record_s;
+
+static char *log_path = NULL;          // Path of the log file
+static int log_fd = -1;                // Log opened for appending
+static off_t log_end = 0;              // Size of the log as this build left it
+static int is_shared = 0;              // Set once another build wrote to the log since it was opened
+static const char *map = NULL;         // Mapped file (NULL if empty)
+static size_t map_size = 0;            // Size of the mapping
+static const uint32_t *slots = NULL;   // Mapped index: record number + 1 per slot (0 = empty)
+static const log_record_s *records;    // Mapped indexed records
+static uint64_t slot_count = 0;        // Slots in the mapped index
+static uint64_t record_count = 0;      // Records covered by the mapped index
+static log_record_s *journal = NULL;   // Open-addressed table of records newer than the index
+static size_t journal_size = 0;        // Slots in the journal table (power of two)
+static size_t journal_count = 0;       // Keys in the journal table
+static size_t tail_count = 0;          // Records in the file's journal (a key may repeat)
+
+// Forward declarations
+static void log_close(void);
+static void log_sync_dir(void);
+
+/* Hash a block of bytes (FNV-1a) */
+static uint64_t log_hash_bytes(const void *data, size_t size) {
+   const unsigned char *bytes = data;
+   uint64_t hash = 1469598103934665603ULL;
+   for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+   return hash;
+}
+/* Second key hash, independent of get_string_hash */
+static uint64_t log_key_check(const char *key) {
+   uint64_t hash = strlen(key);
+   for (; *key; key++) hash = (hash ^ (unsigned char)*key) * 0x9E3779B97F4A7C15ULL + (hash >> 29);
+   return hash;
+}
+static void log_seal(log_record_s *record) {
+   record->checksum = log_hash_bytes(record, offsetof(log_record_s, checksum));
+}
+static int log_is_sealed(const log_record_s *record) {
+   return record->checksum == log_hash_bytes(record, offsetof(log_record_s, checksum));
+}
+
+/* Find a key among the indexed records */
+static const log_record_s *log_find_indexed(uint64_t key_hash, uint64_t key_check) {
+   uint64_t mask = slot_count - 1;
+   for (uint64_t i = key_hash & mask; slots && slots[i] && slots[i] <= record_count; i = (i + 1) & mask) {
+      const log_record_s *record = &records[slots[i] - 1];
+      if (record->key_hash == key_hash && record->key_check == key_check) return record;
+   }
+   return NULL;
+}
+/* Find the journal slot for a key: either its record or the empty slot it would occupy */
+static log_record_s *log_find_journal(uint64_t key_hash, uint64_t key_check) {
+   size_t mask = journal_size - 1;
+   for (size_t i = key_hash & mask;; i = (i + 1) & mask) {
+      log_record_s *slot = &journal[i];
+      if (!slot->checksum || (slot->key_hash == key_hash && slot->key_check == key_check)) return slot;
+   }
+}
+static int log_grow_journal(void) {
+   log_record_s *old = journal;
+   size_t old_size = journal_size;
+   addr journal_addr;
+   size_t new_size = journal_size ? journal_size * 2 : BUILD_LOG_MIN_SLOTS;
+   if (!Resources.alloc(&journal_addr, new_size * sizeof(log_record_s))) return SB_FALSE;
+
+   journal = (log_record_s *)journal_addr;
+   journal_size = new_size;
+   for (size_t i = 0; i < old_size; i++) {
+      if (old[i].checksum) *log_find_journal(old[i].key_hash, old[i].key_check) = old[i];
+   }
+   free(old);
+   return SB_TRUE;
+}
+/* Insert or replace a record in the journal table */
+static void log_put(const log_record_s *record) {
+   if ((journal_count + 1) * 4 > journal_size * 3 && !log_grow_journal()) return;
+
+   log_record_s *slot = log_find_journal(record->key_hash, record->key_check);
+   if (!slot->checksum) journal_count++;
+   *slot = *record;
+}
+
+/* Map the log and check its header; returns the offset its journal starts at (0 if unusable) */
+static size_t log_map(int fd) {
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(log_header_s)) return 0;
+   void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   if (mapped == MAP_FAILED) return 0;
+   map = mapped;
+   map_size = st.st_size;
+
+   const log_header_s *header = (const log_header_s *)map;
+   size_t index_end = sizeof(log_header_s) + header->slot_count * sizeof(uint32_t);
+   int is_current = memcmp(header->magic, BUILD_LOG_MAGIC, sizeof(header->magic)) == 0 &&
+                    header->version == BUILD_LOG_VERSION && header->record_size == sizeof(log_record_s) &&
+                    header->checksum == log_hash_bytes(header, offsetof(log_header_s, checksum)) &&
+                    header->slot_count >= BUILD_LOG_MIN_SLOTS && header->slot_count <= map_size / sizeof(uint32_t) &&
+                    (header->slot_count & (header->slot_count - 1)) == 0 &&
+                    header->record_count < header->slot_count && index_end <= map_size &&
+                    header->record_count <= (map_size - index_end) / sizeof(log_record_s);
+   if (!is_current) return 0;
+
+   slot_count = header->slot_count;
+   record_count = header->record_count;
+   slots = (const uint32_t *)(map + sizeof(log_header_s));
+   records = (const log_record_s *)(map + index_end);
+   return index_end + record_count * sizeof(log_record_s);
+}
+/* Replay the journal behind the indexed records; returns where the intact journal ends */
+static size_t log_replay(size_t offset) {
+   for (; offset + sizeof(log_record_s) <= map_size; offset += sizeof(log_record_s)) {
+      log_record_s record;
+      memcpy(&record, map + offset, sizeof(record));
+      if (!log_is_sealed(&record) || !record.checksum) break;
+      log_put(&record);
+      tail_count++;
+   }
+   return offset;
+}
+/* Lock the log against other builds, reopening it if another build's compaction replaced it; returns its size, or -1
+ * if it cannot be locked */
+static off_t log_lock(void) {
+   struct stat open_st, path_st;
+   while (log_fd >= 0) {
+      if (flock(log_fd, LOCK_EX) != 0) {
+         if (errno == EINTR) continue;
+         break;
+      }
+      if (fstat(log_fd, &open_st) != 0) break;
+      if (stat(log_path, &path_st) == 0 && path_st.st_ino == open_st.st_ino && path_st.st_dev == open_st.st_dev) {
+         return open_st.st_size;
+      }
+      close(log_fd);
+      log_fd = open(log_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+      is_shared = 1;
+   }
+   return -1;
+}
+/* Write `size` bytes at the descriptor's position, retrying short writes */
+static int log_write(int fd, const void *data, size_t size) {
+   const char *bytes = data;
+   while (size > 0) {
+      ssize_t n = write(fd, bytes, size);
+      if (n <= 0) return SB_FALSE;
+      bytes += n;
+      size -= n;
+   }
+   return SB_TRUE;
+}
+/* Write a log holding `count` records with a fresh index */
+static int log_write_file(int fd, const log_record_s *live, uint64_t count) {
+   uint64_t slots = BUILD_LOG_MIN_SLOTS;
+   while (slots < count * 2) slots *= 2;
+   uint32_t *table = calloc(slots, sizeof(uint32_t));
+   if (!table) return SB_FALSE;
+   for (uint64_t n = 0; n < count; n++) {
+      uint64_t i = live[n].key_hash & (slots - 1);
+      while (table[i]) i = (i + 1) & (slots - 1);
+      table[i] = (uint32_t)(n + 1);
+   }
+
+   log_header_s header = {.version = BUILD_LOG_VERSION, .record_size = sizeof(log_record_s), .slot_count = slots, .record_count = count};
+   memcpy(header.magic, BUILD_LOG_MAGIC, sizeof(header.magic));
+   header.checksum = log_hash_bytes(&header, offsetof(log_header_s, checksum));
+   int is_written = log_write(fd, &header, sizeof(header)) && log_write(fd, table, slots * sizeof(uint32_t)) &&
+                    log_write(fd, live, count * sizeof(log_record_s));
+   free(table);
+   return is_written;
+}
+
+/* Open the log and replay its journal */
+static int log_open(const char *dir) {
+   log_close();
+   if (!log_grow_journal()) return SB_FALSE;
+
+   const char *base = dir && *dir ? dir : ".";
+   size_t len = strlen(base) + strlen(BUILD_LOG_FILE) + 2;
+   addr path_addr;
+   if (!Resources.alloc(&path_addr, len)) return SB_FALSE;
+   log_path = (char *)path_addr;
+   snprintf(log_path, len, "%s%s%s", base, base[strlen(base) - 1] == '/' ? "" : "/", BUILD_LOG_FILE);
+
+   // Read under the lock: a torn record at the end is then not another build's append in progress
+   log_fd = open(log_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+   if (log_lock() < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Failed to open build log: %s\n", log_path);
+      if (log_fd >= 0) close(log_fd);
+      log_fd = -1;
+      return SB_FALSE;
+   }
+   is_shared = 0;
+   size_t journal_at = log_map(log_fd);
+   size_t end = journal_at ? log_replay(journal_at) : 0;
+   if (!journal_at) {
+      // Start a fresh log when none exists or it was written in another format
+      if (map) munmap((void *)map, map_size);
+      map = NULL;
+      slots = NULL;
+      slot_count = record_count = tail_count = 0;
+      if (ftruncate(log_fd, 0) != 0 || !log_write_file(log_fd, NULL, 0)) return SB_FALSE;
+   } else if (end < map_size && ftruncate(log_fd, end) != 0) {
+      return SB_FALSE; // Cut off a torn record so appends stay aligned
+   }
+
+   log_end = lseek(log_fd, 0, SEEK_END);
+   flock(log_fd, LOCK_UN);
+   return log_end >= 0;
+}
+
+static int log_lookup(const char *key, build_log_entry_s *entry) {
+   if (!journal || !key) return SB_FALSE;
+
+   uint64_t key_hash = get_string_hash(key), key_check = log_key_check(key);
+   const log_record_s *record = log_find_journal(key_hash, key_check);
+   if (!record->checksum) record = log_find_indexed(key_hash, key_check);
+   if (!record) return SB_FALSE;
+   entry->duration_ms = record->duration_ms;
+   entry->mtime_ns = record->mtime_ns;
+   entry->command_hash = record->command_hash;
+   entry->digest = record->digest;
+   entry->restat_ns = record->restat_ns;
+   entry->cache_key[0] = record->cache_key[0];
+   entry->cache_key[1] = record->cache_key[1];
+   return SB_TRUE;
+}
+
+static void log_record(const char *key, const build_log_entry_s *entry) {
+   if (!journal || !key || !entry) return;
+
+   log_record_s record = {.key_hash = get_string_hash(key), .key_check = log_key_check(key), .duration_ms = entry->duration_ms,
+                          .mtime_ns = entry->mtime_ns, .command_hash = entry->command_hash, .digest = entry->digest,
+                          .restat_ns = entry->restat_ns, .cache_key = {entry->cache_key[0], entry->cache_key[1]}};
+   log_seal(&record);
+   log_put(&record);
+   tail_count++;
+   // Journal: the record must survive an interrupt right after this
+   off_t size = log_fd >= 0 ? log_lock() : 0;
+   if (size != log_end) is_shared = 1;
+   if (log_fd >= 0 && (size < 0 || !log_write(log_fd, &record, sizeof(record)))) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Failed to append to build log: %s\n", log_path);
+      close(log_fd);
+      log_fd = -1;
+   } else if (log_fd >= 0) {
+      log_end = size + sizeof(record);
+      flock(log_fd, LOCK_UN);
+   }
+}
+
+/* Rewrite the log with only live records under a fresh index */
+static void log_compact(void) {
+   addr live_addr;
+   if (!Resources.alloc(&live_addr, (record_count + journal_count + 1) * sizeof(log_record_s))) return;
+   log_record_s *live = (log_record_s *)live_addr;
+   uint64_t count = 0;
+   for (uint64_t i = 0; i < record_count; i++) {
+      if (!log_find_journal(records[i].key_hash, records[i].key_check)->checksum) live[count++] = records[i];
+   }
+   for (size_t i = 0; i < journal_size; i++) {
+      if (journal[i].checksum) live[count++] = journal[i];
+   }
+
+   size_t len = strlen(log_path) + 5;
+   char *tmp_path = malloc(len);
+   if (tmp_path) {
+      snprintf(tmp_path, len, "%s.tmp", log_path);
+      // The new log must be on disk before it replaces the old one, and the rename before the old one is gone
+      int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      int is_written = fd >= 0 && log_write_file(fd, live, count) && fsync(fd) == 0;
+      if (fd >= 0 && close(fd) == 0 && is_written && rename(tmp_path, log_path) == 0) {
+         log_sync_dir();
+      } else {
+         unlink(tmp_path);
+      }
+   }
+   free(tmp_path);
+   free(live);
+}
+/* Flush the log's directory, so a rename into it is durable */
+static void log_sync_dir(void) {
+   char *dir = strdup(log_path);
+   char *slash = dir ? strrchr(dir, '/') : NULL;
+   if (slash) slash[slash == dir] = '\0';
+   int fd = slash ? open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+   if (fd >= 0) {
+      fsync(fd);
+      close(fd);
+   }
+   free(dir);
+}
+
+/* Close, compact if the journal grew large, and release the log */
+static void log_close(void) {
+   if (log_fd >= 0) {
+      // Compact under the lock, and only a log no other build appended to: their records are not in this one's tables
+      int is_due = tail_count > 0 && tail_count * BUILD_LOG_COMPACT_RATIO > record_count;
+      if (is_due && log_lock() == log_end && !is_shared) log_compact();
+      close(log_fd);
+      log_fd = -1;
+   }
+   if (map) munmap((void *)map, map_size);
+   free(journal);
+   free(log_path);
+   map = NULL;
+   slots = NULL;
+   records = NULL;
+   journal = NULL;
+   log_path = NULL;
+   map_size = journal_size = journal_count = tail_count = 0;
+   slot_count = record_count = 0;
+   log_end = 0;
+   is_shared = 0;
+}
+
+const IBuildLog BuildLog = {
+    .open = log_open,
+    .lookup = log_lookup,
+    .record = log_record,
+    .close = log_close,
+};
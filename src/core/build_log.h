@@ -0,0 +1,63 @@
+/* src/core/build_log.h
+ * Sigma.Build Build Log
+ * Records what was learned about completed actions between invocations.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for the build log kept in the configuration's
+ * build directory. Each completed action is recorded under its key (the path of the
+ * action's primary output) as soon as it finishes, so later builds - including the one
+ * after an interrupted build - can tell which outputs are up to date. The log is a binary
+ * file of fixed-width records behind a hash index, mapped at open so that loading it costs
+ * the same for any number of actions.
+ */
+#ifndef BUILD_LOG_H
+#define BUILD_LOG_H
+
+#include "sbuild.h"
+
+#define BUILD_LOG_FILE ".sbuild_log" // Build log file name inside the build directory
+
+typedef struct build_log_entry_s {
+   long duration_ms;      // Wall-clock duration of the last successful run
+   int64_t mtime_ns;      // Modification time of the output it produced
+   uint64_t command_hash; // Hash of the command that produced the output
+   uint64_t digest;       // Hash of the output's contents (0 if unknown)
+   int64_t restat_ns;     // Newest input the output was found to be current for when a rebuild left it unchanged (0 if none)
+   uint64_t cache_key[2]; // Object cache key of the output (0 if not cached); one missing on disk is left in the cache
+} build_log_entry_s;
+
+/**
+ * @brief IBuildLog interface.
+ * @details Provides an interface for reading and appending the build log.
+ */
+typedef struct IBuildLog {
+   /**
+    * @brief Opens the build log in the given directory, loading previous entries.
+    * @param dir :the build directory holding the log
+    * @return :1 if the log is open; otherwise, 0
+    */
+   int (*open)(const char *);
+   /**
+    * @brief Looks up the entry recorded for an action.
+    * @param key :the action key
+    * @param entry :receives the recorded entry
+    * @return :1 if an entry exists; otherwise, 0
+    */
+   int (*lookup)(const char *, build_log_entry_s *);
+   /**
+    * @brief Records an entry for an action, appending it to the log before returning.
+    * @param key :the action key
+    * @param entry :the entry to record
+    */
+   void (*record)(const char *, const build_log_entry_s *);
+   /**
+    * @brief Flushes and closes the build log.
+    */
+   void (*close)(void);
+} IBuildLog;
+
+extern const IBuildLog BuildLog;
+
+#endif // BUILD_LOG_H
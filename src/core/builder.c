@@ -11,109 +11,1622 @@
  */
 
 #include "builder.h"
+#include "action_graph.h"
+#include "build_log.h"
+#include "executor.h"
+#include "file_stats.h"
+#include "git_index.h"
+#include "include_scanner.h"
 #include "loader.h"
+#include "object_cache.h"
+#include "string_map.h"
+#include "toolchain.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-#define CLI_BUILDER_VERSION "0.00.02.003"
+#define CLI_BUILDER_VERSION "0.00.04.012"
+#define BUILDER_REPORT_HEADERS 10   // Header candidates listed per target
+#define BUILDER_WATCH_DEBOUNCE_MS 50 // Quiet period that ends a burst of file changes
+#define BUILDER_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) // Not IN_ATTRIB: reads bump atime
 
 // Function to return the version of the builder
 const char *get_builder_version() {
    return CLI_BUILDER_VERSION; // Return the version of the builder
 }
 
-int builder_exec_op_target(BuildTarget);
+typedef struct build_failure_s {
+   string label;  // Label of the failed action
+   int status;    // Exit status of the failed action
+   int timed_out; // Set when the action exceeded its timeout
+} build_failure_s;
 
-// Function to build the specified target
-int builder_build_target(BuildTarget target) {
-   if (!target || !target->name) {
-      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Invalid build target specified.\n");
-      return -1; // Return error if target is NULL or has no name
-   }
-   if (strcmp(target->type, TARGET_TYPE_OP) == 0) {
-      Logger.debug(Logger.log_stream(), LOG_NORMAL, DBG_INFO, "Executing operation target: %s", target->name);
-      return builder_exec_op_target(target); // Handle operation targets separately
-   }
-
-   Logger.writeln("Building target: %s", target->name);
-
-   // Compile each source file
-   char obj_files[2048] = "";
-   for (char **src = target->sources; src && *src; src++) {
-      char *src_copy = strdup(*src);
-      char *base = strdup(*src);
-      char *slash = base;
-      while ((slash = strchr(slash, '/'))) *slash = '_';
-      char *dot = strrchr(base, '.');
-      if (dot) *dot = '\0';
-      char obj_path[1024];
-      snprintf(obj_path, sizeof(obj_path), "%s%s.o", target->build_dir, base);
-      char c_flags[512] = "";
-
-      // Prepare compiler flags
-      for (char **flag = target->c_flags; flag && *flag; flag++) {
-         strcat(c_flags, *flag);
-         strcat(c_flags, " ");
-      }
-      // Add the source file to the flags
-      char cmd[2048];
-      snprintf(cmd, sizeof(cmd), "%s %s-o %s %s",
-               target->compiler, c_flags, obj_path, *src);
-      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executing: %s\n", cmd);
-      // Execute the compile command
-      if (system(cmd) != 0) {
-         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to compile %s\n", *src);
-         free(src_copy);
-         free(base);
-         return -1;
-      }
-
-      strcat(obj_files, obj_path);
-      strcat(obj_files, " ");
-      free(src_copy);
-      free(base);
-   }
-
-   // Link object files
-   // Prepare the linker flags
-   char ld_flags[512] = "";
-   for (char **flag = target->ld_flags; flag && *flag; flag++) {
-      strcat(ld_flags, *flag);
-      strcat(ld_flags, " ");
-   }
-   // Add the libraries to link command
-   char link_cmd[4096];
-   snprintf(link_cmd, sizeof(link_cmd), "%s %s-o %s%s %s",
-            target->compiler, ld_flags, target->out_dir, target->output, obj_files);
-   Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executing: %s\n", link_cmd);
-   // Execute the link command
-   if (system(link_cmd) != 0) {
-      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to link target: %s\n", target->name);
+typedef enum { ACTION_IDLE, ACTION_WAITING, ACTION_READY, ACTION_RUNNING, ACTION_DONE, ACTION_FAILED, ACTION_SKIPPED } ActionState;
+typedef enum { CACHE_NONE, CACHE_PREPROCESS, CACHE_COMPILE, CACHE_LINK } CacheStep; // Step an action through the object cache is at
+
+typedef struct action_run_s {
+   exec_job_s job;     // Job run for the action
+   ActionState state;  // Where the action is in this build
+   int pending;        // Dependencies that have not finished yet
+   int is_dep_ran;     // Set when a dependency ran in this build and changed its output
+   int is_unchanged;   // Set when the action ran but left its output byte-identical (early cutoff)
+   int is_superseded;  // Set when an input changed while the action ran (watch mode runs it again)
+   char *rsp_argv[3];  // `<tool> @<output>.rsp` form run in place of the action's argv
+   char **member_argv; // Archiver argv replacing only the changed members of an existing archive
+   CacheStep cache_step; // Step an action through the object cache is running (CACHE_NONE: run directly)
+   int is_fetched;       // Set when the action's output was taken from the object cache (nothing runs)
+   int is_virtual;       // Set when a compile's object was left in the object cache (lazy objects: nothing is written)
+   int is_lost;          // Set when the cache lost a compile's lazy object: it is compiled again and written
+   char **cache_argv;    // Its preprocess argv, heading one block with unit_argv and unit_path
+   char **unit_argv;     // Its argv compiling the preprocessed unit
+   char *unit_path;      // Its preprocessed unit (`<tmp>.i`, `.ii` for C++)
+   char cache_key[OBJECT_CACHE_KEY_SIZE]; // Key of the preprocessed unit, or of a link's inputs ("" if unreadable: not stored)
+   long preprocess_ms;   // Duration of the preprocess step
+} action_run_s;
+
+typedef struct header_use_s {
+   int unit_count; // Translation units including the header
+   long size;      // Size of the header in bytes (its parse cost)
+   string path;    // Header path (owned by the tally map)
+} header_use_s;
+
+typedef struct header_tally_s {
+   StringMap headers;      // Header path -> header_use_s
+   graph_action_s *action; // Compile whose depfile is being read
+} header_tally_s;
+
+typedef int (*DepVisitor)(const char *, object); // Depfile visitor: prerequisite path, caller data; 0 stops
+
+typedef struct scan_list_s {
+   StringMap seen; // Path -> its copy in paths
+   char **paths;   // Listed paths (owned, shared by the actions' dep lists)
+   int count;      // Number of listed paths
+   int cap;        // Capacity of paths
+} scan_list_s;
+
+typedef struct dep_list_s {
+   char **paths; // Paths from one depfile (pointing into the scan list)
+   int count;    // Number of paths
+   int cap;      // Capacity of paths
+} dep_list_s;
+
+typedef struct watch_state_s {
+   int fd;               // inotify descriptor (-1 when not watching)
+   StringMap paths;      // Watched file path -> marker (inputs, headers and the config file)
+   StringMap dirs;       // Directory prefix of a watched path -> marker (each directory is watched once)
+   dep_list_s *prefixes; // Directory prefixes spelled by the watched paths (indexed by watch descriptor)
+   int prefix_count;     // Number of entries in prefixes
+   StringMap changed;    // Watched paths changed in the last batch of events
+   int change_count;     // Watched paths changed since the current pass started
+   int is_reload;        // Set when the config file changed
+   int is_live;          // Set when changes wake the executor's wait (watch mode; a build server reads them per build)
+} watch_state_s;
+
+typedef struct target_run_s {
+   int ran_count;    // Actions of the target that ran in this build
+   long deadline_ms; // Monotonic deadline of the target (0 = none)
+} target_run_s;
+
+static int max_failures = 1;              // Failed actions tolerated before stopping (0 = keep going)
+static build_failure_s *failures = NULL;  // Failed actions collected for the end-of-build report
+static int failure_count = 0;             // Number of failed actions
+static int skipped_count = 0;             // Actions not run because a dependency failed
+static int is_stopping = 0;               // Set once the failure limit (or an interrupt) stops the build
+static BuildContext build_context = NULL; // Context the builder was initialized with
+
+static ActionGraph graph = NULL;       // Graph being built
+static action_run_s *runs = NULL;      // Per-build state of each action (indexed by action id)
+static target_run_s *target_runs = NULL; // Per-build state of each target (indexed by target id)
+static int *ready = NULL;              // Queue of action ids whose dependencies have finished
+static int ready_head = 0;             // Next action to start
+static int ready_tail = 0;             // End of the queue
+static scan_list_s scan = {0};         // Every path stat'ed by the scan of this build
+static char ***action_deps = NULL;     // Headers from each action's depfile, read once by a scan (NULL-terminated; NULL if not read)
+static uint64_t *action_verified = NULL; // File stats generation + 1 at which each action was last found current (0: never)
+static watch_state_s watch = {.fd = -1}; // File changes followed by watch mode or a build server
+static int is_resident = 0;              // Set while the graph and file metadata are kept between builds
+static BuildTarget *resident_targets = NULL; // Targets the kept graph was lowered for (NULL-terminated)
+static int is_git_index = 0;             // Set while this build takes unchanged tracked inputs from the git index
+static int is_cache = 0;                 // Set while compiles and links go through the object cache
+static int cache_hits = 0;               // Actions of this build taken from the object cache
+static int cache_misses = 0;             // Actions of this build that missed it
+static int is_lazy = 0;                  // Set while cached objects stay in the cache until an action that runs reads them
+static int lazy_count = 0;               // Objects of this build left in the object cache
+static int materialized_count = 0;       // Lazy objects written out for the links and archives of this build
+
+static char WATCH_INPUT[] = "input";   // Marker of watched sources, headers and the config file
+static char WATCH_OUTPUT[] = "output"; // Marker of watched outputs and depfiles (a change only invalidates them)
+
+static void builder_open_log(void);
+static int builder_build(BuildTarget *, const char *);
+static int builder_build_pass(const char *);
+static int builder_is_lowered_for(BuildTarget *);
+static int builder_watch_open(int);
+static void builder_watch_close(void);
+static int builder_watch_path(const char *, char *);
+static int builder_watch_dep(const char *, object);
+static void builder_watch_drain(void);
+static void builder_watch_settle(void);
+static void builder_watch_cancel(void);
+static int builder_begin_run(void);
+static void builder_end_run(void);
+static void builder_scan_files(void);
+static int builder_scan_includes(void);
+static void builder_release_scan(void);
+static char *builder_list_path(const char *, char *);
+static int builder_list_dep(const char *, object);
+static int builder_select_file(const char *);
+static int builder_write_response(int);
+static void builder_log_command(int);
+static int builder_run_graph(void);
+static void builder_ready_action(int);
+static int builder_action_is_current(int);
+static void builder_end_job(int);
+static void builder_complete_action(int, ActionState, int);
+static void builder_skip_action(int);
+static void builder_record_failure(ExecJob);
+static void builder_report_failures(void);
+static void builder_reset_failures(void);
+static int builder_prepare_job(int);
+static int builder_prepare_archive(int);
+static void builder_prepare_cached(int);
+static char **builder_cached_argv(graph_action_s *);
+static int builder_cache_step(int);
+static void builder_prepare_cached_link(int);
+static int builder_link_key(int, char *);
+static int builder_find_library(graph_action_s *, const char *, char *, size_t, file_stat_s *);
+static uint64_t builder_file_digest(const char *);
+static void builder_pack_key(const char *, uint64_t *);
+static uint64_t builder_key_digest(const uint64_t *);
+static int builder_materialize_inputs(int);
+static int builder_materialize(const char *);
+static const char *builder_job_key(ExecJob);
+static int builder_is_up_to_date(const char *, uint64_t, char **, const char *, char **);
+static void builder_finish_job(ExecJob);
+static void builder_finish_virtual(graph_action_s *, build_log_entry_s *);
+static uint64_t builder_hash_file(const char *);
+static int64_t builder_newest_input(graph_action_s *);
+static int64_t builder_output_mtime_ns(const char *);
+static int builder_read_deps(const char *, DepVisitor, object);
+static int builder_tally_header(const char *, object);
+static void builder_collect_header(const char *, object, object);
+static void builder_free_header(const char *, object, object);
+static int builder_compare_headers(const void *, const void *);
+
+// Initialize the builder and its job executor
+int builder_init(BuildContext context) {
+   build_context = context;
+   max_failures = context ? context->max_failures : 1;
+   if (!Executor.init(context ? context->max_jobs : 0, context ? context->watchdog : 0)) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to initialize the job executor.\n");
       return -1;
    }
+   builder_open_log();
+   if (context && (context->cache_dir || context->remote_cache) && !is_cache &&
+       !(is_cache = ObjectCache.open(context->cache_dir, context->remote_cache))) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Object cache unavailable; compiling without it\n");
+   }
+   is_lazy = is_cache && context && context->is_lazy_objects;
+   if (context && context->is_lazy_objects && !context->cache_dir && !context->remote_cache) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Lazy objects need an object cache (--cache or --remote-cache); writing every object\n");
+   }
+
+   return 0;
+}
+// Open the build log: it tells which outputs are current and feeds the watchdog; without it everything rebuilds
+static void builder_open_log(void) {
+   const char *state_dir = build_context && build_context->config ? build_context->config->build_dir : NULL;
+   if (state_dir) Files.make_dirs(state_dir);
+   BuildLog.open(state_dir);
+}
+// Build the requested targets and their dependencies: lower them into one action graph, then run it in one pool
+int builder_build_targets(BuildTarget *targets) {
+   return builder_build(targets, NULL);
+}
+// Build only what one source or output file needs, searching the given targets for it
+int builder_build_file(BuildTarget *targets, const char *path) {
+   if (!path || !*path) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Invalid build file specified.\n");
+      return -1;
+   }
+   return builder_build(targets, path);
+}
+// Lower the targets, narrow the graph to one file's actions if requested, and run it
+static int builder_build(BuildTarget *targets, const char *path) {
+   if (!targets || !*targets) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Invalid build target specified.\n");
+      return -1; // Return error if no target was given
+   }
+
+   // Resident state follows changes through inotify; otherwise the git index may vouch for tracked inputs
+   // (fsmonitor is asked for the modified files while the graph is lowered)
+   if (!is_resident && build_context && build_context->is_git_index) {
+      is_git_index = GitIndex.open(build_context->config ? build_context->config->build_dir : NULL);
+   }
+   // A resident graph is kept for the next build of the same targets; their files' changes are applied first
+   if (!is_resident || !builder_is_lowered_for(targets)) {
+      if (graph) builder_release_scan();
+      ActionGraphs.dispose(graph);
+      graph = ActionGraphs.lower(build_context ? build_context->config : NULL, targets);
+   }
+   if (is_resident) builder_watch_drain();
+   int result = graph ? builder_build_pass(path) : -1;
+   if (is_git_index) GitIndex.close(); // Not reached by a pass
+   is_git_index = 0;
+   if (!is_resident) {
+      ActionGraphs.dispose(graph);
+      graph = NULL;
+   }
+
+   return result;
+}
+// Check whether the resident graph was lowered for these targets, remembering them if not
+static int builder_is_lowered_for(BuildTarget *targets) {
+   int count = 0;
+   while (targets[count]) count++;
+   if (graph && resident_targets) {
+      int i = 0;
+      while (i < count && resident_targets[i] == targets[i]) i++;
+      if (i == count && !resident_targets[i]) return SB_TRUE;
+   }
+   free(resident_targets);
+   if ((resident_targets = calloc(count + 1, sizeof(BuildTarget)))) memcpy(resident_targets, targets, count * sizeof(BuildTarget));
+   return SB_FALSE;
+}
+// Keep the graph and file metadata between builds (a build server), following file changes through inotify; or release them
+int builder_resident(int is_kept) {
+   if (is_resident) {
+      builder_watch_close();
+      if (graph) builder_release_scan();
+      ActionGraphs.dispose(graph);
+      graph = NULL;
+      free(resident_targets);
+      resident_targets = NULL;
+      FileStats.reset();
+      is_resident = 0;
+   }
+   if (!is_kept) return 0;
+   if (graph || !builder_watch_open(SB_FALSE)) return -1;
 
-   return 0; // Return success
+   if (build_context && build_context->config_file) builder_watch_path(build_context->config_file, WATCH_INPUT);
+   is_resident = 1;
+   return 0;
+}
+// Apply the file changes seen since the last build to the resident state
+int builder_refresh(void) {
+   if (watch.fd >= 0) builder_watch_drain();
+   builder_open_log(); // Re-read: a build run outside the server may have rewritten it
+   return watch.is_reload ? BUILDER_WATCH_RELOAD : 0;
 }
-// Execute op target
-int builder_exec_op_target(BuildTarget target) {
-   if (!target || !target->name) {
+// Keep the lowered graph and file metadata in memory and rebuild whenever a watched file changes
+int builder_watch(BuildTarget *targets, const char *path) {
+   if (!targets || !*targets) {
       Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Invalid build target specified.\n");
-      return -1; // Return error if target is NULL or has no name
+      return -1;
+   }
+
+   if (is_resident) builder_resident(SB_FALSE);
+   graph = ActionGraphs.lower(build_context ? build_context->config : NULL, targets);
+   int result = graph && builder_watch_open(SB_TRUE) ? 0 : -1;
+   if (result == 0 && path && ActionGraphs.find_file(graph, path) < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "No action of the requested targets builds %s\n", path);
+      result = -1;
+   }
+   if (result == 0 && build_context && build_context->config_file) builder_watch_path(build_context->config_file, WATCH_INPUT);
+
+   while (result == 0 && !Executor.interrupted() && !watch.is_reload) {
+      watch.change_count = 0;
+      builder_build_pass(path); // A failed pass is reported; the next change gets another one
+      if (watch.change_count == 0 && !Executor.interrupted() && !watch.is_reload) {
+         Logger.writeln("Watching %zu file(s) for changes (Ctrl-C to stop)", StringMaps.count(watch.paths));
+      }
+      while (watch.change_count == 0 && !Executor.interrupted()) {
+         Executor.wait(); // Nothing runs between passes: returns once a change (or an interrupt) arrives
+         builder_watch_drain();
+      }
+      builder_watch_settle();
+      if (!Executor.interrupted() && !watch.is_reload) Logger.writeln("%d file(s) changed", watch.change_count);
+   }
+   if (result == 0 && watch.is_reload) result = BUILDER_WATCH_RELOAD;
+
+   builder_watch_close();
+   if (graph) builder_release_scan();
+   ActionGraphs.dispose(graph);
+   graph = NULL;
+   FileStats.reset();
+
+   return result;
+}
+// Run one build of the lowered graph (narrowed to one file's actions if requested)
+static int builder_build_pass(const char *path) {
+   builder_reset_failures();
+   cache_hits = cache_misses = 0;
+   lazy_count = materialized_count = 0;
+   int result = builder_begin_run() ? 0 : -1;
+   int selected = result == 0 && path ? builder_select_file(path) : -1;
+   if (path && selected < 0) result = -1;
+
+   for (int i = 0; result == 0 && i < graph->target_count; i++) {
+      graph_target_s *target = graph->targets[i];
+      if (target->final < 0 || runs[target->final].state == ACTION_IDLE) continue;
+      if (graph->actions[target->final]->kind == ACTION_COMMAND) {
+         Logger.debug(Logger.log_stream(), LOG_NORMAL, DBG_INFO, "Executing operation target: %s", target->target->name);
+      } else {
+         Logger.writeln("Building target: %s", target->target->name);
+      }
+   }
+   if (result == 0) builder_scan_files();
+   if (result == 0) result = builder_run_graph();
+
+   builder_report_failures();
+   for (int i = 0; result == 0 && i < graph->target_count; i++) {
+      graph_target_s *target = graph->targets[i];
+      if (target->final >= 0 && target_runs[i].ran_count == 0 && graph->actions[target->final]->kind != ACTION_COMMAND &&
+          runs[target->final].state == ACTION_DONE) {
+         Logger.writeln("Target %s is up to date", target->target->name);
+      }
+   }
+   // A file asked for by name is written out, lazy or not
+   if (result == 0 && selected >= 0 && is_lazy && builder_materialize(graph->actions[selected]->output) <= 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to write %s out of the object cache\n", graph->actions[selected]->output);
+      result = -1;
+   }
+   if (result == 0 && selected >= 0 && target_runs[graph->actions[selected]->target->id].ran_count == 0) {
+      Logger.writeln("%s is up to date", graph->actions[selected]->output);
+   }
+   if (cache_hits + cache_misses > 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Object cache: %d hit(s), %d miss(es)\n", cache_hits, cache_misses);
+   }
+   if (lazy_count + materialized_count > 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Lazy objects: %d left in the cache, %d written out\n", lazy_count,
+                   materialized_count);
+   }
+   if (is_git_index) GitIndex.close(); // Snapshots the metadata the build holds, before it is forgotten
+   is_git_index = 0;
+   builder_end_run();
+
+   return result;
+}
+// Suggest headers worth precompiling: rank each target's headers by inclusion count x size from the recorded depfiles
+// (compiles without one are scanned for their includes)
+int builder_report_headers(BuildTarget *targets) {
+   graph = ActionGraphs.plan(build_context ? build_context->config : NULL, targets);
+   if (!graph) return -1;
+
+   int result = 0;
+   for (int i = 0; result == 0 && i < graph->target_count; i++) {
+      graph_target_s *target = graph->targets[i];
+      header_tally_s tally = {.headers = StringMaps.create()};
+      int unit_count = 0, scanned_count = 0;
+      scan_unit_s *units = calloc(graph->action_count + 1, sizeof(scan_unit_s));
+      int *unit_ids = calloc(graph->action_count + 1, sizeof(int));
+      for (int id = 0; tally.headers && units && unit_ids && id < graph->action_count; id++) {
+         tally.action = graph->actions[id];
+         if (tally.action->target != target || tally.action->kind != ACTION_COMPILE || id == target->pch) continue;
+         if (builder_read_deps(tally.action->dep_path, builder_tally_header, &tally)) {
+            unit_count++;
+         } else {
+            // Not built yet (or the depfile is gone): the include scanner finds its headers
+            // instead (a unity file is not written for a report, so its members are scanned without it)
+            char **sources = tally.action->inputs + (tally.action->is_unity ? 1 : 0);
+            units[scanned_count] = (scan_unit_s){.sources = sources, .args = tally.action->argv};
+            unit_ids[scanned_count++] = id;
+         }
+      }
+      if (scanned_count > 0) IncludeScanner.scan(units, scanned_count);
+      int is_tallied = units && unit_ids;
+      for (int j = 0; j < scanned_count; j++) {
+         tally.action = graph->actions[unit_ids[j]];
+         for (char **header = units[j].headers; is_tallied && header && *header; header++) {
+            is_tallied = builder_tally_header(*header, &tally);
+         }
+         if (units[j].headers) unit_count++;
+         free(units[j].headers);
+      }
+      free(units);
+      free(unit_ids);
+      if (!is_tallied) result = -1;
+      size_t count = StringMaps.count(tally.headers);
+      header_use_s *uses = calloc(count + 1, sizeof(header_use_s));
+      if (!tally.headers || !uses) result = -1;
+      if (result == 0 && count > 0) {
+         header_use_s *next = uses;
+         StringMaps.each(tally.headers, builder_collect_header, &next);
+         qsort(uses, count, sizeof(header_use_s), builder_compare_headers);
+
+         Logger.writeln("Precompiled header candidates for %s (%d translation units, %d scanned for includes):",
+                        target->target->name, unit_count, scanned_count);
+         Logger.writeln("  %12s %6s %9s  %s", "score", "units", "bytes", "header");
+         for (size_t j = 0; j < count && j < BUILDER_REPORT_HEADERS; j++) {
+            Logger.writeln("  %12lld %6d %9ld  %s", (long long)uses[j].unit_count * uses[j].size, uses[j].unit_count,
+                           uses[j].size, uses[j].path);
+         }
+         if (uses[0].unit_count * 2 >= unit_count) Logger.writeln("  suggested: \"%s\": \"%s\"", CONFIG_TARGET_PCH, uses[0].path);
+      } else if (result == 0) {
+         Logger.writeln("No project headers found for %s", target->target->name);
+      }
+      StringMaps.each(tally.headers, builder_free_header, NULL);
+      StringMaps.dispose(tally.headers);
+      free(uses);
+   }
+   ActionGraphs.dispose(graph);
+   graph = NULL;
+   FileStats.reset();
+   IncludeScanner.reset();
+
+   return result;
+}
+// Depfile visitor: count one more translation unit including a header (the unit's own sources are not headers)
+static int builder_tally_header(const char *path, object data) {
+   header_tally_s *tally = data;
+   size_t path_len = strlen(path);
+   for (char **input = tally->action->inputs; *input; input++) {
+      // Unity members show up by their path from the unity file (`<build_dir>../<member>`)
+      size_t input_len = strlen(*input);
+      if (strcmp(*input, path) == 0 || (path_len > input_len && path[path_len - input_len - 1] == '/' &&
+                                         strcmp(path + path_len - input_len, *input) == 0)) {
+         return SB_TRUE;
+      }
+   }
+
+   header_use_s *use = StringMaps.get(tally->headers, path);
+   if (!use) {
+      file_stat_s st;
+      addr use_addr;
+      if (!FileStats.get(path, &st)) return SB_TRUE; // Gone since the depfile was written
+      if (!Resources.alloc(&use_addr, sizeof(header_use_s))) return SB_FALSE;
+      use = (header_use_s *)use_addr;
+      use->size = (long)st.size;
+      if (!StringMaps.put(tally->headers, path, use)) {
+         free(use);
+         return SB_FALSE;
+      }
+   }
+   use->unit_count++;
+   return SB_TRUE;
+}
+// Map visitor: copy a tallied header into the report array
+static void builder_collect_header(const char *path, object value, object data) {
+   header_use_s **next = data;
+   **next = *(header_use_s *)value;
+   (*next)->path = (string)path;
+   (*next)++;
+}
+// Map visitor: free a tallied header
+static void builder_free_header(const char *path, object value, object data) {
+   free(value);
+}
+// Order headers by score (inclusions x size), highest first
+static int builder_compare_headers(const void *a, const void *b) {
+   const header_use_s *x = a, *y = b;
+   long long x_score = (long long)x->unit_count * x->size, y_score = (long long)y->unit_count * y->size;
+   return (x_score < y_score) - (x_score > y_score);
+}
+// Allocate the per-build state of every action and target of the graph
+static int builder_begin_run(void) {
+   addr runs_addr, targets_addr, ready_addr;
+   // The queue has room for each action twice: a compile whose lazy object the cache lost is queued again
+   if (!Resources.alloc(&runs_addr, (graph->action_count + 1) * sizeof(action_run_s)) ||
+       !Resources.alloc(&targets_addr, (graph->target_count + 1) * sizeof(target_run_s)) ||
+       !Resources.alloc(&ready_addr, (2 * graph->action_count + 1) * sizeof(int))) {
+      return SB_FALSE;
+   }
+   runs = (action_run_s *)runs_addr;
+   target_runs = (target_run_s *)targets_addr;
+   ready = (int *)ready_addr;
+   if (!action_deps && !(action_deps = calloc(graph->action_count + 1, sizeof(char **)))) return SB_FALSE;
+   if (!action_verified && !(action_verified = calloc(graph->action_count + 1, sizeof(uint64_t)))) return SB_FALSE;
+   ready_head = ready_tail = 0;
+
+   long now = get_monotonic_ms();
+   for (int i = 0; i < graph->target_count; i++) {
+      long timeout_ms = graph->targets[i]->target->timeout_ms;
+      target_runs[i].deadline_ms = timeout_ms > 0 ? now + timeout_ms : 0;
+   }
+   for (int i = 0; i < graph->action_count; i++) {
+      graph_action_s *action = graph->actions[i];
+      runs[i].state = ACTION_WAITING;
+      runs[i].pending = action->dependency_count;
+      runs[i].job.label = action->label;
+      runs[i].job.command = action->command;
+      runs[i].job.argv = action->argv;
+      runs[i].job.output = action->output;
+      runs[i].job.data = &runs[i];
+   }
+   return SB_TRUE;
+}
+// Stat every file the freshness checks will read in two parallel batches: outputs, inputs and depfiles
+// first, then the headers listed by the depfiles of outputs that exist or are lazy objects (or found by the
+// include scanner when a depfile is gone). Each depfile is read once here and its headers kept for the action,
+// so the checks themselves only hit the cache. While file changes
+// are watched the list and headers outlive the build: only depfiles rewritten since are read again.
+static void builder_scan_files(void) {
+   long start_ms = get_monotonic_ms();
+   int is_listed = scan.seen || (scan.seen = StringMaps.create()) != NULL;
+   for (int i = 0; is_listed && i < graph->action_count; i++) {
+      graph_action_s *action = graph->actions[i];
+      if (runs[i].state == ACTION_IDLE || action->kind == ACTION_COMMAND) continue;
+      // The inputs of links and archives are outputs too: their events only invalidate metadata
+      char *input_marker = action->kind == ACTION_COMPILE ? WATCH_INPUT : WATCH_OUTPUT;
+      is_listed = builder_list_path(action->output, WATCH_OUTPUT) &&
+                  (!action->dep_path || builder_list_path(action->dep_path, WATCH_OUTPUT));
+      for (char **input = action->inputs; is_listed && *input; input++) is_listed = builder_list_path(*input, input_marker) != NULL;
+   }
+   int scanned = is_listed ? FileStats.scan(scan.paths, scan.count) : 0;
+
+   int first_header = scan.count;
+   for (int i = 0; is_listed && i < graph->action_count; i++) {
+      graph_action_s *action = graph->actions[i];
+      if (runs[i].state == ACTION_IDLE || !action->dep_path || action_deps[i] || builder_output_mtime_ns(action->output) < 0) continue;
+      dep_list_s deps = {0};
+      if (builder_read_deps(action->dep_path, builder_list_dep, &deps) && builder_list_dep(NULL, &deps)) {
+         action_deps[i] = deps.paths;
+      } else {
+         free(deps.paths); // Unreadable: the check reads the depfile itself (and finds the output stale)
+      }
+   }
+   if (is_listed) builder_scan_includes();
+   if (is_listed) scanned += FileStats.scan(scan.paths + first_header, scan.count - first_header);
+   Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Scanned %d file(s) in %ld ms (%d headers)\n", scanned,
+                get_monotonic_ms() - start_ms, scan.count - first_header);
+}
+// Find the headers of compiles whose depfile is missing but whose output the log holds, with the include scanner,
+// so they are checked against their headers like the others instead of rebuilt; returns the number found
+static int builder_scan_includes(void) {
+   scan_unit_s *units = calloc(graph->action_count + 1, sizeof(scan_unit_s));
+   int *unit_ids = calloc(graph->action_count + 1, sizeof(int));
+   int count = 0;
+   file_stat_s st;
+   build_log_entry_s entry;
+   for (int i = 0; units && unit_ids && i < graph->action_count; i++) {
+      graph_action_s *action = graph->actions[i];
+      if (runs[i].state == ACTION_IDLE || action->kind != ACTION_COMPILE || !action->dep_path || action_deps[i] ||
+          !FileStats.get(action->output, &st) || !BuildLog.lookup(action->output, &entry) || entry.mtime_ns != st.mtime_ns ||
+          entry.command_hash != action->signature) {
+         continue; // Already known, or stale whatever its headers
+      }
+      units[count] = (scan_unit_s){.sources = action->inputs, .args = action->argv};
+      unit_ids[count++] = i;
+   }
+   long start_ms = get_monotonic_ms();
+   int known = count > 0 ? IncludeScanner.scan(units, count) : 0;
+   for (int i = 0; i < count; i++) {
+      dep_list_s deps = {0};
+      int is_listed = units[i].headers != NULL;
+      for (char **header = units[i].headers; is_listed && *header; header++) is_listed = builder_list_dep(*header, &deps);
+      if (is_listed && builder_list_dep(NULL, &deps)) {
+         action_deps[unit_ids[i]] = deps.paths;
+      } else {
+         free(deps.paths); // Unknown (a computed include): the check finds the output stale
+      }
+      free(units[i].headers);
+   }
+   free(units);
+   free(unit_ids);
+   if (count > 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Scanned the includes of %d compile(s) without depfiles in %ld ms (%d known)\n",
+                   count, get_monotonic_ms() - start_ms, known);
+   }
+   return known;
+}
+// List a path for the scan once, watching it (with its marker) while file changes are watched; returns the
+// listed copy (NULL if out of memory)
+static char *builder_list_path(const char *path, char *marker) {
+   char *copy = StringMaps.get(scan.seen, path);
+   if (copy) return copy;
+   if (scan.count == scan.cap) {
+      int cap = scan.cap ? scan.cap * 2 : 256;
+      char **grown = realloc(scan.paths, cap * sizeof(char *));
+      if (!grown) return NULL;
+      scan.paths = grown;
+      scan.cap = cap;
+   }
+   if (!(copy = strdup(path)) || !StringMaps.put(scan.seen, copy, copy)) {
+      free(copy);
+      return NULL;
+   }
+   if (watch.fd >= 0) builder_watch_path(copy, marker);
+   file_stat_s st;
+   if (is_git_index && marker == WATCH_INPUT && GitIndex.lookup(copy, &st)) FileStats.assume(copy, &st); // Not stat'ed
+   return scan.paths[scan.count++] = copy;
+}
+// Depfile visitor: list a header for the scan and add it to the action's dep list (NULL terminates the list)
+static int builder_list_dep(const char *path, object data) {
+   dep_list_s *deps = data;
+   char *listed = path ? builder_list_path(path, WATCH_INPUT) : NULL;
+   if (path && !listed) return SB_FALSE;
+   if (deps->count == deps->cap) {
+      int cap = deps->cap ? deps->cap * 2 : 16;
+      char **grown = realloc(deps->paths, cap * sizeof(char *));
+      if (!grown) return SB_FALSE;
+      deps->paths = grown;
+      deps->cap = cap;
+   }
+   deps->paths[deps->count++] = listed;
+   return SB_TRUE;
+}
+// Release the scan list and the headers read from depfiles
+static void builder_release_scan(void) {
+   for (int i = 0; action_deps && i < graph->action_count; i++) free(action_deps[i]);
+   free(action_deps);
+   action_deps = NULL;
+   free(action_verified);
+   action_verified = NULL;
+   for (int i = 0; i < scan.count; i++) free(scan.paths[i]);
+   free(scan.paths);
+   StringMaps.dispose(scan.seen);
+   memset(&scan, 0, sizeof(scan));
+}
+// Release the per-build state
+static void builder_end_run(void) {
+   for (int i = 0; runs && i < graph->action_count; i++) {
+      free(runs[i].member_argv);
+      free(runs[i].cache_argv);
+   }
+   free(runs);
+   free(target_runs);
+   free(ready);
+   runs = NULL;
+   target_runs = NULL;
+   ready = NULL;
+   ready_head = ready_tail = 0;
+   // Files may change before the next build (unless each change is heard of)
+   if (watch.fd < 0) {
+      builder_release_scan();
+      FileStats.reset();
+   }
+}
+// Find the action producing (or compiling) a file and idle every action it does not need
+static int builder_select_file(const char *path) {
+   int selected = ActionGraphs.find_file(graph, path);
+   if (selected < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "No action of the requested targets builds %s\n", path);
+      return -1;
    }
 
-   Logger.debug(Logger.log_stream(), LOG_NORMAL, DBG_INFO, "Executing operation target: %s", target->name);
+   // Dependencies always have lower ids than their dependents, so one backward pass finds them all
+   for (int i = graph->action_count - 1; i >= 0; i--) {
+      graph_action_s *action = graph->actions[i];
+      int is_needed = i == selected;
+      for (int j = 0; !is_needed && j < action->dependent_count; j++) {
+         is_needed = runs[action->dependents[j]].state == ACTION_WAITING;
+      }
+      if (!is_needed) runs[i].state = ACTION_IDLE;
+   }
+
+   return selected;
+}
+// Run the graph's actions through the executor, keeping every slot busy; returns non-zero if any did not finish
+static int builder_run_graph(void) {
+   for (int i = 0; i < graph->action_count; i++) {
+      if (runs[i].pending == 0 && runs[i].state == ACTION_WAITING) builder_ready_action(i);
+   }
+
+   while (SB_TRUE) {
+      // Fill free slots until the failure policy says stop
+      while (!is_stopping && ready_head < ready_tail && Executor.has_slot()) {
+         int id = ready[ready_head++];
+         ExecJob job = &runs[id].job;
+         int is_prepared = builder_prepare_job(id);
+         if (is_prepared && runs[id].pending > 0) continue; // Waits for lazy objects the cache lost to be compiled again
+         if (is_prepared && runs[id].is_fetched) {
+            builder_end_job(id); // Taken from the object cache: nothing runs
+            continue;
+         }
+         builder_log_command(id);
+         if (!is_prepared || !Executor.start(job)) {
+            builder_record_failure(job);
+            builder_complete_action(id, ACTION_FAILED, SB_FALSE);
+            continue;
+         }
+         runs[id].state = ACTION_RUNNING;
+      }
+      if (Executor.running() == 0) break;
 
-   // Execute each command in the target
-   for (char **cmd = target->commands; cmd && *cmd; cmd++) {
-      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executing command: %s\n", *cmd);
-      if (system(*cmd) != 0) {
-         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to execute command: %s\n", *cmd);
-         return -1; // Return error if command execution fails
+      ExecJob done = Executor.wait();
+      if (!done && watch.is_live && !Executor.interrupted()) {
+         // Watched files changed: restart the compiles reading them, or stop for a config reload
+         builder_watch_drain();
+         builder_watch_cancel();
+         if (watch.is_reload && !is_stopping) {
+            is_stopping = 1;
+            Executor.terminate(SIGTERM);
+         }
+         continue;
+      }
+      if (!done && !is_stopping && Executor.running() > 0 && !Executor.interrupted()) {
+         // The caller's descriptor woke the wait (a build server's client hung up): stop like an interrupt
+         Executor.watch(-1);
+         is_stopping = 1;
+         Executor.terminate(SIGTERM);
+         continue;
       }
+      if (!done) break;
+      int id = (int)((action_run_s *)done->data - runs);
+      if (runs[id].cache_step != CACHE_NONE && builder_cache_step(id)) continue; // Now compiling the preprocessed unit
+      builder_end_job(id);
    }
 
-   return 0; // Return success
+   // Actions that never ran because of a failure or the stop still count against the build
+   for (int i = 0; i < graph->action_count; i++) {
+      if (runs[i].state != ACTION_DONE && runs[i].state != ACTION_IDLE) return -1;
+   }
+   return 0;
+}
+// Settle a finished job: move its output into place, then complete the action (or queue it again if an input changed)
+static void builder_end_job(int id) {
+   ExecJob done = &runs[id].job;
+   builder_finish_job(done);
+   // Interrupted: let running jobs wind down (they got the signal) and start nothing new
+   if (Executor.interrupted()) is_stopping = 1;
+   if (runs[id].is_superseded && !is_stopping) {
+      // Run it again ahead of the queue on the new contents (its slot in the queue is free again)
+      Logger.writeln("Restarting %s: an input changed", done->label);
+      runs[id].is_superseded = 0;
+      runs[id].job.argv = graph->actions[id]->argv;
+      runs[id].state = ACTION_READY;
+      ready[--ready_head] = id;
+      return;
+   }
+   if (done->status == 0) {
+      target_runs[graph->actions[id]->target->id].ran_count++;
+      builder_complete_action(id, ACTION_DONE, !runs[id].is_unchanged);
+   } else {
+      // Jobs finishing after the stop were terminated by us; they are not failures of their own
+      if (!is_stopping && !runs[id].is_superseded) builder_record_failure(done);
+      builder_complete_action(id, ACTION_FAILED, SB_TRUE);
+   }
+   // Fail fast: terminate in-flight jobs as soon as the limit is reached
+   if (is_stopping && Executor.running() > 0) Executor.terminate(SIGTERM);
+}
+// Queue an action whose dependencies have finished, completing it at once if its output is current
+static void builder_ready_action(int id) {
+   if (builder_action_is_current(id)) {
+      builder_complete_action(id, ACTION_DONE, SB_FALSE);
+      return;
+   }
+   runs[id].state = ACTION_READY;
+   ready[ready_tail++] = id;
+}
+// Check whether an action can be skipped because its output is up to date
+static int builder_action_is_current(int id) {
+   graph_action_s *action = graph->actions[id];
+   // No file metadata was forgotten since the action was last found current: it still is (kept between builds)
+   uint64_t verified = FileStats.generation() + 1;
+   int is_current;
+   switch (action->kind) {
+   case ACTION_COMPILE:
+      is_current = action_verified[id] == verified ||
+                   builder_is_up_to_date(action->output, action->signature, action->inputs, action->dep_path, action_deps[id]);
+      break;
+   case ACTION_LINK:
+   case ACTION_ARCHIVE:
+      // Relink (or re-archive) only if an object or dependency was rebuilt or the output is otherwise stale
+      is_current = !runs[id].is_dep_ran &&
+                   (action_verified[id] == verified || builder_is_up_to_date(action->output, action->signature, action->inputs, NULL, NULL));
+      break;
+   default:
+      return SB_FALSE; // Commands always run
+   }
+   if (is_current) action_verified[id] = verified;
+   return is_current;
+}
+// Finish an action and release (or skip) the actions waiting on it
+static void builder_complete_action(int id, ActionState state, int is_ran) {
+   graph_action_s *action = graph->actions[id];
+   runs[id].state = state;
+   for (int i = 0; i < action->dependent_count; i++) {
+      int dependent = action->dependents[i];
+      if (state != ACTION_DONE) {
+         builder_skip_action(dependent);
+         continue;
+      }
+      if (is_ran) runs[dependent].is_dep_ran = 1;
+      if (--runs[dependent].pending == 0 && runs[dependent].state == ACTION_WAITING) builder_ready_action(dependent);
+   }
+}
+// Skip an action (and everything waiting on it) because a dependency failed
+static void builder_skip_action(int id) {
+   if (runs[id].state != ACTION_WAITING) return;
+
+   runs[id].state = ACTION_SKIPPED;
+   skipped_count++;
+   for (int i = 0; i < graph->actions[id]->dependent_count; i++) builder_skip_action(graph->actions[id]->dependents[i]);
+}
+// Get a file's modification time in nanoseconds (-1 if it does not exist)
+static int64_t builder_mtime_ns(const char *path) {
+   file_stat_s st;
+   FileStats.get(path, &st);
+
+   return st.mtime_ns;
+}
+// Visit the prerequisites of a make-style depfile; returns 0 if it is unreadable or the visitor stopped
+static int builder_read_deps(const char *dep_path, DepVisitor visitor, object data) {
+   char *buffer = NULL;
+   FILE *file = fopen(dep_path, "r");
+   if (!file) return SB_FALSE; // No depfile: the header set is unknown
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   rewind(file);
+   if (size <= 0 || !(buffer = malloc(size + 1)) || fread(buffer, 1, size, file) != (size_t)size) {
+      fclose(file);
+      free(buffer);
+      return SB_FALSE;
+   }
+   fclose(file);
+   buffer[size] = '\0';
+
+   // Skip the rule target, then walk the whitespace-separated prerequisites
+   char *p = strchr(buffer, ':');
+   int is_visited = p != NULL;
+   char path[4096];
+   while (is_visited && *++p) {
+      if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') continue;
+      if (*p == '\\' && p[1] == '\n') {
+         p++; // Line continuation
+         continue;
+      }
+      size_t len = 0;
+      for (; *p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r'; p++) {
+         if (*p == '\\' && p[1] == '\n') break;
+         if ((*p == '\\' && p[1] == ' ') || (*p == '$' && p[1] == '$')) p++; // Escaped space or dollar
+         if (len < sizeof(path) - 1) path[len++] = *p;
+      }
+      path[len] = '\0';
+      p--; // Re-examine the separator that ended the path
+
+      is_visited = visitor(path, data);
+   }
+   free(buffer);
+
+   return is_visited;
+}
+// Depfile visitor: continue while the header exists and is older than the output
+static int builder_is_dep_older(const char *path, object data) {
+   int64_t dep_mtime = builder_mtime_ns(path);
+   int is_older = dep_mtime >= 0 && dep_mtime <= *(int64_t *)data;
+   if (!is_older) Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s changed\n", path);
+
+   return is_older;
+}
+// Check the headers listed in a make-style depfile; returns 1 if all exist and are older than mtime
+static int builder_deps_older(const char *dep_path, int64_t mtime) {
+   return builder_read_deps(dep_path, builder_is_dep_older, &mtime);
+}
+// Check whether an output is up to date: produced by this exact command and newer than its inputs
+// and headers (taken from `deps` when the scan read the depfile, else from the depfile itself)
+static int builder_is_up_to_date(const char *output, uint64_t signature, char **inputs, const char *dep_path, char **deps) {
+   int64_t mtime = builder_output_mtime_ns(output);
+   if (mtime < 0) return SB_FALSE;
+
+   // The log proves the output was completed (not left over from an interrupted run) by this command
+   build_log_entry_s entry;
+   if (!BuildLog.lookup(output, &entry) || entry.mtime_ns != mtime ||
+       entry.command_hash != signature) {
+      return SB_FALSE;
+   }
+   // A rebuild that left the output unchanged kept its old mtime; it is current for inputs up to restat_ns
+   if (entry.restat_ns > mtime) mtime = entry.restat_ns;
+   for (char **input = inputs; input && *input; input++) {
+      int64_t input_mtime = builder_output_mtime_ns(*input);
+      if (input_mtime < 0 || input_mtime > mtime) return SB_FALSE;
+   }
+   for (char **dep = deps; dep && *dep; dep++) {
+      if (!builder_is_dep_older(*dep, &mtime)) return SB_FALSE;
+   }
+   return dep_path && !deps ? builder_deps_older(dep_path, mtime) : SB_TRUE;
+}
+// Move a finished job's temp output into place (or discard it) and journal the result
+static void builder_finish_job(ExecJob job) {
+   graph_action_s *action = graph->actions[(action_run_s *)job->data - runs];
+   if (action->rsp_arg) unlink(action->rsp_arg + 1);
+   // Outputs changed: an op command may have written anything
+   if (action->kind == ACTION_COMMAND) FileStats.reset();
+   FileStats.invalidate(job->output);
+   if (job->status != 0) {
+      if (action->tmp_path) unlink(action->tmp_path); // Never leave a partial output behind
+      return;
+   }
+
+   build_log_entry_s entry = {.duration_ms = job->duration_ms, .command_hash = action->signature};
+   // A cached object keeps its key: written out or not, it can be fetched again by it
+   if (action->kind == ACTION_COMPILE && runs[action->id].cache_key[0]) builder_pack_key(runs[action->id].cache_key, entry.cache_key);
+   if (job->output && runs[action->id].is_virtual) {
+      builder_finish_virtual(action, &entry);
+   } else if (job->output) {
+      // An archive updated in place already is the output
+      int is_in_place = runs[action->id].member_argv != NULL;
+      build_log_entry_s previous;
+      int64_t mtime = builder_mtime_ns(job->output);
+      int has_previous = mtime >= 0 && BuildLog.lookup(job->output, &previous) && (is_in_place || previous.mtime_ns == mtime);
+      entry.digest = builder_hash_file(is_in_place ? job->output : action->tmp_path);
+      runs[action->id].is_unchanged = has_previous && entry.digest != 0 && entry.digest == previous.digest;
+      if (runs[action->id].is_unchanged && !is_in_place) {
+         // Early cutoff: keep the identical output and its mtime, so nothing downstream sees a change
+         unlink(action->tmp_path);
+         entry.restat_ns = builder_newest_input(action);
+      } else if (!is_in_place && rename(action->tmp_path, job->output) != 0) {
+         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to move %s into place: %s\n", job->output, strerror(errno));
+         job->status = 1;
+         return;
+      }
+      if (runs[action->id].is_unchanged) Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s unchanged\n", job->output);
+      FileStats.invalidate(job->output);
+      entry.mtime_ns = builder_mtime_ns(job->output);
+   }
+   BuildLog.record(builder_job_key(job), &entry);
+   if (action->dep_path) {
+      // The depfile was rewritten: the next scan reads it again; headers it just started listing are watched from now on
+      free(action_deps[action->id]);
+      action_deps[action->id] = NULL;
+      if (watch.fd >= 0) builder_read_deps(action->dep_path, builder_watch_dep, NULL);
+   }
+}
+// Journal a compile whose object was left in the object cache: the path holds no file and the log a stand-in mtime taken
+// now, or, when the key is the one logged, whatever an earlier build left there stays as it is (an early cutoff)
+static void builder_finish_virtual(graph_action_s *action, build_log_entry_s *entry) {
+   build_log_entry_s previous;
+   int64_t mtime = builder_output_mtime_ns(action->output);
+   entry->digest = builder_key_digest(entry->cache_key);
+   runs[action->id].is_unchanged = mtime >= 0 && BuildLog.lookup(action->output, &previous) && previous.mtime_ns == mtime &&
+                                   previous.cache_key[0] == entry->cache_key[0] && previous.cache_key[1] == entry->cache_key[1];
+   if (runs[action->id].is_unchanged) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s unchanged\n", action->output);
+      entry->mtime_ns = mtime;
+      entry->restat_ns = builder_newest_input(action);
+      return;
+   }
+   unlink(action->output); // An older object must not pass for this one
+   FileStats.invalidate(action->output);
+   struct timespec now;
+   clock_gettime(CLOCK_REALTIME_COARSE, &now); // The clock file timestamps are taken from: outputs written later are newer
+   entry->mtime_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+// Hash a file's contents (0 if it cannot be read)
+static uint64_t builder_hash_file(const char *path) {
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) close(fd);
+      return 0;
+   }
+   const unsigned char *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+   close(fd);
+   if (data == MAP_FAILED) return 0;
+
+   // FNV-1a over 8-byte words (then the tail bytes), folding the high half back in after each step
+   uint64_t hash = 1469598103934665603ULL ^ (uint64_t)st.st_size;
+   size_t size = st.st_size, i = 0;
+   for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * 1099511628211ULL;
+      hash ^= hash >> 32;
+   }
+   for (; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ULL;
+   if (data) munmap((void *)data, size);
+   return hash ? hash : 1;
+}
+// Depfile visitor: track the newest header
+static int builder_newest_dep(const char *path, object data) {
+   int64_t mtime = builder_output_mtime_ns(path);
+   if (mtime > *(int64_t *)data) *(int64_t *)data = mtime;
+   return SB_TRUE;
+}
+// Newest mtime among an action's inputs and the headers its (just written) depfile lists
+static int64_t builder_newest_input(graph_action_s *action) {
+   int64_t newest = 0;
+   for (char **input = action->inputs; input && *input; input++) builder_newest_dep(*input, &newest);
+   if (action->dep_path) builder_read_deps(action->dep_path, builder_newest_dep, &newest);
+   return newest;
+}
+// Modification time of an output, counting a lazy object (missing, the log holding its cache key) at the time logged
+static int64_t builder_output_mtime_ns(const char *path) {
+   int64_t mtime = builder_mtime_ns(path);
+   build_log_entry_s entry;
+   if (mtime >= 0 || !is_lazy || !BuildLog.lookup(path, &entry) || !(entry.cache_key[0] | entry.cache_key[1])) return mtime;
+   return entry.mtime_ns;
+}
+// Write the job's argv[1..] to the action's response file and run `<tool> @file` instead
+static int builder_write_response(int id) {
+   graph_action_s *action = graph->actions[id];
+   char **argv = runs[id].job.argv;
+   FILE *file = fopen(action->rsp_arg + 1, "w");
+   if (!file) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to write response file %s: %s\n", action->rsp_arg + 1, strerror(errno));
+      return SB_FALSE;
+   }
+   // GCC-style quoting: whitespace separates arguments, backslash escapes the next character
+   for (char **arg = argv + 1; *arg; arg++) {
+      for (const char *c = *arg; *c; c++) {
+         if (strchr(" \t\n\\'\"", *c)) fputc('\\', file);
+         fputc(*c, file);
+      }
+      fputc('\n', file);
+   }
+   if (fclose(file) != 0) return SB_FALSE;
+
+   runs[id].rsp_argv[0] = argv[0];
+   runs[id].rsp_argv[1] = action->rsp_arg;
+   runs[id].rsp_argv[2] = NULL;
+   runs[id].job.argv = runs[id].rsp_argv;
+   return SB_TRUE;
+}
+// Log the command an action is about to run (verbose only: the command line can be huge)
+static void builder_log_command(int id) {
+   graph_action_s *action = graph->actions[id];
+   if (!build_context || build_context->log_level != LOG_VERBOSE) return;
+   if (action->command) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executing: %s\n", action->command);
+      return;
+   }
+
+   char line[1024];
+   size_t len = 0;
+   char **argv = runs[id].member_argv                     ? runs[id].member_argv
+                 : runs[id].cache_step == CACHE_PREPROCESS ? runs[id].cache_argv
+                 : runs[id].cache_step == CACHE_COMPILE    ? runs[id].unit_argv
+                                                           : action->argv;
+   for (char **arg = argv; *arg && len < sizeof(line); arg++) {
+      len += snprintf(line + len, sizeof(line) - len, "%s%s", len ? " " : "", *arg);
+   }
+   if (len >= sizeof(line)) strcpy(line + sizeof(line) - 4, "...");
+   Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executing: %s%s\n", line,
+                action->rsp_arg ? " (via response file)" : "");
+}
+// Apply the target's deadline and timeouts to an action's job; returns 0 if the target is out of time
+static int builder_prepare_job(int id) {
+   graph_action_s *action = graph->actions[id];
+   ExecJob job = &runs[id].job;
+   long deadline_ms = target_runs[action->target->id].deadline_ms;
+   job->timeout_ms = action->target->action_timeout_ms;
+   if (deadline_ms > 0) {
+      long remaining = deadline_ms - get_monotonic_ms();
+      if (remaining <= 0) {
+         job->status = EXEC_STATUS_TIMED_OUT;
+         job->timed_out = 1;
+         return SB_FALSE;
+      }
+      if (job->timeout_ms == 0 || remaining < job->timeout_ms) job->timeout_ms = remaining;
+   }
+
+   build_log_entry_s entry;
+   job->expected_ms = BuildLog.lookup(builder_job_key(job), &entry) ? entry.duration_ms : 0;
+   if (action->kind == ACTION_COMPILE && is_cache) builder_prepare_cached(id);
+   if (action->kind == ACTION_LINK && is_cache) builder_prepare_cached_link(id);
+   // Lazy objects are written out for a link or archive that runs (one taken from the cache reads none)
+   if (is_lazy && (action->kind == ACTION_LINK || action->kind == ACTION_ARCHIVE) && !runs[id].is_fetched) {
+      if (!builder_materialize_inputs(id)) return SB_FALSE;
+      if (runs[id].pending > 0) return SB_TRUE;
+   }
+   if (action->kind == ACTION_ARCHIVE && !builder_prepare_archive(id)) return SB_FALSE;
+   return action->rsp_arg && !runs[id].is_fetched ? builder_write_response(id) : SB_TRUE;
+}
+// Replace only the members newer than the archive when the log proves it holds this exact member set;
+// otherwise recreate it from scratch. Either way the symbol index is written once, after all members.
+static int builder_prepare_archive(int id) {
+   graph_action_s *action = graph->actions[id];
+   int64_t mtime = builder_mtime_ns(action->output);
+   build_log_entry_s entry;
+   if (mtime < 0 || !BuildLog.lookup(action->output, &entry) || entry.mtime_ns != mtime ||
+       entry.command_hash != action->signature) {
+      unlink(action->tmp_path); // The archiver adds to an existing file: never start from a leftover
+      return SB_TRUE;
+   }
+
+   int member_count = 0;
+   for (char **input = action->inputs; *input; input++) member_count++;
+   addr argv_addr;
+   if (!Resources.alloc(&argv_addr, (action->member_index + member_count + 1) * sizeof(char *))) return SB_FALSE;
+   char **argv = runs[id].member_argv = (char **)argv_addr;
+   memcpy(argv, action->argv, (action->member_index - 1) * sizeof(char *));
+   argv += action->member_index - 1;
+   *argv++ = action->output;
+   for (char **input = action->inputs; *input; input++) {
+      if (builder_mtime_ns(*input) > mtime) *argv++ = *input;
+   }
+   runs[id].job.argv = runs[id].member_argv;
+   return SB_TRUE;
+}
+// Run a compile through the object cache: it is preprocessed first (writing the depfile), the key is taken from the
+// preprocessed unit, and on a miss the compiler reads that unit instead of preprocessing the source a second time
+static void builder_prepare_cached(int id) {
+   runs[id].cache_step = CACHE_NONE;
+   runs[id].is_virtual = 0;
+   if (!runs[id].cache_argv && !(runs[id].cache_argv = builder_cached_argv(graph->actions[id]))) return; // Compiled directly
+   char **arg = runs[id].cache_argv;
+   while (*arg) arg++;
+   runs[id].unit_argv = ++arg;
+   while (arg[1]) arg++;
+   runs[id].unit_path = *arg; // Compiled last
+   runs[id].cache_step = CACHE_PREPROCESS;
+   runs[id].job.argv = runs[id].cache_argv;
+}
+// Build a cached compile's argvs in one block: `<template> -E -fno-working-directory -MMD -MF <dep> -o <unit> <src>` (the
+// unit names no working directory, which would keep its key from matching other checkouts'), then `<template> -o <tmp>
+// <unit>`, then the unit's path. NULL for compiles the cache leaves alone: precompiled headers (the preprocessor cannot
+// use a .gch), an explicit `-x`, and sources that are neither C nor C++.
+static char **builder_cached_argv(graph_action_s *action) {
+   if (action->target->pch >= 0 || action->id == action->target->pch) return NULL;
+   int argc = 0;
+   for (char **arg = action->argv; *arg; arg++, argc++) {
+      if (strncmp(*arg, "-x", 2) == 0) return NULL;
+   }
+   if (argc < 7 || strcmp(action->argv[argc - 6], "-MMD") != 0) return NULL;
+   const char *src = action->argv[argc - 1], *ext = strrchr(src, '.');
+   const char *suffix = !ext ? NULL : strcmp(ext, ".c") == 0 ? ".i" : NULL;
+   static const char *cxx_exts[] = {".cc", ".cp", ".cxx", ".cpp", ".CPP", ".c++", ".C", NULL};
+   for (const char **cxx = cxx_exts; ext && !suffix && *cxx; cxx++) {
+      if (strcmp(ext, *cxx) == 0) suffix = ".ii";
+   }
+   if (!suffix) return NULL;
+
+   int template_count = argc - 6;
+   size_t path_len = strlen(action->tmp_path) + strlen(suffix) + 1;
+   char **argv = malloc((2 * argc + 1) * sizeof(char *) + path_len);
+   if (!argv) return NULL;
+   char *unit = (char *)(argv + 2 * argc + 1);
+   snprintf(unit, path_len, "%s%s", action->tmp_path, suffix);
+
+   char **preprocess = argv, **compile = argv + argc + 3;
+   memcpy(preprocess, action->argv, template_count * sizeof(char *));
+   preprocess[template_count] = "-E"; // Stops before compiling, whatever `-c` says
+   preprocess[template_count + 1] = "-fno-working-directory";
+   memcpy(preprocess + template_count + 2, action->argv + template_count, 6 * sizeof(char *));
+   preprocess[template_count + 6] = unit; // In place of the temp object
+   preprocess[argc + 2] = NULL;
+   memcpy(compile, action->argv, template_count * sizeof(char *));
+   compile[template_count] = "-o";
+   compile[template_count + 1] = action->tmp_path;
+   compile[template_count + 2] = unit; // Line markers keep the source's name in diagnostics and debug info
+   compile[template_count + 3] = NULL;
+   return argv;
+}
+// Take a cached action past a finished step. After preprocessing, a hit copies the object into the temp output (with lazy
+// objects, it is only checked for and left in the cache) and a miss starts compiling the preprocessed unit (returns 1);
+// after that (or a link), the output is stored for the next miss.
+static int builder_cache_step(int id) {
+   graph_action_s *action = graph->actions[id];
+   action_run_s *run = &runs[id];
+   ExecJob job = &run->job;
+   CacheStep step = run->cache_step;
+   run->cache_step = CACHE_NONE;
+   if (step != CACHE_PREPROCESS) {
+      if (step == CACHE_COMPILE) job->duration_ms += run->preprocess_ms;
+      if (job->status == 0 && run->cache_key[0] && !ObjectCache.store(run->cache_key, action->tmp_path)) {
+         Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Failed to store %s in the object cache\n", action->output);
+      }
+      if (step == CACHE_COMPILE) unlink(run->unit_path);
+      return SB_FALSE;
+   }
+   if (job->status != 0 || is_stopping || run->is_superseded || Executor.interrupted()) {
+      // Stopped between the steps: it ends like a terminated job
+      if (job->status == 0) job->status = 128 + SIGTERM;
+      unlink(run->unit_path);
+      return SB_FALSE;
+   }
+
+   if (!ObjectCache.key(run->unit_path, action->signature, run->cache_key)) run->cache_key[0] = '\0';
+   if (run->cache_key[0] && is_lazy && !run->is_lost && ObjectCache.contains(run->cache_key)) {
+      cache_hits++;
+      lazy_count++;
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s left in the object cache\n", action->output);
+      run->is_virtual = 1;
+      unlink(run->unit_path);
+      return SB_FALSE;
+   }
+   if (run->cache_key[0] && ObjectCache.fetch(run->cache_key, action->tmp_path)) {
+      cache_hits++;
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s taken from the object cache\n", action->output);
+      unlink(run->unit_path);
+      return SB_FALSE;
+   }
+   cache_misses++;
+   run->preprocess_ms = job->duration_ms;
+   run->cache_step = CACHE_COMPILE;
+   job->argv = run->unit_argv;
+   builder_log_command(id);
+   if ((action->rsp_arg && !builder_write_response(id)) || !Executor.start(job)) {
+      if (job->status == 0) job->status = EXEC_STATUS_SPAWN_FAILED;
+      run->cache_step = CACHE_NONE;
+      unlink(run->unit_path);
+      return SB_FALSE;
+   }
+   return SB_TRUE;
+}
+// Run a link through the object cache: it is keyed by what it reads, and a hit is copied into the temp output instead of
+// running the linker. Archives are left alone: they are cheap to write and usually updated in place.
+static void builder_prepare_cached_link(int id) {
+   graph_action_s *action = graph->actions[id];
+   action_run_s *run = &runs[id];
+   run->cache_step = CACHE_NONE;
+   run->is_fetched = 0;
+   if (!builder_link_key(id, run->cache_key)) return; // Linked directly
+   if (ObjectCache.fetch(run->cache_key, action->tmp_path)) {
+      cache_hits++;
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s taken from the object cache\n", action->output);
+      run->is_fetched = 1;
+      run->job.status = 0;
+      run->job.timed_out = 0;
+      run->job.duration_ms = 0;
+      return;
+   }
+   cache_misses++;
+   run->cache_step = CACHE_LINK;
+}
+// Key a link by its signature, the digests of its objects and of the outputs of the targets it depends on (the
+// libraries its flags link), and the path, size and mtime of every other library it links; returns 0 if one cannot be
+// read or found
+static int builder_link_key(int id, char *key) {
+   graph_action_s *action = graph->actions[id];
+   int count = 1 + graph->target_count;
+   for (char **input = action->inputs; *input; input++) count++;
+   for (char **arg = action->argv; *arg; arg++) count += strncmp(*arg, "-l", 2) == 0 ? 3 : 0;
+   uint64_t *values = malloc(count * sizeof(uint64_t));
+   if (!values) return SB_FALSE;
+
+   int n = 0, is_keyed = SB_TRUE;
+   values[n++] = action->signature;
+   for (char **input = action->inputs; is_keyed && *input; input++) is_keyed = (values[n++] = builder_file_digest(*input)) != 0;
+   for (int i = 0; is_keyed && i < graph->target_count; i++) {
+      int final = graph->targets[i]->final;
+      graph_action_s *dependency = final >= 0 && final != id ? graph->actions[final] : NULL;
+      for (int j = 0; dependency && dependency->output && j < dependency->dependent_count; j++) {
+         if (dependency->dependents[j] != id) continue;
+         is_keyed = (values[n++] = builder_file_digest(dependency->output)) != 0;
+         break;
+      }
+   }
+   for (char **arg = action->argv; is_keyed && *arg; arg++) {
+      if (strncmp(*arg, "-l", 2) != 0) continue;
+      const char *name = (*arg)[2] ? *arg + 2 : *++arg;
+      char path[PATH_MAX];
+      file_stat_s st;
+      is_keyed = name && builder_find_library(action, name, path, sizeof(path), &st);
+      if (!is_keyed) {
+         Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s links -l%s from an unknown place: not cached\n",
+                      action->output, name ? name : "");
+      } else if (ActionGraphs.find_file(graph, path) < 0) { // A target's output is keyed by its digest above
+         values[n++] = get_string_hash(path);
+         values[n++] = (uint64_t)st.size;
+         values[n++] = (uint64_t)st.mtime_ns;
+      }
+      if (!*arg) break;
+   }
+   if (is_keyed) ObjectCache.combine(values, n, key);
+   free(values);
+   return is_keyed;
+}
+// Find the library `-l<name>` links the way the linker does: through the -L directories in order, then LIBRARY_PATH
+// and the system directories; `-l:<file>` names the file itself. Returns 0 if none has it.
+static int builder_find_library(graph_action_s *action, const char *name, char *path, size_t size, file_stat_s *st) {
+   Toolchain toolchain = Toolchains.probe(action->argv[0]);
+   const char *triple = toolchain && *toolchain->triple ? toolchain->triple : NULL;
+   int is_static = 0, dir_count = 0;
+   for (char **arg = action->argv; *arg; arg++) is_static |= strcmp(*arg, "-static") == 0;
+   for (char **arg = action->argv; *arg; arg++) dir_count += strncmp(*arg, "-L", 2) == 0;
+   const char *env = getenv("LIBRARY_PATH");
+   char *library_path = env ? strdup(env) : NULL;
+   for (const char *c = library_path; c && *c; c++) dir_count += *c == ':';
+   const char **dirs = calloc(dir_count + 16, sizeof(char *));
+   if (!dirs || (env && !library_path)) {
+      free(dirs);
+      free(library_path);
+      return SB_FALSE;
+   }
+
+   int n = 0;
+   for (char **arg = action->argv; *arg; arg++) {
+      if (strncmp(*arg, "-L", 2) == 0 && ((*arg)[2] || arg[1])) dirs[n++] = (*arg)[2] ? *arg + 2 : *++arg;
+   }
+   char *save = NULL;
+   for (char *dir = library_path ? strtok_r(library_path, ":", &save) : NULL; dir; dir = strtok_r(NULL, ":", &save)) {
+      dirs[n++] = dir;
+   }
+   char multiarch[4][256] = {{0}};
+   if (triple) {
+      snprintf(multiarch[0], sizeof(multiarch[0]), "/usr/local/lib/%s", triple);
+      snprintf(multiarch[1], sizeof(multiarch[1]), "/lib/%s", triple);
+      snprintf(multiarch[2], sizeof(multiarch[2]), "/usr/lib/%s", triple);
+   }
+   const char *system_dirs[] = {multiarch[0], "/usr/local/lib", multiarch[1], multiarch[2], "/lib64", "/usr/lib64",
+                                "/lib", "/usr/lib"};
+   for (size_t i = 0; i < sizeof(system_dirs) / sizeof(system_dirs[0]); i++) {
+      if (*system_dirs[i]) dirs[n++] = system_dirs[i];
+   }
+
+   // A directory holding the shared library wins over a later one holding the archive, as with the linker
+   int is_found = SB_FALSE;
+   for (int i = 0; !is_found && i < n; i++) {
+      for (int shared = is_static ? 0 : 1; !is_found && shared >= 0; shared--) {
+         int len = name[0] == ':' ? snprintf(path, size, "%s/%s", dirs[i], name + 1)
+                                  : snprintf(path, size, "%s/lib%s%s", dirs[i], name, shared ? ".so" : ".a");
+         is_found = len > 0 && (size_t)len < size && FileStats.get(path, st) && st->mtime_ns >= 0;
+         if (name[0] == ':') break;
+      }
+   }
+   free(dirs);
+   free(library_path);
+   return is_found;
+}
+// Digest of an output: while it is still the file logged, one standing for its cache key (the same whether the object
+// was written out or not) or the one logged with it, else hashed now (0 if unreadable)
+static uint64_t builder_file_digest(const char *path) {
+   build_log_entry_s entry;
+   int64_t mtime = builder_output_mtime_ns(path);
+   if (mtime < 0) return 0;
+   if (BuildLog.lookup(path, &entry) && entry.mtime_ns == mtime) {
+      if (entry.cache_key[0] | entry.cache_key[1]) return builder_key_digest(entry.cache_key);
+      if (entry.digest != 0) return entry.digest;
+   }
+   return builder_hash_file(path);
+}
+// Pack an object cache key into the two words the log keeps
+static void builder_pack_key(const char *key, uint64_t *words) {
+   char half[17] = {0};
+   for (int i = 0; i < 2; i++) {
+      memcpy(half, key + 16 * i, 16);
+      words[i] = strtoull(half, NULL, 16);
+   }
+}
+// Digest standing for the contents of an object known by its cache key (equal keys, equal objects)
+static uint64_t builder_key_digest(const uint64_t *words) {
+   uint64_t digest = words[0] ^ (words[1] * 0x9E3779B97F4A7C15ULL);
+   return digest ? digest : 1;
+}
+// Write out the lazy objects a link or archive about to run reads. One the cache no longer holds is compiled again
+// first: the action waits for it (pending). Returns 0 if an object cannot be written.
+static int builder_materialize_inputs(int id) {
+   graph_action_s *action = graph->actions[id];
+   for (char **input = action->inputs; *input; input++) {
+      int status = builder_materialize(*input);
+      if (status > 0) continue;
+      int compile = status < 0 ? ActionGraphs.find_file(graph, *input) : -1;
+      if (compile < 0 || graph->actions[compile]->kind != ACTION_COMPILE || !graph->actions[compile]->output ||
+          strcmp(graph->actions[compile]->output, *input) != 0) {
+         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to write %s out of the object cache\n", *input);
+         return SB_FALSE;
+      }
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "%s is no longer in the object cache; compiling it again\n", *input);
+      if (runs[compile].state == ACTION_DONE) {
+         runs[compile].is_lost = 1;
+         runs[compile].state = ACTION_READY;
+         ready[ready_tail++] = compile;
+      }
+      runs[id].pending++;
+   }
+   if (runs[id].pending == 0) return SB_TRUE;
+   // Readied again once its objects are written; the link is looked up again then
+   runs[id].state = ACTION_WAITING;
+   if (runs[id].cache_step == CACHE_LINK) cache_misses--;
+   runs[id].cache_step = CACHE_NONE;
+   return SB_TRUE;
+}
+// Write a lazy object out of the object cache with the mtime the log gave it, so it is the output logged; returns 1 if
+// the file is there (or is no lazy object), -1 if the cache no longer holds it, 0 if it cannot be written
+static int builder_materialize(const char *path) {
+   build_log_entry_s entry;
+   if (builder_mtime_ns(path) >= 0 || !BuildLog.lookup(path, &entry) || !(entry.cache_key[0] | entry.cache_key[1])) return 1;
+   char key[OBJECT_CACHE_KEY_SIZE], tmp[4200];
+   snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long)entry.cache_key[0], (unsigned long long)entry.cache_key[1]);
+   if (snprintf(tmp, sizeof(tmp), "%s" GRAPH_TMP_SUFFIX, path) >= (int)sizeof(tmp)) return 0;
+   if (!ObjectCache.fetch(key, tmp)) return -1;
+   struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, {.tv_sec = entry.mtime_ns / 1000000000LL, .tv_nsec = entry.mtime_ns % 1000000000LL}};
+   if (utimensat(AT_FDCWD, tmp, times, 0) != 0 || rename(tmp, path) != 0) {
+      unlink(tmp);
+      return 0;
+   }
+   FileStats.invalidate(path);
+   materialized_count++;
+   return 1;
+}
+// Jobs are logged under their output; op commands under the command itself
+static const char *builder_job_key(ExecJob job) {
+   return job->output ? job->output : job->command;
+}
+// Record a failed action and apply the failure policy
+static void builder_record_failure(ExecJob job) {
+   Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "%s %s (exit status %d)\n", job->label,
+                job->timed_out ? "timed out" : "failed", job->status);
+
+   build_failure_s *grown = realloc(failures, (failure_count + 1) * sizeof(build_failure_s));
+   if (grown) {
+      failures = grown;
+      failures[failure_count].label = strdup(job->label);
+      failures[failure_count].status = job->status;
+      failures[failure_count].timed_out = job->timed_out;
+   }
+   failure_count++;
+   if (max_failures > 0 && failure_count >= max_failures) is_stopping = 1;
+}
+// Report every failed action together
+static void builder_report_failures(void) {
+   if (Executor.interrupted()) {
+      Logger.fwriteln(stderr, "Build interrupted (%s); completed actions were recorded",
+                      strsignal(Executor.interrupted()));
+   }
+   if (failure_count == 0) return;
+
+   Logger.fwriteln(stderr, "Build failed: %d action(s) failed%s", failure_count,
+                   is_stopping && max_failures > 0 ? " (stopped at failure limit)" : "");
+   for (int i = 0; failures && i < failure_count; i++) {
+      Logger.fwriteln(stderr, "  %s: %s (exit status %d)", failures[i].timed_out ? "TIMEOUT" : "FAILED",
+                      failures[i].label, failures[i].status);
+   }
+   if (skipped_count > 0) Logger.fwriteln(stderr, "  %d action(s) skipped: a dependency failed", skipped_count);
+}
+// Clear the recorded failures
+static void builder_reset_failures(void) {
+   for (int i = 0; failures && i < failure_count; i++) free(failures[i].label);
+   free(failures);
+   failures = NULL;
+   failure_count = 0;
+   skipped_count = 0;
+   is_stopping = 0;
+}
+// Start watching through an inotify descriptor, which a live watch adds to the executor's wait loop
+static int builder_watch_open(int is_live) {
+   watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   watch.paths = StringMaps.create();
+   watch.dirs = StringMaps.create();
+   watch.is_live = is_live;
+   if (watch.fd < 0 || !watch.paths || !watch.dirs || (is_live && !Executor.watch(watch.fd))) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to watch for file changes: %s\n", strerror(errno));
+      builder_watch_close();
+      return SB_FALSE;
+   }
+   return SB_TRUE;
+}
+// Stop watching and release the watch state
+static void builder_watch_close(void) {
+   if (watch.is_live) Executor.watch(-1);
+   if (watch.fd >= 0) close(watch.fd);
+   for (int i = 0; i < watch.prefix_count; i++) {
+      for (int j = 0; j < watch.prefixes[i].count; j++) free(watch.prefixes[i].paths[j]);
+      free(watch.prefixes[i].paths);
+   }
+   free(watch.prefixes);
+   StringMaps.dispose(watch.paths);
+   StringMaps.dispose(watch.dirs);
+   StringMaps.dispose(watch.changed);
+   memset(&watch, 0, sizeof(watch));
+   watch.fd = -1;
+}
+// Watch a file through its directory (editors replace files rather than write them in place); returns 0 on failure
+static int builder_watch_path(const char *path, char *marker) {
+   if (!path || StringMaps.get(watch.paths, path)) return SB_TRUE;
+   if (!StringMaps.put(watch.paths, path, marker)) return SB_FALSE;
+
+   // Events name the file inside the directory: prefix it the way the watched path spells the directory
+   const char *slash = strrchr(path, '/');
+   char prefix[4096], dir[4096];
+   size_t len = slash ? (size_t)(slash - path + 1) : 0;
+   if (len >= sizeof(prefix)) return SB_FALSE;
+   memcpy(prefix, path, len);
+   prefix[len] = '\0';
+   if (StringMaps.get(watch.dirs, prefix)) return SB_TRUE;
+   StringMaps.put(watch.dirs, prefix, &watch); // Tried once, whatever the outcome
+   if (len == 0) strcpy(dir, ".");
+   else snprintf(dir, sizeof(dir), "%.*s", len > 1 ? (int)len - 1 : 1, prefix); // "/" stays the root
+   int wd = inotify_add_watch(watch.fd, dir, BUILDER_WATCH_EVENTS);
+   if (wd < 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Cannot watch %s: %s\n", dir, strerror(errno));
+      return SB_FALSE;
+   }
+
+   // Two spellings of one directory share its watch descriptor
+   if (wd >= watch.prefix_count) {
+      int count = wd + 16;
+      dep_list_s *grown = realloc(watch.prefixes, count * sizeof(dep_list_s));
+      if (!grown) return SB_FALSE;
+      memset(grown + watch.prefix_count, 0, (count - watch.prefix_count) * sizeof(dep_list_s));
+      watch.prefixes = grown;
+      watch.prefix_count = count;
+   }
+   dep_list_s *prefixes = &watch.prefixes[wd];
+   char *copy = strdup(prefix);
+   char **grown = copy ? realloc(prefixes->paths, (prefixes->count + 1) * sizeof(char *)) : NULL;
+   if (!grown) {
+      free(copy);
+      return SB_FALSE;
+   }
+   prefixes->paths = grown;
+   prefixes->paths[prefixes->count++] = copy;
+   return SB_TRUE;
+}
+// Depfile visitor: watch a header
+static int builder_watch_dep(const char *path, object data) {
+   builder_watch_path(path, WATCH_INPUT);
+   return SB_TRUE;
+}
+// Read the pending events: forget the metadata of changed watched files and collect them in watch.changed
+static void builder_watch_drain(void) {
+   StringMaps.dispose(watch.changed);
+   watch.changed = StringMaps.create();
+
+   char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+   ssize_t len;
+   while ((len = read(watch.fd, buffer, sizeof(buffer))) > 0) {
+      const struct inotify_event *event;
+      for (char *p = buffer; p < buffer + len; p += sizeof(struct inotify_event) + event->len) {
+         event = (const struct inotify_event *)p;
+         if (event->mask & IN_Q_OVERFLOW) {
+            // Events were lost: any file may have changed
+            Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Change events overflowed; rescanning\n");
+            FileStats.reset();
+            watch.change_count++;
+            continue;
+         }
+         if (!event->len || event->wd < 0 || event->wd >= watch.prefix_count) continue;
+
+         dep_list_s *prefixes = &watch.prefixes[event->wd];
+         for (int i = 0; i < prefixes->count; i++) {
+            char path[4096];
+            if (snprintf(path, sizeof(path), "%s%s", prefixes->paths[i], event->name) >= (int)sizeof(path)) continue;
+            char *marker = StringMaps.get(watch.paths, path);
+            if (!marker) continue; // Unrelated files
+            FileStats.invalidate(path);
+            if (marker == WATCH_OUTPUT) continue; // Written by the build (or removed by hand): only re-stat'ed
+            if (watch.changed) StringMaps.put(watch.changed, path, &watch);
+            if (build_context && build_context->config_file && strcmp(path, build_context->config_file) == 0) {
+               watch.is_reload = 1;
+            }
+            watch.change_count++;
+            Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "%s changed\n", path);
+         }
+      }
+   }
+}
+// Debounce: keep reading events until none arrive for the quiet period (an editor save or checkout is a burst)
+static void builder_watch_settle(void) {
+   struct pollfd pfd = {.fd = watch.fd, .events = POLLIN};
+   while (!Executor.interrupted() && poll(&pfd, 1, BUILDER_WATCH_DEBOUNCE_MS) > 0) builder_watch_drain();
+}
+// Cancel running compiles reading a file that just changed: their output is stale before it exists
+static void builder_watch_cancel(void) {
+   for (int i = 0; watch.changed && i < graph->action_count; i++) {
+      // Archives updated in place are never cancelled (and read only objects anyway)
+      if (runs[i].state != ACTION_RUNNING || runs[i].is_superseded || runs[i].member_argv) continue;
+      int is_changed = 0;
+      for (char **input = graph->actions[i]->inputs; !is_changed && input && *input; input++) {
+         is_changed = StringMaps.get(watch.changed, *input) != NULL;
+      }
+      for (char **dep = action_deps[i]; !is_changed && dep && *dep; dep++) is_changed = StringMaps.get(watch.changed, *dep) != NULL;
+      if (!is_changed) continue;
+
+      runs[i].is_superseded = 1;
+      Executor.cancel(&runs[i].job);
+   }
+}
+// Release builder resources
+void builder_cleanup(void) {
+   builder_resident(SB_FALSE);
+   Executor.shutdown();
+   BuildLog.close();
+   Toolchains.cleanup();
+   FileStats.reset();
+   IncludeScanner.reset();
+   ObjectCache.close();
+   is_cache = 0;
+   builder_reset_failures();
+   build_context = NULL;
 }
 
 const IBuilder Builder = {
     .get_version = get_builder_version,
-    .build = builder_build_target,
+    .init = builder_init,
+    .build = builder_build_targets,
+    .build_file = builder_build_file,
+    .watch = builder_watch,
+    .resident = builder_resident,
+    .refresh = builder_refresh,
+    .report_headers = builder_report_headers,
+    .cleanup = builder_cleanup,
 };
\ No newline at end of file
@@ -17,25 +17,40 @@
 
 #include "sbuild.h"
 
+#define BUILDER_WATCH_RELOAD 2 // Returned by watch when the config file changed (reload it and watch again)
+
 typedef struct build_target_s {
-   string name;      // Name of the build target
-   string type;      // Type of the build target (e.g., executable, library)
-   string *sources;  // Array of source files for the build targets
-   string build_dir; // Directory where the build output will be placed
-   string out_dir;   // Directory where the final output will be placed (optional - if NULL, will use build_dir)
-   string compiler;  // Compiler to use for building the target
-   string *c_flags;  // Array of compiler flags for the target
-   string *ld_flags; // Array of linker flags for the target
-   string *commands; // Array of custom commands to run
-   string output;    // Output file name for the target (optional)
+   string name;            // Name of the build target
+   string type;            // Type of the build target (e.g., executable, library)
+   string *sources;        // Array of source files for the build targets
+   string build_dir;       // Directory where the build output will be placed
+   string out_dir;         // Directory where the final output will be placed (optional - if NULL, will use build_dir)
+   string compiler;        // Compiler to use for building the target
+   string *c_flags;        // Array of compiler flags for the target
+   string *ld_flags;       // Array of linker flags for the target
+   string *commands;       // Array of custom commands to run
+   string output;          // Output file name for the target (optional)
+   string *dependencies;   // Names of targets that must be built first (optional)
+   string kind;            // Library kind: "static" or "shared" (lib targets only)
+   string archiver;        // Archiver for static libraries (optional - defaults to ar)
+   int is_thin;            // Set when a static library is a thin archive (members referenced by path)
+   int unity_batch_size;   // Sources compiled together per unity file (0 = unity build off)
+   string *unity_exclude;  // Sources compiled on their own in a unity build (optional)
+   string pch;             // Header precompiled once and force-included by every compile (optional)
+   string variant;         // Variant the target was specialized for (NULL without variants)
+   long timeout_ms;        // Wall-clock limit for building the whole target (0 = none)
+   long action_timeout_ms; // Wall-clock limit for each action of the target (0 = config default)
 } build_target_s;
 
 typedef struct build_config_s {
-   string name;           // Name of the build configuration
-   string log_file;       // Log file for the build configuration
-   BuildTarget *targets;  // Array of build targets for the configuration
-   string *variables;     // Array of key-value pairs for configuration variables
-   string default_target; // Default target to build if none is specified
+   string name;            // Name of the build configuration
+   string log_file;        // Log file for the build configuration
+   BuildTarget *targets;   // Array of build targets for the configuration
+   string *variables;      // Array of key-value pairs for configuration variables
+   string default_target;  // Default target to build if none is specified
+   string build_dir;       // Directory holding build state (optional - defaults to the working directory)
+   string *variants;       // Names of the configured variants (NULL without variants)
+   long action_timeout_ms; // Default wall-clock limit for each action (0 = none)
 } build_config_s;
 
 /**
@@ -52,11 +67,54 @@ typedef struct IBuilder {
     */
    const char *(*get_version)(void); // Function to get the version of the builder
    /**
-    * @brief Builds the application for the specified target.
-    * @param target :the build target to build the application for
+    * @brief Initializes the builder for the current build context.
+    * @param context :the build context (job count, log settings)
+    * @return :0 on success, non-zero on failure
+    */
+   int (*init)(BuildContext);
+   /**
+    * @brief Builds the specified targets and their dependencies in one job pool.
+    * @param targets :NULL-terminated array of the requested build targets
+    * @return :0 on success, non-zero on failure
+    */
+   int (*build)(BuildTarget *);
+   /**
+    * @brief Builds one source or output file: only the actions it needs are run.
+    * @param targets :NULL-terminated array of the targets searched for the file
+    * @param path :the source file (its compile) or the output path to build
+    * @return :0 on success, non-zero on failure
+    */
+   int (*build_file)(BuildTarget *, const char *);
+   /**
+    * @brief Builds, then keeps the graph and file metadata in memory and rebuilds on every change
+    *        to a watched input, header or the config file, until interrupted.
+    * @param targets :NULL-terminated array of the requested build targets
+    * @param path :the only file to build on each change (NULL = whole targets)
+    * @return :0 when interrupted, BUILDER_WATCH_RELOAD if the config file changed, non-zero on failure to watch
+    */
+   int (*watch)(BuildTarget *, const char *);
+   /**
+    * @brief Keeps the lowered graph and file metadata between builds (a build server), following
+    *        file changes through inotify, or releases them.
+    * @param is_kept :1 to keep the state from now on; 0 to release it
+    * @return :0 on success, non-zero if file changes cannot be followed
+    */
+   int (*resident)(int);
+   /**
+    * @brief Applies the file changes seen since the last build to the resident state.
+    * @return :BUILDER_WATCH_RELOAD if the config file changed (release the state and reload it); otherwise, 0
+    */
+   int (*refresh)(void);
+   /**
+    * @brief Suggests precompiled header candidates from the depfiles of previous builds.
+    * @param targets :NULL-terminated array of the targets to analyze
     * @return :0 on success, non-zero on failure
     */
-   int (*build)(BuildTarget);
+   int (*report_headers)(BuildTarget *);
+   /**
+    * @brief Releases resources held by the builder (terminates running jobs).
+    */
+   void (*cleanup)(void);
 } IBuilder;
 
 extern const IBuilder Builder; // Global Builder instance
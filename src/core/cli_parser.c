@@ -8,14 +8,43 @@
  */
 
 #include "cli_parser.h"
+#include "remote_cache.h"
 #include <string.h>
 
-#define CLI_PARSER_VERSION "0.00.02.001"
+#define CLI_PARSER_VERSION "0.00.02.004"
 
 // Function to get the version of the CLI parser
 const char *cli_parser_get_version(void) {
    return CLI_PARSER_VERSION; // Return the version of the CLI parser
 }
+// Parse the count of a short option given as `-xN` or `-x N`
+static int cli_parse_count(int argc, char **argv, int *i, const char *opt, long *count) {
+   const char *value = argv[*i] + strlen(opt);
+   if (*value == '\0') value = *i + 1 < argc ? argv[++(*i)] : "";
+
+   char *end = NULL;
+   *count = strtol(value, &end, 10);
+   return *value != '\0' && *end == '\0';
+}
+// Append comma-separated names (targets or variants) to a name list; returns 0 if allocation fails
+static int cli_add_names(char ***names, const char *list) {
+   int count = 0;
+   for (char **name = *names; name && *name; name++) count++;
+
+   for (const char *start = list; *start;) {
+      size_t len = strcspn(start, ",");
+      if (len > 0) {
+         char **grown = realloc(*names, (count + 2) * sizeof(char *));
+         if (!grown) return SB_FALSE;
+         *names = grown;
+         if (!(grown[count] = strndup(start, len))) return SB_FALSE;
+         grown[++count] = NULL;
+      }
+      start += len + (start[len] == ',');
+   }
+
+   return SB_TRUE;
+}
 // Function to parse command line arguments
 void cli_parse_args(int argc, char **argv, CLIOptions *options, CLIErrorCode *error) {
    *error = CLI_SUCCESS; // Initialize error code to success
@@ -67,13 +96,106 @@ void cli_parse_args(int argc, char **argv, CLIOptions *options, CLIErrorCode *er
          }
 
          (*options)->debug_level = (DebugLevel)level; // Set the debug level
+      } else if (strncmp(argv[i], OPT_MAX_JOBS, strlen(OPT_MAX_JOBS)) == 0) {
+         // Set the number of parallel jobs: `-j N` or `-jN`
+         long jobs;
+         if (!cli_parse_count(argc, argv, &i, OPT_MAX_JOBS, &jobs) || jobs < 1 || jobs > 1024) {
+            (*options)->log_stream = stderr;    // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_INVALID_ARG; // Invalid job count
+            return;
+         }
+
+         (*options)->max_jobs = (int)jobs; // Set the number of parallel jobs
+      } else if (strncmp(argv[i], OPT_KEEP_GOING, strlen(OPT_KEEP_GOING)) == 0) {
+         // Keep going until N actions fail: `-k N` or `-kN` (0 = never stop)
+         long failures;
+         if (!cli_parse_count(argc, argv, &i, OPT_KEEP_GOING, &failures) || failures < 0) {
+            (*options)->log_stream = stderr;    // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_INVALID_ARG; // Invalid failure count
+            return;
+         }
+
+         (*options)->max_failures = (int)failures; // Set the failure policy
+      } else if (strncmp(argv[i], OPT_WATCHDOG, strlen(OPT_WATCHDOG)) == 0) {
+         // Set the watchdog factor: report actions exceeding N times their usual duration
+         char *end = NULL;
+         const char *value = argv[i] + strlen(OPT_WATCHDOG);
+         long factor = strtol(value, &end, 10);
+         if (*value == '\0' || *end != '\0' || factor < 0) {
+            (*options)->log_stream = stderr;    // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_INVALID_ARG; // Invalid watchdog factor
+            return;
+         }
+
+         (*options)->watchdog = (int)factor; // Set the watchdog factor
+      } else if (strcmp(argv[i], OPT_FAIL_FAST) == 0) {
+         // Stop at the first failure, terminating running jobs
+         (*options)->max_failures = 1;
+      } else if (strcmp(argv[i], OPT_BUILD_FILE) == 0) {
+         // Build only the actions one source or output file needs
+         if (i + 1 >= argc || !((*options)->file_path = strdup(argv[++i]))) {
+            (*options)->log_stream = stderr;       // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_MISSING_OPTION; // Missing file path
+            return;
+         }
+      } else if (strcmp(argv[i], OPT_VARIANT) == 0) {
+         // Build only the named variants (default: all of them)
+         if (i + 1 >= argc || !cli_add_names(&(*options)->variant_names, argv[++i])) {
+            (*options)->log_stream = stderr;       // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_MISSING_OPTION; // Missing variant names
+            return;
+         }
+      } else if (strcmp(argv[i], OPT_PCH_REPORT) == 0) {
+         // Analyze recorded depfiles instead of building
+         (*options)->is_pch_report = 1;
+      } else if (strcmp(argv[i], OPT_WATCH) == 0) {
+         // Stay up and rebuild on changes
+         (*options)->is_watch = 1;
+      } else if (strcmp(argv[i], OPT_DAEMON) == 0) {
+         // Serve builds from memory
+         (*options)->is_daemon = 1;
+      } else if (strcmp(argv[i], OPT_GIT_INDEX) == 0) {
+         // Take unchanged tracked inputs from the git index
+         (*options)->is_git_index = 1;
+      } else if (strcmp(argv[i], OPT_CACHE) == 0 || strncmp(argv[i], OPT_CACHE "=", strlen(OPT_CACHE "=")) == 0) {
+         // Look compiles up in the object cache (default location, or the given directory)
+         const char *dir = argv[i][strlen(OPT_CACHE)] ? argv[i] + strlen(OPT_CACHE "=") : "";
+         free((*options)->cache_dir);
+         if (!((*options)->cache_dir = strdup(dir))) {
+            (*options)->log_stream = stderr; // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_FAILED;   // Memory allocation failed
+            return;
+         }
+      } else if (strncmp(argv[i], OPT_REMOTE_CACHE, strlen(OPT_REMOTE_CACHE)) == 0) {
+         // Share cached objects through an HTTP cache
+         free((*options)->remote_cache);
+         if (!((*options)->remote_cache = strdup(argv[i] + strlen(OPT_REMOTE_CACHE)))) {
+            (*options)->log_stream = stderr; // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_FAILED;   // Memory allocation failed
+            return;
+         }
+      } else if (strcmp(argv[i], OPT_LAZY_OBJECTS) == 0) {
+         // Leave cached objects in the cache
+         (*options)->is_lazy_objects = 1;
+      } else if (strcmp(argv[i], OPT_CACHE_SERVER) == 0 || strncmp(argv[i], OPT_CACHE_SERVER "=", strlen(OPT_CACHE_SERVER "=")) == 0) {
+         // Serve the cache directory over HTTP (default port, or the given one)
+         char *end = NULL;
+         const char *value = argv[i][strlen(OPT_CACHE_SERVER)] ? argv[i] + strlen(OPT_CACHE_SERVER "=") : "";
+         long port = *value ? strtol(value, &end, 10) : REMOTE_CACHE_PORT;
+         if ((*value && *end != '\0') || port < 1 || port > 65535) {
+            (*options)->log_stream = stderr;    // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_INVALID_ARG; // Invalid port
+            return;
+         }
+
+         (*options)->cache_port = (int)port; // Serve instead of building
       } else if (strcmp(argv[i], OPT_LOG_VERBOSE) == 0) {
          // Set the log level to verbose
          (*options)->is_verbose = 1; // Set log level to verbose
       } else if (strncmp(argv[i], OPT_BUILD_CONFIG, strlen(OPT_BUILD_CONFIG)) == 0) {
          // Set the configuration file path
          if (i + 1 < argc) {
-            char *arg = strdup(argv[i + 1]); // Get the next argument: `config.json[:target]`
+            char *arg = strdup(argv[i + 1]); // Get the next argument: `config.json[:target,...]`
             if (!arg) {
                (*options)->log_stream = stderr; // Set log stream to stderr for error messages
                *error = CLI_ERR_PARSE_FAILED;   // Memory allocation failed
@@ -81,11 +203,9 @@ void cli_parse_args(int argc, char **argv, CLIOptions *options, CLIErrorCode *er
             }
             char *colon = strchr(arg, ':'); // Check for a colon in the argument
             char *config_file = arg;
-            char *target_name = NULL;
             if (colon) {
-               *colon = '\0'; // Split the string at the colon
-               target_name = strdup(colon + 1);
-               if (!target_name) {
+               *colon = '\0'; // Split the string at the colon: `config.json:a,b,c`
+               if (!cli_add_names(&(*options)->target_names, colon + 1)) {
                   free(arg);
                   (*options)->log_stream = stderr;
                   *error = CLI_ERR_PARSE_FAILED;
@@ -96,14 +216,12 @@ void cli_parse_args(int argc, char **argv, CLIOptions *options, CLIErrorCode *er
             FILE *file = NULL;
             if (!(file = fopen(config_file, "r"))) {
                free(config_file);
-               free(target_name);
                (*options)->log_stream = stderr;
                *error = CLI_ERR_PARSE_INVALID_CONFIG;
                return;
             }
 
             (*options)->config_file = config_file; // Set the configuration file path
-            (*options)->target_name = target_name; // Set the target name if provided
             fclose(file);                          // Close the file after checking
             ++i;                                   // Move to the next argument
          } else {
@@ -111,6 +229,13 @@ void cli_parse_args(int argc, char **argv, CLIOptions *options, CLIErrorCode *er
             *error = CLI_ERR_PARSE_MISSING_CONFIG; // Missing value for config file option
             return;
          }
+      } else if (argv[i][0] != '-') {
+         // Positional arguments name further targets to build
+         if (!cli_add_names(&(*options)->target_names, argv[i])) {
+            (*options)->log_stream = stderr; // Set log stream to stderr for error messages
+            *error = CLI_ERR_PARSE_FAILED;   // Memory allocation failed
+            return;
+         }
       } else {
          (*options)->log_stream = stderr;       // Set log stream to stderr for error messages
          *error = CLI_ERR_PARSE_UNKNOWN_OPTION; // Unknown option provided
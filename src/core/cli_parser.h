@@ -16,12 +16,26 @@
 
 #include "sbuild.h"
 
-#define OPT_SHOW_HELP "--help"     // Option to show help
-#define OPT_SHOW_ABOUT "--about"   // Option to show version information
-#define OPT_BUILD_CONFIG "--build" // Option to specify a build configuration file
-#define OPT_LOG_LEVEL "--log="     // Option to set the log level (0-2)
-#define OPT_DBG_LEVEL "--dbug="    // Option to set the debug level (0-4)
-#define OPT_LOG_VERBOSE "-v"       // Option for verbose logging (only observed with --about && --help)
+#define OPT_SHOW_HELP "--help"      // Option to show help
+#define OPT_SHOW_ABOUT "--about"    // Option to show version information
+#define OPT_BUILD_CONFIG "--build"  // Option to specify a build configuration file
+#define OPT_LOG_LEVEL "--log="      // Option to set the log level (0-2)
+#define OPT_DBG_LEVEL "--dbug="     // Option to set the debug level (0-4)
+#define OPT_LOG_VERBOSE "-v"        // Option for verbose logging (only observed with --about && --help)
+#define OPT_MAX_JOBS "-j"           // Option to set the number of parallel jobs (`-j N` or `-jN`)
+#define OPT_KEEP_GOING "-k"         // Option to keep going until N actions fail (`-k 0`: never stop)
+#define OPT_WATCHDOG "--watchdog="  // Option to set the watchdog factor (0 = off)
+#define OPT_FAIL_FAST "--fail-fast" // Option to stop and terminate running jobs on the first failure (default)
+#define OPT_BUILD_FILE "--file"     // Option to build only one source or output file
+#define OPT_PCH_REPORT "--pch-report" // Option to suggest precompiled headers instead of building
+#define OPT_VARIANT "--variant"       // Option to build only some of the configured variants
+#define OPT_WATCH "--watch"           // Option to rebuild whenever an input, header or the config file changes
+#define OPT_DAEMON "--daemon"         // Option to run the build server for the working directory
+#define OPT_GIT_INDEX "--git-index"   // Option to skip stat'ing tracked inputs the git index shows unchanged
+#define OPT_CACHE "--cache"           // Option to reuse objects by preprocessed content (`--cache=<dir>`: cache location)
+#define OPT_REMOTE_CACHE "--remote-cache=" // Option to share cached objects through an HTTP cache (`--remote-cache=<url>`)
+#define OPT_CACHE_SERVER "--cache-server"  // Option to serve a cache directory over HTTP instead of building (`=<port>`)
+#define OPT_LAZY_OBJECTS "--lazy-objects"  // Option to write cached objects only when an action that runs reads them
 
 /**
  * @brief CLIOptions structure.
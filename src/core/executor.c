@@ -0,0 +1,598 @@
+/* src/core/executor.c
+ * Sigma.Build Job Executor
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * Event-driven executor: children are spawned with their stdout/stderr redirected into
+ * non-blocking pipes, and a single epoll instance waits on those pipes plus a pidfd for
+ * each child. Output is buffered in memory and spilled to a temp file past a threshold,
+ * then written out as one block when the job completes. The epoll timeout is derived from
+ * the nearest job deadline, so timeouts and the watchdog need no polling either. SIGINT and
+ * SIGTERM are blocked and read from a signalfd in the same loop, then forwarded to every
+ * job's process group so the build winds down with its bookkeeping intact. A caller may add
+ * one more descriptor (watch mode's inotify); when it is readable, waiting returns early.
+ */
+#define _GNU_SOURCE
+#include "executor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define EXECUTOR_VERSION "0.00.02.004"
+
+#define EXEC_READ_CHUNK 4096
+#define EXEC_MAX_EVENTS 32
+
+// epoll tags packed with the slot index into epoll_data.u64
+#define TAG_PIDFD 1
+#define TAG_STDOUT 2
+#define TAG_STDERR 3
+#define TAG_SIGNAL 4
+#define TAG_WATCH 5
+
+extern char **environ;
+
+typedef struct capture_s {
+   int fd;      // Read end of the pipe (-1 once closed)
+   char *data;  // In-memory buffer
+   size_t len;  // Bytes held in the buffer
+   size_t cap;  // Buffer capacity
+   FILE *spill; // Temp file used once the threshold is exceeded
+} capture_s;
+
+typedef struct exec_slot_s {
+   ExecJob job;   // Job occupying the slot (NULL if free)
+   pid_t pid;     // Child process id
+   int pidfd;     // pidfd for the child (-1 when using the SIGCHLD signalfd)
+   int exited;    // Set once the child has been reaped
+   int cancelled; // Set when the job was terminated by the executor
+   int warned;    // Set once the watchdog reported the job
+   long start_ms; // Monotonic start time
+   long kill_ms;  // Monotonic time the job was killed (0 = not killed)
+   capture_s out; // Captured stdout
+   capture_s err; // Captured stderr
+} exec_slot_s;
+
+static exec_slot_s *slots = NULL;
+static int slot_count = 0;
+static int running_count = 0;
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static int use_pidfd = 0;
+static int watchdog_factor = 0;
+static int interrupted = 0;     // Interrupt signal received (0 = none)
+static int watch_fd = -1;       // Caller descriptor that ends a wait when readable (-1 = none)
+static pid_t *abandoned = NULL; // Killed children that did not exit within the grace period
+static int abandoned_count = 0;
+static sigset_t saved_mask;
+
+// Forward declarations
+static void exec_shutdown(void);
+static void exec_terminate(int);
+static void exec_reap(exec_slot_s *);
+static void exec_release(exec_slot_s *);
+static int exec_use_sigchld(void);
+static void capture_close(capture_s *);
+
+static const char *exec_get_version(void) {
+   return EXECUTOR_VERSION;
+}
+
+static int exec_pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+   return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+static uint64_t exec_tag(int slot, int tag) {
+   return ((uint64_t)slot << 8) | (uint64_t)tag;
+}
+
+/* Initialize executor slots and the epoll instance */
+static int exec_init(int max_jobs, int watchdog) {
+   if (slots) exec_shutdown();
+   watchdog_factor = watchdog;
+
+   if (max_jobs <= 0) {
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      max_jobs = cpus > 0 ? (int)cpus : 1;
+   }
+   addr slots_addr;
+   if (!Resources.alloc(&slots_addr, max_jobs * sizeof(exec_slot_s))) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to allocate executor slots.\n");
+      return SB_FALSE;
+   }
+   slots = (exec_slot_s *)slots_addr;
+   slot_count = max_jobs;
+   running_count = 0;
+
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (epoll_fd < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to create epoll instance: %s\n", strerror(errno));
+      exec_shutdown();
+      return SB_FALSE;
+   }
+
+   // Prefer pidfd; fall back to a SIGCHLD signalfd on older kernels
+   int probe = exec_pidfd_open(getpid());
+   use_pidfd = probe >= 0;
+   if (probe >= 0) close(probe);
+
+   // SIGINT/SIGTERM are received through the signalfd and forwarded to each job's process group
+   sigset_t mask;
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGTERM);
+   if (!use_pidfd) sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &mask, &saved_mask);
+   signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+   struct epoll_event ev = {.events = EPOLLIN, .data.u64 = exec_tag(0, TAG_SIGNAL)};
+   if (signal_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to watch signals: %s\n", strerror(errno));
+      exec_shutdown();
+      return SB_FALSE;
+   }
+   interrupted = 0;
+
+   Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Executor ready: %d job slot(s), %s\n",
+                slot_count, use_pidfd ? "pidfd" : "signalfd");
+   return SB_TRUE;
+}
+
+static int exec_has_slot(void) {
+   return slots && running_count < slot_count;
+}
+
+static int exec_running(void) {
+   return running_count;
+}
+
+/* Append captured bytes, spilling to a temp file past the threshold */
+static void capture_append(capture_s *cap, const char *buf, size_t n) {
+   if (!cap->spill && cap->len + n > EXEC_SPILL_THRESHOLD) {
+      cap->spill = tmpfile();
+      if (cap->spill && cap->len) fwrite(cap->data, 1, cap->len, cap->spill);
+      if (cap->spill) cap->len = 0;
+   }
+   if (cap->spill) {
+      fwrite(buf, 1, n, cap->spill);
+      return;
+   }
+   if (cap->len + n > cap->cap) {
+      size_t new_cap = cap->cap ? cap->cap * 2 : EXEC_READ_CHUNK;
+      while (new_cap < cap->len + n) new_cap *= 2;
+      char *data = realloc(cap->data, new_cap);
+      if (!data) return; // Drop output rather than fail the job
+      cap->data = data;
+      cap->cap = new_cap;
+   }
+   memcpy(cap->data + cap->len, buf, n);
+   cap->len += n;
+}
+/* Read everything currently available on a capture pipe */
+static void capture_drain(capture_s *cap) {
+   char buf[EXEC_READ_CHUNK];
+   while (cap->fd >= 0) {
+      ssize_t n = read(cap->fd, buf, sizeof(buf));
+      if (n > 0) {
+         capture_append(cap, buf, (size_t)n);
+      } else if (n == 0) {
+         capture_close(cap);
+      } else if (errno == EINTR) {
+         continue;
+      } else {
+         if (errno != EAGAIN) capture_close(cap);
+         break;
+      }
+   }
+}
+static void capture_close(capture_s *cap) {
+   if (cap->fd < 0) return;
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cap->fd, NULL);
+   close(cap->fd);
+   cap->fd = -1;
+}
+static void write_all(int fd, const char *buf, size_t len) {
+   while (len > 0) {
+      ssize_t n = write(fd, buf, len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return;
+      buf += n;
+      len -= (size_t)n;
+   }
+}
+/* Write the captured block to the given descriptor (-1 discards it) and release it */
+static void capture_flush(capture_s *cap, int fd) {
+   if (cap->spill && fd < 0) {
+      fclose(cap->spill);
+      cap->spill = NULL;
+   } else if (cap->spill) {
+      char buf[EXEC_READ_CHUNK];
+      size_t n;
+      rewind(cap->spill);
+      while ((n = fread(buf, 1, sizeof(buf), cap->spill)) > 0) write_all(fd, buf, n);
+      fclose(cap->spill);
+      cap->spill = NULL;
+   } else if (cap->len && fd >= 0) {
+      write_all(fd, cap->data, cap->len);
+   }
+   free(cap->data);
+   cap->data = NULL;
+   cap->len = cap->cap = 0;
+}
+
+/* Start a job in a free slot */
+static int exec_start(ExecJob job) {
+   if (!job || !exec_has_slot()) return SB_FALSE;
+
+   int slot = 0;
+   while (slots[slot].job) slot++;
+   exec_slot_s *s = &slots[slot];
+
+   int out_pipe[2] = {-1, -1}, err_pipe[2] = {-1, -1};
+   if (pipe2(out_pipe, O_CLOEXEC) < 0 || pipe2(err_pipe, O_CLOEXEC) < 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to create pipes for %s: %s\n", job->label, strerror(errno));
+      goto spawnFail;
+   }
+   fcntl(out_pipe[0], F_SETFL, O_NONBLOCK);
+   fcntl(err_pipe[0], F_SETFL, O_NONBLOCK);
+
+   posix_spawn_file_actions_t actions;
+   posix_spawnattr_t attr;
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+   posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+   posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+   posix_spawnattr_init(&attr);
+   sigset_t empty, defaults;
+   sigemptyset(&empty);
+   sigemptyset(&defaults);
+   sigaddset(&defaults, SIGCHLD);
+   sigaddset(&defaults, SIGPIPE);
+   posix_spawnattr_setsigmask(&attr, &empty);
+   posix_spawnattr_setsigdefault(&attr, &defaults);
+   posix_spawnattr_setpgroup(&attr, 0); // Own process group: timeouts and cancels reach the whole tree
+   posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+   char *shell_argv[] = {"/bin/sh", "-c", job->command, NULL};
+   char **argv = job->argv ? job->argv : shell_argv;
+   pid_t pid;
+   int rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+   posix_spawn_file_actions_destroy(&actions);
+   posix_spawnattr_destroy(&attr);
+   close(out_pipe[1]);
+   close(err_pipe[1]);
+   out_pipe[1] = err_pipe[1] = -1;
+   if (rc != 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to start %s: %s\n", argv[0], strerror(rc));
+      goto spawnFail;
+   }
+
+   memset(s, 0, sizeof(*s));
+   s->job = job;
+   s->pid = pid;
+   s->pidfd = use_pidfd ? exec_pidfd_open(pid) : -1;
+   int is_switched = use_pidfd && s->pidfd < 0;
+   if (is_switched) {
+      // No pidfd for this child (out of descriptors): its exit must still wake the wait, so SIGCHLD does from now on
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "pidfd_open failed for %s (%s); switching to SIGCHLD\n", job->label, strerror(errno));
+      if (!exec_use_sigchld()) {
+         kill(-pid, SIGKILL);
+         while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+         s->job = NULL;
+         goto spawnFail;
+      }
+   }
+   s->out.fd = out_pipe[0];
+   s->err.fd = err_pipe[0];
+   s->start_ms = get_monotonic_ms();
+   running_count++;
+
+   struct epoll_event ev = {.events = EPOLLIN};
+   ev.data.u64 = exec_tag(slot, TAG_STDOUT);
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->out.fd, &ev);
+   ev.data.u64 = exec_tag(slot, TAG_STDERR);
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->err.fd, &ev);
+   if (s->pidfd >= 0) {
+      ev.data.u64 = exec_tag(slot, TAG_PIDFD);
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->pidfd, &ev);
+   }
+   job->status = -1;
+   job->timed_out = 0;
+   job->duration_ms = 0;
+   // It may have exited before SIGCHLD was blocked (that signal is gone): reaped here, completed by the next wait
+   if (is_switched) exec_reap(s);
+
+   return SB_TRUE;
+
+spawnFail:
+   for (int i = 0; i < 2; i++) {
+      if (out_pipe[i] >= 0) close(out_pipe[i]);
+      if (err_pipe[i] >= 0) close(err_pipe[i]);
+   }
+   job->status = EXEC_STATUS_SPAWN_FAILED;
+   return SB_FALSE;
+}
+
+/* Switch from pidfds to the SIGCHLD signalfd for the rest of the run; returns 0 if signals cannot be watched */
+static int exec_use_sigchld(void) {
+   sigset_t mask;
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGTERM);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &mask, NULL);
+   if (signalfd(signal_fd, &mask, SFD_NONBLOCK | SFD_CLOEXEC) < 0) return SB_FALSE;
+   use_pidfd = 0; // Children holding a pidfd keep it; SIGCHLD reaps them as well
+   return SB_TRUE;
+}
+/* Collect the exit status of a child known (or suspected) to have exited */
+static void exec_reap(exec_slot_s *s) {
+   int status;
+   pid_t rc;
+   do {
+      rc = waitpid(s->pid, &status, WNOHANG);
+   } while (rc < 0 && errno == EINTR);
+   if (rc != s->pid) return; // Still running
+
+   s->exited = 1;
+   s->job->duration_ms = get_monotonic_ms() - s->start_ms;
+   if (s->job->timed_out)
+      s->job->status = EXEC_STATUS_TIMED_OUT;
+   else if (WIFEXITED(status))
+      s->job->status = WEXITSTATUS(status);
+   else if (WIFSIGNALED(status))
+      s->job->status = 128 + WTERMSIG(status);
+   else
+      s->job->status = 1;
+
+   exec_release(s);
+}
+/* Drop the child's descriptors once it has exited or been abandoned */
+static void exec_release(exec_slot_s *s) {
+   if (s->pidfd >= 0) {
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s->pidfd, NULL);
+      close(s->pidfd);
+      s->pidfd = -1;
+   }
+   // Anything the child wrote is already in the pipes; don't wait on descendants holding them open
+   capture_drain(&s->out);
+   capture_drain(&s->err);
+   capture_close(&s->out);
+   capture_close(&s->err);
+}
+
+/* Print the output of a finished slot as one block and free the slot */
+static ExecJob exec_complete(exec_slot_s *s) {
+   ExecJob job = s->job;
+   fflush(stdout);
+   fflush(stderr);
+   // Output of cancelled jobs is only noise from the interruption
+   capture_flush(&s->out, s->cancelled ? -1 : STDOUT_FILENO);
+   capture_flush(&s->err, s->cancelled ? -1 : STDERR_FILENO);
+   s->job = NULL;
+   running_count--;
+
+   return job;
+}
+
+/* Kill a job's process group; the job completes when it exits or the grace period ends */
+static void exec_kill(exec_slot_s *s, int signal) {
+   kill(-s->pid, signal);
+   if (!s->kill_ms) s->kill_ms = get_monotonic_ms();
+}
+/* Apply timeouts, the kill grace period and the watchdog; returns ms until the next deadline (-1 = none) */
+static int exec_check_timers(void) {
+   long now = get_monotonic_ms();
+   long next = -1;
+
+   for (int i = 0; i < slot_count; i++) {
+      exec_slot_s *s = &slots[i];
+      if (!s->job || s->exited) continue;
+      ExecJob job = s->job;
+      long elapsed = now - s->start_ms;
+      long due = -1;
+
+      if (s->kill_ms) {
+         // A wedged child (e.g. stuck on NFS) must not hold its slot: give up on it
+         if (now - s->kill_ms >= EXEC_KILL_GRACE_MS) {
+            Logger.fwriteln(stderr, "[executor] %s did not exit after being killed; abandoning it", job->label);
+            kill(-s->pid, SIGKILL);
+            pid_t *grown = realloc(abandoned, (abandoned_count + 1) * sizeof(pid_t));
+            if (grown) {
+               abandoned = grown;
+               abandoned[abandoned_count++] = s->pid;
+            }
+            s->exited = 1;
+            job->duration_ms = elapsed;
+            job->status = job->timed_out ? EXEC_STATUS_TIMED_OUT : 128 + SIGKILL;
+            exec_release(s);
+            continue;
+         }
+         due = EXEC_KILL_GRACE_MS - (now - s->kill_ms);
+      } else if (job->timeout_ms > 0 && elapsed >= job->timeout_ms) {
+         Logger.fwriteln(stderr, "[executor] %s timed out after %.1fs; killing its process group",
+                         job->label, elapsed / 1000.0);
+         job->timed_out = 1;
+         exec_kill(s, SIGKILL);
+         due = EXEC_KILL_GRACE_MS;
+      } else if (job->timeout_ms > 0) {
+         due = job->timeout_ms - elapsed;
+      }
+
+      // Watchdog: report jobs running far longer than their history says they should
+      long limit = job->expected_ms * watchdog_factor;
+      if (!s->warned && limit >= EXEC_WATCHDOG_MIN_MS) {
+         if (elapsed >= limit) {
+            Logger.fwriteln(stderr, "[watchdog] %s has been running for %.1fs (usually %.1fs)",
+                            job->label, elapsed / 1000.0, job->expected_ms / 1000.0);
+            s->warned = 1;
+         } else if (due < 0 || limit - elapsed < due) {
+            due = limit - elapsed;
+         }
+      }
+      if (due >= 0 && (next < 0 || due < next)) next = due;
+   }
+
+   // Reap abandoned children that have finally exited
+   for (int i = 0; i < abandoned_count; i++) {
+      if (waitpid(abandoned[i], NULL, WNOHANG) == abandoned[i]) abandoned[i--] = abandoned[--abandoned_count];
+   }
+
+   return next > INT32_MAX ? INT32_MAX : (int)next;
+}
+
+/* Wait until a job completes (or the watched descriptor is readable) */
+static ExecJob exec_wait(void) {
+   struct epoll_event events[EXEC_MAX_EVENTS];
+
+   while (running_count > 0 || (watch_fd >= 0 && !interrupted)) {
+      int timeout = exec_check_timers();
+      for (int i = 0; i < slot_count; i++) {
+         if (slots[i].job && slots[i].exited) return exec_complete(&slots[i]);
+      }
+
+      int n = epoll_wait(epoll_fd, events, EXEC_MAX_EVENTS, timeout);
+      if (n < 0) {
+         if (errno == EINTR) continue;
+         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "epoll_wait failed: %s\n", strerror(errno));
+         return NULL;
+      }
+      int is_watched = 0;
+      for (int i = 0; i < n; i++) {
+         int slot = (int)(events[i].data.u64 >> 8);
+         int tag = (int)(events[i].data.u64 & 0xff);
+         exec_slot_s *s = &slots[slot];
+
+         switch (tag) {
+         case TAG_WATCH:
+            is_watched = 1;
+            break;
+         case TAG_STDOUT:
+            capture_drain(&s->out);
+            break;
+         case TAG_STDERR:
+            capture_drain(&s->err);
+            break;
+         case TAG_PIDFD:
+            if (s->job && !s->exited) exec_reap(s);
+            break;
+         case TAG_SIGNAL: {
+            struct signalfd_siginfo info;
+            int child_exited = 0;
+            while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+               if (info.ssi_signo == SIGCHLD) {
+                  child_exited = 1;
+               } else {
+                  // Forward the interrupt; a second one escalates to SIGKILL
+                  Logger.fwriteln(stderr, "[executor] %s received; stopping %d running job(s)",
+                                  strsignal(info.ssi_signo), running_count);
+                  exec_terminate(interrupted ? SIGKILL : (int)info.ssi_signo);
+                  interrupted = (int)info.ssi_signo;
+               }
+            }
+            for (int j = 0; child_exited && j < slot_count; j++) {
+               if (slots[j].job && !slots[j].exited) exec_reap(&slots[j]);
+            }
+            break;
+         }
+         }
+      }
+      if (is_watched) return NULL;
+   }
+
+   return NULL;
+}
+
+/* Watch a caller descriptor: waits return NULL while it is readable, even with no jobs running */
+static int exec_watch(int fd) {
+   if (epoll_fd < 0) return SB_FALSE;
+   if (watch_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch_fd, NULL);
+   watch_fd = -1;
+   struct epoll_event ev = {.events = EPOLLIN, .data.u64 = exec_tag(0, TAG_WATCH)};
+   if (fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) return SB_FALSE;
+   watch_fd = fd;
+   return SB_TRUE;
+}
+
+/* Interrupt signal received while waiting (0 = none) */
+static int exec_interrupted(void) {
+   return interrupted;
+}
+
+/* Signal one running job's process group; it is reaped by a later wait */
+static void exec_cancel(ExecJob job) {
+   for (int i = 0; slots && i < slot_count; i++) {
+      exec_slot_s *s = &slots[i];
+      if (s->job != job || s->exited) continue;
+      s->cancelled = 1;
+      exec_kill(s, SIGTERM);
+   }
+}
+
+/* Signal every running job's process group; the jobs are reaped by the next waits */
+static void exec_terminate(int signal) {
+   for (int i = 0; slots && i < slot_count; i++) {
+      exec_slot_s *s = &slots[i];
+      if (!s->job || s->exited) continue;
+      s->cancelled = 1;
+      exec_kill(s, signal);
+   }
+}
+
+/* Terminate running jobs and release executor resources */
+static void exec_shutdown(void) {
+   for (int i = 0; slots && i < slot_count; i++) {
+      exec_slot_s *s = &slots[i];
+      if (!s->job) continue;
+      if (!s->exited) {
+         kill(-s->pid, SIGKILL);
+         while (waitpid(s->pid, NULL, 0) < 0 && errno == EINTR);
+      }
+      if (s->pidfd >= 0) close(s->pidfd);
+      capture_close(&s->out);
+      capture_close(&s->err);
+      capture_flush(&s->out, STDOUT_FILENO);
+      capture_flush(&s->err, STDERR_FILENO);
+      s->job = NULL;
+   }
+   free(slots);
+   slots = NULL;
+   slot_count = running_count = 0;
+   // Don't block on abandoned children; whatever has exited is reaped, the rest go to init
+   for (int i = 0; i < abandoned_count; i++) waitpid(abandoned[i], NULL, WNOHANG);
+   free(abandoned);
+   abandoned = NULL;
+   abandoned_count = 0;
+
+   if (signal_fd >= 0) close(signal_fd);
+   if (epoll_fd >= 0) {
+      close(epoll_fd);
+      sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+   }
+   signal_fd = epoll_fd = watch_fd = -1;
+}
+
+const IExecutor Executor = {
+    .get_version = exec_get_version,
+    .init = exec_init,
+    .has_slot = exec_has_slot,
+    .start = exec_start,
+    .wait = exec_wait,
+    .running = exec_running,
+    .terminate = exec_terminate,
+    .cancel = exec_cancel,
+    .watch = exec_watch,
+    .interrupted = exec_interrupted,
+    .shutdown = exec_shutdown,
+};
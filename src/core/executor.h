@@ -0,0 +1,111 @@
+/* src/core/executor.h
+ * Sigma.Build Job Executor
+ * Runs child processes concurrently and captures their output.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * EXECUTOR_VERSION "0.00.02.004"
+ *
+ * This file provides an interface for running build commands as child processes.
+ * Jobs are watched from a single epoll loop (pidfd per child, or a SIGCHLD signalfd
+ * on kernels without pidfd) and each job's stdout/stderr is captured through pipes
+ * so that the output of parallel jobs is printed as one block when the job completes.
+ * Every job runs in its own process group with stdin closed, so a timeout can kill the
+ * whole tree and a command waiting on input fails instead of stalling the build.
+ */
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "sbuild.h"
+
+#define EXEC_SPILL_THRESHOLD (64 * 1024) // Captured bytes kept in memory before spilling to a temp file
+#define EXEC_STATUS_SPAWN_FAILED 127     // Exit status reported when a job could not be started
+#define EXEC_STATUS_TIMED_OUT 124        // Exit status reported when a job exceeded its timeout
+#define EXEC_KILL_GRACE_MS 2000          // Time a killed job gets to exit before its slot is freed anyway
+#define EXEC_WATCHDOG_MIN_MS 1000        // Watchdog limits shorter than this are not watched (fast jobs are noisy)
+
+typedef struct exec_job_s {
+   string label;     // Short description of the job (used in diagnostics)
+   string command;   // Shell command to execute when argv is NULL
+   char **argv;      // NULL-terminated argument vector executed directly (PATH lookup)
+   string output;    // Primary output of the job (keys its build log entry; NULL for op commands)
+   long timeout_ms;  // Wall-clock limit before the job's process group is killed (0 = none)
+   long expected_ms; // Typical duration from history; the watchdog reports overruns (0 = unknown)
+   int status;       // Exit status of the job (128 + signal if killed); valid after completion
+   int timed_out;    // Set when the job was killed for exceeding timeout_ms
+   long duration_ms; // Wall-clock run time; valid after completion
+   object data;      // Caller data associated with the job
+} exec_job_s;
+
+/**
+ * @brief IExecutor interface.
+ * @details Provides an interface for running jobs in parallel. The caller starts jobs
+ *          while slots are available and then blocks in `wait` until one completes.
+ *          The loop never polls: it sleeps in epoll until a child exits or writes output.
+ */
+typedef struct IExecutor {
+   /**
+    * @brief Gets the version of the executor.
+    * @return :the version of the executor as a string
+    */
+   const char *(*get_version)(void);
+   /**
+    * @brief Initializes the executor.
+    * @param max_jobs :the maximum number of jobs running at once (0 = online CPUs)
+    * @param watchdog :report jobs running longer than this multiple of their expected duration (0 = off)
+    * @return :1 if the executor is ready; otherwise, 0
+    */
+   int (*init)(int, int);
+   /**
+    * @brief Checks whether another job can be started.
+    * @return :1 if a slot is free; otherwise, 0
+    */
+   int (*has_slot)(void);
+   /**
+    * @brief Starts a job in a free slot.
+    * @param job :the job to start
+    * @return :1 if the job was started; otherwise, 0 (job->status is set)
+    */
+   int (*start)(ExecJob);
+   /**
+    * @brief Waits for the next job to complete and prints its captured output.
+    * @return :the completed job, or NULL if no jobs are running (or the watched descriptor is readable)
+    */
+   ExecJob (*wait)(void);
+   /**
+    * @brief Gets the number of running jobs.
+    * @return :the number of jobs currently running
+    */
+   int (*running)(void);
+   /**
+    * @brief Sends a signal to every running job's process group; their captured output is discarded.
+    * @param signal :the signal to send (e.g. SIGTERM)
+    */
+   void (*terminate)(int);
+   /**
+    * @brief Terminates one running job (its output is discarded); a later `wait` returns it.
+    * @param job :the job to cancel
+    */
+   void (*cancel)(ExecJob);
+   /**
+    * @brief Adds a descriptor to the wait loop: `wait` returns NULL while it is readable and
+    *        keeps waiting on it even when no jobs are running.
+    * @param fd :the descriptor to watch (-1 to stop watching)
+    * @return :1 if the descriptor is watched; otherwise, 0
+    */
+   int (*watch)(int);
+   /**
+    * @brief Gets the interrupt (SIGINT/SIGTERM) received while waiting, if any.
+    * @return :the signal number, or 0 if the build was not interrupted
+    */
+   int (*interrupted)(void);
+   /**
+    * @brief Terminates any running jobs and releases executor resources.
+    */
+   void (*shutdown)(void);
+} IExecutor;
+
+extern const IExecutor Executor;
+
+#endif // EXECUTOR_H
@@ -0,0 +1,164 @@
+/* src/core/file_stats.c
+ * Sigma.Build File Stats
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * Metadata comes from statx asking for the modification time and size only (falling back
+ * to stat where statx is unavailable). A batch hands its uncached paths to up to
+ * FILE_STATS_THREADS threads that claim paths from a shared counter and write results into
+ * their own slots; the calling thread alone touches the cache, after the threads joined.
+ */
+#define _GNU_SOURCE
+#include "file_stats.h"
+#include "string_map.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+typedef struct stat_batch_s {
+   char **paths;         // Paths to stat
+   file_stat_s *results; // Result for each path
+   int count;            // Number of paths
+   int next;             // Next path to claim (shared by the threads)
+} stat_batch_s;
+
+static StringMap cache = NULL; // Path -> file_stat_s (mtime INT64_MIN: forgotten)
+static int has_statx = 1;      // Cleared when the kernel lacks statx (by whichever batch thread finds out)
+static uint64_t generation = 0; // Count of the times cached metadata was forgotten
+
+/* Stat one file */
+static void stats_read(const char *path, file_stat_s *st) {
+   struct statx stx;
+   int is_statx = __atomic_load_n(&has_statx, __ATOMIC_RELAXED);
+   if (is_statx) {
+      if (statx(AT_FDCWD, path, AT_STATX_SYNC_AS_STAT, STATX_MTIME | STATX_SIZE, &stx) == 0) {
+         st->mtime_ns = (int64_t)stx.stx_mtime.tv_sec * 1000000000LL + stx.stx_mtime.tv_nsec;
+         st->size = (int64_t)stx.stx_size;
+         return;
+      }
+      if (errno == ENOSYS) {
+         __atomic_store_n(&has_statx, 0, __ATOMIC_RELAXED);
+         is_statx = 0;
+      }
+   }
+   struct stat buf;
+   if (!is_statx && stat(path, &buf) == 0) {
+      st->mtime_ns = (int64_t)buf.st_mtim.tv_sec * 1000000000LL + buf.st_mtim.tv_nsec;
+      st->size = (int64_t)buf.st_size;
+      return;
+   }
+   st->mtime_ns = -1;
+   st->size = 0;
+}
+/* Batch thread: stat paths until none are left to claim */
+static void *stats_worker(void *data) {
+   stat_batch_s *batch = data;
+   for (int i; (i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count;) {
+      stats_read(batch->paths[i], &batch->results[i]);
+   }
+   return NULL;
+}
+/* Cache a result */
+static int stats_put(const char *path, const file_stat_s *st) {
+   file_stat_s *cached = StringMaps.get(cache, path);
+   if (!cached) {
+      addr cached_addr;
+      if (!Resources.alloc(&cached_addr, sizeof(file_stat_s))) return SB_FALSE;
+      cached = (file_stat_s *)cached_addr;
+      if (!StringMaps.put(cache, path, cached)) {
+         free(cached);
+         return SB_FALSE;
+      }
+   }
+   *cached = *st;
+   return SB_TRUE;
+}
+
+static int stats_get(const char *path, file_stat_s *st) {
+   if (!cache && !(cache = StringMaps.create())) {
+      stats_read(path, st);
+      return st->mtime_ns >= 0;
+   }
+
+   file_stat_s *cached = StringMaps.get(cache, path);
+   if (cached && cached->mtime_ns != INT64_MIN) {
+      *st = *cached;
+   } else {
+      stats_read(path, st);
+      stats_put(path, st);
+   }
+   return st->mtime_ns >= 0;
+}
+
+static int stats_scan(char **paths, int count) {
+   if (!cache && !(cache = StringMaps.create())) return 0;
+
+   // Only uncached paths are stat'ed
+   addr pending_addr, results_addr;
+   if (count <= 0 || !Resources.alloc(&pending_addr, count * sizeof(char *))) return 0;
+   stat_batch_s batch = {.paths = (char **)pending_addr};
+   for (int i = 0; i < count; i++) {
+      file_stat_s *cached = StringMaps.get(cache, paths[i]);
+      if (!cached || cached->mtime_ns == INT64_MIN) batch.paths[batch.count++] = paths[i];
+   }
+   if (batch.count == 0 || !Resources.alloc(&results_addr, batch.count * sizeof(file_stat_s))) {
+      free(batch.paths);
+      return 0;
+   }
+   batch.results = (file_stat_s *)results_addr;
+
+   pthread_t threads[FILE_STATS_THREADS];
+   int thread_count = batch.count / FILE_STATS_PER_THREAD;
+   if (thread_count > FILE_STATS_THREADS) thread_count = FILE_STATS_THREADS;
+   int started = 0;
+   for (; started < thread_count - 1; started++) {
+      if (pthread_create(&threads[started], NULL, stats_worker, &batch) != 0) break;
+   }
+   stats_worker(&batch); // The calling thread takes a share too
+   for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+   for (int i = 0; i < batch.count; i++) stats_put(batch.paths[i], &batch.results[i]);
+   int scanned = batch.count;
+   free(batch.results);
+   free(batch.paths);
+   return scanned;
+}
+
+static void stats_assume(const char *path, const file_stat_s *st) {
+   if (cache || (cache = StringMaps.create())) stats_put(path, st);
+}
+
+static void stats_invalidate(const char *path) {
+   file_stat_s *cached = path ? StringMaps.get(cache, path) : NULL;
+   if (cached && cached->mtime_ns != INT64_MIN) {
+      cached->mtime_ns = INT64_MIN; // Forgotten (keys cannot be removed from the map)
+      generation++;
+   }
+}
+
+/* Map visitor: free a cached entry */
+static void stats_free_entry(const char *path, object value, object data) {
+   free(value);
+}
+static void stats_reset(void) {
+   StringMaps.each(cache, stats_free_entry, NULL);
+   StringMaps.dispose(cache);
+   cache = NULL;
+   generation++;
+}
+
+static uint64_t stats_generation(void) {
+   return generation;
+}
+
+const IFileStats FileStats = {
+    .get = stats_get,
+    .scan = stats_scan,
+    .assume = stats_assume,
+    .invalidate = stats_invalidate,
+    .reset = stats_reset,
+    .generation = stats_generation,
+};
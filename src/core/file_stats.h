@@ -0,0 +1,69 @@
+/* src/core/file_stats.h
+ * Sigma.Build File Stats
+ * A process-wide cache of file metadata filled by parallel, batched stat calls.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for looking up file modification times and sizes. Each
+ * path is stat'ed once per build, however many actions read it; a build stats everything
+ * its freshness checks need in one batch spread over a few threads, so the checks
+ * themselves only hit the cache. Writers of a file must invalidate it.
+ */
+#ifndef FILE_STATS_H
+#define FILE_STATS_H
+
+#include "sbuild.h"
+
+#define FILE_STATS_THREADS 8          // Threads stat'ing a batch (stat latency, not CPU, is the limit)
+#define FILE_STATS_PER_THREAD 64      // Paths per thread below which a batch uses fewer threads
+
+typedef struct file_stat_s {
+   int64_t mtime_ns; // Modification time (-1 if the file does not exist)
+   int64_t size;     // Size in bytes (0 if the file does not exist)
+} file_stat_s;
+
+/**
+ * @brief IFileStats interface.
+ * @details Provides an interface for the file metadata cache.
+ */
+typedef struct IFileStats {
+   /**
+    * @brief Gets a file's metadata, stat'ing it only if it is not cached.
+    * @param path :the file path
+    * @param st :receives the metadata (mtime -1 if the file does not exist)
+    * @return :1 if the file exists; otherwise, 0
+    */
+   int (*get)(const char *, file_stat_s *);
+   /**
+    * @brief Stats every uncached path of a batch in parallel and caches the results.
+    * @param paths :the file paths
+    * @param count :number of paths
+    * @return :number of paths stat'ed (cached ones are skipped)
+    */
+   int (*scan)(char **, int);
+   /**
+    * @brief Caches metadata learned without a stat (e.g. from a change journal).
+    * @param path :the file path
+    * @param st :the metadata
+    */
+   void (*assume)(const char *, const file_stat_s *);
+   /**
+    * @brief Forgets a path after it was written, so the next lookup stats it again.
+    * @param path :the file path
+    */
+   void (*invalidate)(const char *);
+   /**
+    * @brief Forgets every path (after a step that may have written any file).
+    */
+   void (*reset)(void);
+   /**
+    * @brief Counts the times cached metadata was forgotten (invalidated or reset).
+    * @return :the generation; while it is unchanged, every answer given so far still holds
+    */
+   uint64_t (*generation)(void);
+} IFileStats;
+
+extern const IFileStats FileStats;
+
+#endif // FILE_STATS_H
@@ -0,0 +1,685 @@
+/* src/core/git_index.c
+ * Sigma.Build Git Index
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * The index (versions 2 to 4) is mapped and its entries listed in path order, so a lookup is
+ * a binary search. Each entry is summed up by a hash of its stat data, object id and flags:
+ * git rewrites the entry whenever it sees the file change. The snapshot is a text file of
+ * `<path>\t<entry_hash>\t<mtime_ns>\t<size>` lines (paths relative to the repository top).
+ * Files edited but not staged keep their entries: fsmonitor lists them, so nothing is lstat'ed
+ * to find them. The index's FSMN extension flags the entries git has not checked since it
+ * wrote the index, and holds the token fsmonitor is asked for the files changed since; the
+ * core.fsmonitor hook is spawned with it (protocol 2, or 1 if core.fsmonitorHookVersion says so;
+ * git would retry a failed hook with 1), or the builtin daemon is asked over its socket when
+ * core.fsmonitor is `true`. Without fsmonitor the
+ * index is not used: git's own check (`git diff-files`) lstats every tracked file, which costs
+ * as much as the stats it would save.
+ * Entries git cannot vouch for are never trusted: conflicts, assume-unchanged, skip-worktree
+ * and intent-to-add entries, entries the FSMN extension flags, and "racy" ones modified no
+ * earlier than the index was written. Paths are resolved lexically (`dir/..` unless `dir` is a
+ * tracked symlink). Split indexes are not read (the build falls back to stat'ing everything).
+ */
+#define _GNU_SOURCE
+#include "git_index.h"
+#include "string_map.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define GIT_SNAPSHOT_HEADER "# sbuild git snapshot v1"
+#define GIT_ENTRY_STAT_SIZE 40    // ctime, mtime, dev, ino, mode, uid, gid, size
+#define GIT_FLAG_ASSUME_VALID 0x8000
+#define GIT_FLAG_EXTENDED 0x4000
+#define GIT_FLAG_STAGE 0x3000
+#define GIT_FLAG_NAME_MASK 0x0fff
+#define GIT_EXT_FLAGS 0x6000      // skip-worktree, intent-to-add
+#define GIT_FSMONITOR_SOCKET "fsmonitor--daemon.ipc" // The builtin daemon's socket in the git directory
+
+extern char **environ;
+
+typedef struct git_entry_s {
+   const char *path;   // Path relative to the repository top
+   uint64_t hash;      // Hash of the entry's stat data, object id and flags
+   int is_trusted;     // Clear if git does not vouch for the file (see above)
+} git_entry_s;
+
+typedef struct git_record_s {
+   uint64_t hash;      // Index entry hash when the metadata was read
+   int64_t mtime_ns;   // Metadata the build read
+   int64_t size;
+} git_record_s;
+
+typedef struct git_use_s {
+   char *path;             // Path as the build spells it
+   git_record_s *record;   // Snapshot record to update
+   const git_entry_s *entry;
+} git_use_s;
+
+static unsigned char *mapped = NULL;  // The index file
+static size_t mapped_size = 0;
+static git_entry_s *entries = NULL;   // Index entries in path order
+static int entry_count = 0;
+static int is_v4 = 0;                 // Entry paths were decompressed into allocated strings
+static char top[4096];                // Repository top (absolute)
+static char prefix[4096];             // Working directory relative to the top ("" or ending with '/')
+static char git_dir[4200];            // Git directory of the worktree (absolute)
+static int fsmonitor_version = 0;     // Version of the index's FSMN extension (0: none)
+static int hook_version = 2;          // Protocol the hook speaks (the daemon's answers are those of 2)
+static char fsmonitor_token[1024];    // Its token: what fsmonitor is asked for the changes since
+static char *snapshot_path = NULL;
+static StringMap snapshot = NULL;     // Top-relative path -> git_record_s
+static StringMap modified = NULL;     // Top-relative paths (and directories, ending with '/') changed since the index was written
+static int has_modified_dirs = 0;     // Set if fsmonitor listed a directory
+static pid_t query_pid = -1;          // fsmonitor hook listing them (read at the first lookup)
+static int query_fd = -1;             // Its output, or the daemon's socket
+static int is_daemon = 0;             // Set if the daemon answers (in pkt-lines)
+static int is_usable = 0;             // Cleared if fsmonitor gave no answer
+static git_use_s *uses = NULL;        // Looked-up tracked files
+static int use_count = 0, use_cap = 0;
+static int reused = 0;                // Lookups answered from the snapshot
+
+/* Read a big-endian 32-bit number */
+static uint32_t git_be32(const unsigned char *p) {
+   return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+/* Read a big-endian 64-bit number */
+static uint64_t git_be64(const unsigned char *p) {
+   return (uint64_t)git_be32(p) << 32 | git_be32(p + 4);
+}
+/* FNV-1a over a block of bytes */
+static uint64_t git_hash_bytes(const void *data, size_t size) {
+   const unsigned char *bytes = data;
+   uint64_t hash = 14695981039346656037ULL;
+   for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+   return hash;
+}
+/* Find the repository holding the working directory; fills `top`, `prefix` and `git_dir` */
+static int git_find_repository(void) {
+   char cwd[4096], dir[4096], path[4200];
+   if (!getcwd(cwd, sizeof(cwd))) return SB_FALSE;
+   strcpy(dir, cwd);
+   struct stat st;
+   for (;;) {
+      snprintf(path, sizeof(path), "%s/.git", strcmp(dir, "/") == 0 ? "" : dir);
+      if (stat(path, &st) == 0) break;
+      char *slash = strrchr(dir, '/');
+      if (!slash || slash == dir) return SB_FALSE;
+      *slash = '\0';
+   }
+   strcpy(top, dir);
+   size_t top_len = strlen(top);
+   snprintf(prefix, sizeof(prefix), "%s%s", cwd[top_len] ? cwd + top_len + 1 : "", cwd[top_len] ? "/" : "");
+
+   if (S_ISDIR(st.st_mode)) {
+      snprintf(git_dir, sizeof(git_dir), "%s/.git", top);
+      return SB_TRUE;
+   }
+   // A linked worktree or submodule: `.git` names the real git directory
+   FILE *file = fopen(path, "r");
+   char line[4096];
+   int is_found = file && fgets(line, sizeof(line), file) && strncmp(line, "gitdir: ", 8) == 0;
+   if (file) fclose(file);
+   if (!is_found) return SB_FALSE;
+   line[strcspn(line, "\r\n")] = '\0';
+   int written = line[8] == '/' ? snprintf(git_dir, sizeof(git_dir), "%s", line + 8)
+                                : snprintf(git_dir, sizeof(git_dir), "%s/%s", top, line + 8);
+   return written < (int)sizeof(git_dir);
+}
+/* Read `section.key` from a git config file into `value` (the last setting wins; a bare key is "true") */
+static void git_config_read(const char *path, const char *section, const char *key, char *value, size_t len) {
+   FILE *file = fopen(path, "r");
+   char line[4096];
+   int is_in_section = SB_FALSE;
+   while (file && fgets(line, sizeof(line), file)) {
+      char *start = line + strspn(line, " \t");
+      start[strcspn(start, "\r\n")] = '\0';
+      if (*start == '[') {
+         // `[core]` only: subsections (`[remote "origin"]`) hold other keys
+         size_t name_len = strcspn(start + 1, "]");
+         is_in_section = strlen(section) == name_len && strncasecmp(start + 1, section, name_len) == 0;
+         continue;
+      }
+      size_t key_len = strcspn(start, " \t=");
+      if (!is_in_section || key_len != strlen(key) || strncasecmp(start, key, key_len) != 0) continue;
+      char *rest = start + key_len + strspn(start + key_len, " \t");
+      if (*rest != '=') {
+         snprintf(value, len, "%s", *rest ? "" : "true");
+         continue;
+      }
+      rest += 1 + strspn(rest + 1, " \t");
+      size_t value_len = strlen(rest);
+      while (value_len > 0 && (rest[value_len - 1] == ' ' || rest[value_len - 1] == '\t')) value_len--;
+      if (value_len >= 2 && rest[0] == '"' && rest[value_len - 1] == '"') {
+         rest++;
+         value_len -= 2;
+      }
+      snprintf(value, len, "%.*s", (int)value_len, rest);
+   }
+   if (file) fclose(file);
+}
+/* Read `section.key` from the user's config, then the repository's (a linked worktree's shares it through `commondir`) */
+static void git_config_get(const char *section, const char *key, char *value, size_t len) {
+   char path[8400], common[4096];
+   value[0] = '\0';
+   const char *home = getenv("HOME");
+   if (home && *home) {
+      snprintf(path, sizeof(path), "%s/.gitconfig", home);
+      git_config_read(path, section, key, value, len);
+   }
+
+   snprintf(path, sizeof(path), "%s/commondir", git_dir);
+   FILE *file = fopen(path, "r");
+   int is_linked = file && fgets(common, sizeof(common), file);
+   if (file) fclose(file);
+   if (is_linked) {
+      common[strcspn(common, "\r\n")] = '\0';
+      if (common[0] == '/') snprintf(path, sizeof(path), "%s/config", common);
+      else snprintf(path, sizeof(path), "%s/%s/config", git_dir, common);
+   } else {
+      snprintf(path, sizeof(path), "%s/config", git_dir);
+   }
+   git_config_read(path, section, key, value, len);
+}
+/* Read a git boolean: 1 for true, 0 for false (or unset), -1 for any other value */
+static int git_config_bool(const char *value) {
+   const char *truths[] = {"true", "yes", "on", "1"}, *falsehoods[] = {"false", "no", "off", "0", ""};
+   for (size_t i = 0; i < sizeof(truths) / sizeof(truths[0]); i++) {
+      if (strcasecmp(value, truths[i]) == 0) return 1;
+   }
+   for (size_t i = 0; i < sizeof(falsehoods) / sizeof(falsehoods[0]); i++) {
+      if (strcasecmp(value, falsehoods[i]) == 0) return 0;
+   }
+   return -1;
+}
+/* Size of the object ids: sha256 repositories say so in their config */
+static size_t git_hash_size(void) {
+   char format[64];
+   git_config_get("extensions", "objectformat", format, sizeof(format));
+   return strcasecmp(format, "sha256") == 0 ? 32 : 20;
+}
+/* Clear the trust of the entries an FSMN bitmap (EWAH-compressed) flags; returns 0 if it is malformed */
+static int git_read_fsmonitor_bitmap(const unsigned char *p, const unsigned char *end) {
+   // Bit count, word count, the words, and the position of the last marker word
+   if (end - p < 8) return SB_FALSE;
+   uint32_t word_count = git_be32(p + 4);
+   p += 8;
+   if ((size_t)(end - p) < (size_t)word_count * 8 + 4) return SB_FALSE;
+
+   // Each marker word gives a run of equal words (its bit 0 is their bits) and a count of literal words after it
+   uint64_t bit = 0;
+   for (uint32_t i = 0; i < word_count;) {
+      uint64_t marker = git_be64(p + 8 * (size_t)i++);
+      uint64_t run_bits = ((marker >> 1) & 0xffffffffULL) * 64, literal_count = marker >> 33;
+      for (uint64_t b = bit; (marker & 1) && b < bit + run_bits && b < (uint64_t)entry_count; b++) entries[b].is_trusted = 0;
+      bit += run_bits;
+      for (uint64_t j = 0; j < literal_count && i < word_count; j++, bit += 64) {
+         uint64_t word = git_be64(p + 8 * (size_t)i++);
+         for (int b = 0; word && b < 64 && bit + b < (uint64_t)entry_count; b++) {
+            if (word >> b & 1) entries[bit + b].is_trusted = 0;
+         }
+      }
+   }
+   return SB_TRUE;
+}
+/* Read the FSMN extension: its version and token, and the entries git has not checked since */
+static int git_read_fsmonitor(const unsigned char *p, const unsigned char *end) {
+   if (end - p < 4) return SB_FALSE;
+   uint32_t version = git_be32(p);
+   p += 4;
+   if (version == 1) {
+      // Version 1 keeps the time the index was checked, in nanoseconds
+      if (end - p < 8) return SB_FALSE;
+      snprintf(fsmonitor_token, sizeof(fsmonitor_token), "%llu", (unsigned long long)git_be64(p));
+      p += 8;
+   } else if (version == 2) {
+      size_t token_len = strnlen((const char *)p, end - p);
+      if (p + token_len >= end || token_len >= sizeof(fsmonitor_token)) return SB_FALSE;
+      memcpy(fsmonitor_token, p, token_len + 1);
+      p += token_len + 1;
+   } else {
+      return SB_FALSE;
+   }
+   if (end - p < 4 || (size_t)(end - p - 4) < git_be32(p)) return SB_FALSE;
+   if (!git_read_fsmonitor_bitmap(p + 4, p + 4 + git_be32(p))) return SB_FALSE;
+   fsmonitor_version = version;
+   return SB_TRUE;
+}
+/* List the entries of the mapped index; returns 0 for a format not read here */
+static int git_read_entries(size_t hash_size, int64_t index_mtime_ns) {
+   if (mapped_size < 12 + hash_size || memcmp(mapped, "DIRC", 4) != 0) return SB_FALSE;
+   uint32_t version = git_be32(mapped + 4), count = git_be32(mapped + 8);
+   if (version < 2 || version > 4 || !(entries = calloc(count + 1, sizeof(git_entry_s)))) return SB_FALSE;
+   is_v4 = version == 4;
+
+   const unsigned char *p = mapped + 12, *end = mapped + mapped_size - hash_size;
+   const char *previous = "";
+   for (uint32_t i = 0; i < count; i++) {
+      size_t fixed = GIT_ENTRY_STAT_SIZE + hash_size + 2;
+      if (p + fixed > end) return SB_FALSE;
+      uint16_t flags = (uint16_t)(p[fixed - 2] << 8 | p[fixed - 1]);
+      uint16_t ext_flags = 0;
+      if (version >= 3 && (flags & GIT_FLAG_EXTENDED)) {
+         if (p + fixed + 2 > end) return SB_FALSE;
+         ext_flags = (uint16_t)(p[fixed] << 8 | p[fixed + 1]);
+         fixed += 2;
+      }
+      git_entry_s *entry = &entries[i];
+      entry->hash = git_hash_bytes(p, fixed);
+      int64_t mtime_ns = (int64_t)git_be32(p + 8) * 1000000000LL + git_be32(p + 12);
+      entry->is_trusted = !(flags & (GIT_FLAG_ASSUME_VALID | GIT_FLAG_STAGE)) && !(ext_flags & GIT_EXT_FLAGS) &&
+                          mtime_ns < index_mtime_ns;
+
+      const char *name = (const char *)p + fixed;
+      if (!is_v4) {
+         size_t name_len = flags & GIT_FLAG_NAME_MASK;
+         if (name_len == GIT_FLAG_NAME_MASK) name_len = strnlen(name, (const char *)end - name);
+         if (name + name_len >= (const char *)end) return SB_FALSE;
+         entry->path = name;
+         p += (fixed + name_len + 8) & ~(size_t)7; // NUL-padded to a multiple of 8
+      } else {
+         // The path drops a number of trailing bytes from the previous one and appends a suffix
+         const unsigned char *q = (const unsigned char *)name;
+         size_t strip = *q & 127;
+         while (*q++ & 128) {
+            if (q >= end) return SB_FALSE;
+            strip = ((strip + 1) << 7) | (*q & 127);
+         }
+         size_t kept = strlen(previous), suffix_len = strnlen((const char *)q, end - q);
+         if (strip > kept || q + suffix_len >= end) return SB_FALSE;
+         char *path = malloc(kept - strip + suffix_len + 1);
+         if (!path) return SB_FALSE;
+         memcpy(path, previous, kept - strip);
+         memcpy(path + kept - strip, q, suffix_len + 1);
+         entry->path = previous = path;
+         entry_count = i + 1; // Paths allocated so far
+         p = q + suffix_len + 1;
+      }
+   }
+   entry_count = count;
+
+   // Entries of a split index live in another file; the fsmonitor data follows the entries
+   while (p + 8 <= end) {
+      uint32_t size = git_be32(p + 4);
+      if (memcmp(p, "link", 4) == 0 || (size_t)(end - p - 8) < size) return SB_FALSE;
+      if (memcmp(p, "FSMN", 4) == 0 && !git_read_fsmonitor(p + 8, p + 8 + size)) return SB_FALSE;
+      p += 8 + size;
+   }
+   return SB_TRUE;
+}
+/* Ask fsmonitor which files changed since the index was written: the hook is spawned, the daemon asked over its socket */
+static int git_start_query(const char *hook) {
+   if (!(modified = StringMaps.create())) return SB_FALSE;
+   if (is_daemon) {
+      // One pkt-line holding the token, then a flush packet
+      struct sockaddr_un address = {.sun_family = AF_UNIX};
+      int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      char request[sizeof(fsmonitor_token) + 8];
+      int request_len = snprintf(request, sizeof(request), "%04x%s0000", (unsigned)strlen(fsmonitor_token) + 4, fsmonitor_token);
+      int is_sent = fd >= 0 &&
+                    snprintf(address.sun_path, sizeof(address.sun_path), "%s/%s", git_dir, GIT_FSMONITOR_SOCKET) <
+                        (int)sizeof(address.sun_path) &&
+                    connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0 &&
+                    write(fd, request, request_len) == request_len;
+      if (!is_sent) {
+         if (fd >= 0) close(fd);
+         return SB_FALSE;
+      }
+      query_fd = fd;
+      return SB_TRUE;
+   }
+
+   // git runs the hook through the shell from the repository top, with the protocol version and the token
+   int fds[2];
+   if (pipe2(fds, O_CLOEXEC) != 0) return SB_FALSE;
+   char script[4200], version[4];
+   snprintf(script, sizeof(script), "cd \"$0\" || exit 1; %s \"$@\"", hook);
+   snprintf(version, sizeof(version), "%d", hook_version);
+   char *argv[] = {"sh", "-c", script, top, version, fsmonitor_token, NULL};
+   posix_spawn_file_actions_t actions;
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+   posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+   int spawned = posix_spawn(&query_pid, "/bin/sh", &actions, NULL, argv, environ) == 0;
+   posix_spawn_file_actions_destroy(&actions);
+   close(fds[1]);
+   if (!spawned) {
+      close(fds[0]);
+      return SB_FALSE;
+   }
+   query_fd = fds[0];
+   return SB_TRUE;
+}
+/* Read exactly `size` bytes; returns 0 at an early end */
+static int git_read_exactly(int fd, char *data, size_t size) {
+   while (size > 0) {
+      ssize_t n = read(fd, data, size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return SB_FALSE;
+      data += n;
+      size -= n;
+   }
+   return SB_TRUE;
+}
+/* Read the whole answer: the hook's output up to its end, or the daemon's pkt-lines up to a flush packet */
+static char *git_read_answer(size_t *answer_len) {
+   char *answer = NULL, header[5] = {0};
+   size_t len = 0, cap = 0;
+   for (;;) {
+      size_t want = 65536;
+      if (is_daemon) {
+         if (!git_read_exactly(query_fd, header, 4)) break;
+         want = strtoul(header, NULL, 16);
+         if (want == 0) {
+            if (answer) answer[len] = '\0'; // Flush packet: the answer is complete
+            *answer_len = len;
+            return answer ? answer : calloc(1, 1);
+         }
+         if (want < 4) break;
+         want -= 4;
+      }
+      if (len + want + 1 > cap) {
+         size_t grown_cap = (len + want + 1) * 2;
+         char *grown = realloc(answer, grown_cap);
+         if (!grown) break;
+         answer = grown;
+         cap = grown_cap;
+      }
+      if (is_daemon) {
+         if (!git_read_exactly(query_fd, answer + len, want)) break;
+         len += want;
+         continue;
+      }
+      ssize_t n = read(query_fd, answer + len, want);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) break;
+      if (n == 0) {
+         answer[len] = '\0';
+         *answer_len = len;
+         return answer;
+      }
+      len += n;
+   }
+   free(answer);
+   return NULL;
+}
+/* Collect fsmonitor's answer; returns 0 if it gave none, or cannot tell what changed */
+static int git_finish_query(void) {
+   size_t len = 0;
+   char *answer = git_read_answer(&len);
+   close(query_fd);
+   query_fd = -1;
+   int status = 0;
+   if (query_pid > 0) {
+      while (waitpid(query_pid, &status, 0) < 0 && errno == EINTR) {}
+   }
+   query_pid = -1;
+   if (!answer || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      free(answer);
+      return SB_FALSE;
+   }
+
+   // NUL-terminated paths, after the new token in protocol 2; "/" means anything may have changed
+   char *path = answer + (hook_version == 2 ? strlen(answer) + 1 : 0), *end = answer + len;
+   int is_listed = hook_version != 2 || len > 0;
+   for (size_t n; is_listed && path < end; path += n + 1) {
+      if ((n = strlen(path)) == 0) continue;
+      if (strcmp(path, "/") == 0) is_listed = SB_FALSE;
+      else is_listed = StringMaps.put(modified, path, modified);
+      has_modified_dirs |= path[n - 1] == '/';
+   }
+   free(answer);
+   return is_listed;
+}
+/* Check whether fsmonitor listed a path, or a directory holding it */
+static int git_is_modified(const char *key) {
+   if (StringMaps.get(modified, key)) return SB_TRUE;
+   char dir[4096];
+   for (const char *slash = key; has_modified_dirs && (slash = strchr(slash, '/')); slash++) {
+      snprintf(dir, sizeof(dir), "%.*s", (int)(slash - key + 1), key);
+      if (StringMaps.get(modified, dir)) return SB_TRUE;
+   }
+   return SB_FALSE;
+}
+/* Read the last build's snapshot */
+static void git_load_snapshot(void) {
+   FILE *file = fopen(snapshot_path, "r");
+   if (!file) return;
+
+   char *line = NULL;
+   size_t cap = 0;
+   ssize_t n = getline(&line, &cap, file);
+   int is_current = n > 0 && strncmp(line, GIT_SNAPSHOT_HEADER, strlen(GIT_SNAPSHOT_HEADER)) == 0;
+   while (is_current && (n = getline(&line, &cap, file)) > 0) {
+      if (line[n - 1] == '\n') line[n - 1] = '\0';
+      char *fields[4], *rest = line;
+      int count = 0;
+      while (count < 4 && rest) fields[count++] = strsep(&rest, "\t");
+      git_record_s *record = count == 4 ? malloc(sizeof(git_record_s)) : NULL;
+      if (!record) continue;
+      record->hash = strtoull(fields[1], NULL, 16);
+      record->mtime_ns = strtoll(fields[2], NULL, 10);
+      record->size = strtoll(fields[3], NULL, 10);
+      free(StringMaps.get(snapshot, fields[0]));
+      if (!StringMaps.put(snapshot, fields[0], record)) free(record);
+   }
+   free(line);
+   fclose(file);
+}
+/* Find a path's index entry */
+static const git_entry_s *git_find(const char *path) {
+   int low = 0, high = entry_count - 1;
+   while (low <= high) {
+      int mid = low + (high - low) / 2;
+      int cmp = strcmp(entries[mid].path, path);
+      if (cmp == 0) return &entries[mid];
+      if (cmp < 0) low = mid + 1;
+      else high = mid - 1;
+   }
+   return NULL;
+}
+/* Spell a path relative to the repository top, resolving `.` and `dir/..` lexically; returns 0 for paths outside it */
+static int git_top_path(const char *path, char *key, size_t len) {
+   size_t top_len = strlen(top);
+   char joined[4096];
+   const char *base = prefix;
+   if (*path == '/') {
+      if (strncmp(path, top, top_len) != 0 || path[top_len] != '/') return SB_FALSE;
+      path += top_len + 1;
+      base = "";
+   }
+   if (snprintf(joined, sizeof(joined), "%s%s", base, path) >= (int)sizeof(joined)) {
+      return SB_FALSE;
+   }
+
+   size_t out = 0;
+   for (char *component = joined, *next; component; component = next) {
+      next = strchr(component, '/');
+      if (next) *next++ = '\0';
+      if (!*component || strcmp(component, ".") == 0) continue;
+      if (strcmp(component, "..") == 0) {
+         // A tracked symlink is not a directory to step out of
+         if (out == 0 || git_find(key)) return SB_FALSE;
+         while (out > 0 && key[out - 1] != '/') out--;
+         if (out > 0) out--;
+         key[out] = '\0';
+         continue;
+      }
+      size_t component_len = strlen(component);
+      if (out + component_len + 2 > len) return SB_FALSE;
+      if (out > 0) key[out++] = '/';
+      memcpy(key + out, component, component_len + 1);
+      out += component_len;
+   }
+   key[out] = '\0';
+   return out > 0;
+}
+
+static void git_index_close(void);
+
+static int git_index_open(const char *dir) {
+   char index_path[4300], hook[4096];
+   if (mapped || !git_find_repository()) return mapped != NULL;
+
+   // Without fsmonitor, finding the files edited but not staged costs git an lstat per tracked file
+   git_config_get("core", "fsmonitor", hook, sizeof(hook));
+   int is_enabled = git_config_bool(hook);
+   if (is_enabled == 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Git index not used: no fsmonitor is configured (core.fsmonitor)\n");
+      return SB_FALSE;
+   }
+   is_daemon = is_enabled == 1;
+   char version[16];
+   git_config_get("core", "fsmonitorHookVersion", version, sizeof(version));
+   hook_version = !is_daemon && strcmp(version, "1") == 0 ? 1 : 2;
+
+   snprintf(index_path, sizeof(index_path), "%s/index", git_dir);
+   int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+      if (fd >= 0) close(fd);
+      return SB_FALSE;
+   }
+   void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) return SB_FALSE;
+   mapped = data;
+   mapped_size = st.st_size;
+
+   const char *base = dir && *dir ? dir : ".";
+   size_t len = strlen(base) + strlen(GIT_INDEX_SNAPSHOT) + 2;
+   int64_t index_mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+   int is_read = git_read_entries(git_hash_size(), index_mtime_ns);
+   if (is_read && (fsmonitor_version == 0 || !*fsmonitor_token)) {
+      // git writes the token with the index once it used fsmonitor (e.g. in `git status`)
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Git index not used: no fsmonitor token in %s\n", index_path);
+      git_index_close();
+      return SB_FALSE;
+   }
+   if (!is_read || !git_start_query(hook) || !(snapshot = StringMaps.create()) || !(snapshot_path = malloc(len))) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Git index not used: %s\n", index_path);
+      git_index_close();
+      return SB_FALSE;
+   }
+   snprintf(snapshot_path, len, "%s%s%s", base, base[strlen(base) - 1] == '/' ? "" : "/", GIT_INDEX_SNAPSHOT);
+   git_load_snapshot();
+   return SB_TRUE;
+}
+
+static int git_index_lookup(const char *path, file_stat_s *st) {
+   char key[4096];
+   if (query_fd >= 0 && !(is_usable = git_finish_query())) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "fsmonitor gave no answer: the git index is not used\n");
+   }
+   const git_entry_s *entry = is_usable && path && git_top_path(path, key, sizeof(key)) ? git_find(key) : NULL;
+   if (!entry || !entry->is_trusted) return SB_FALSE;
+
+   git_record_s *record = StringMaps.get(snapshot, key);
+   int is_unchanged = record && record->hash == entry->hash && !git_is_modified(key);
+   if (is_unchanged) {
+      st->mtime_ns = record->mtime_ns;
+      st->size = record->size;
+      reused++;
+   } else if (!record) {
+      if (!(record = calloc(1, sizeof(git_record_s))) || !StringMaps.put(snapshot, key, record)) {
+         free(record);
+         return SB_FALSE;
+      }
+   }
+
+   // The snapshot takes the metadata the build holds for the file when it ends
+   if (use_count == use_cap) {
+      int cap = use_cap ? use_cap * 2 : 256;
+      git_use_s *grown = realloc(uses, cap * sizeof(git_use_s));
+      if (!grown) return is_unchanged;
+      uses = grown;
+      use_cap = cap;
+   }
+   char *copy = strdup(path);
+   if (copy) uses[use_count++] = (git_use_s){.path = copy, .record = record, .entry = entry};
+   return is_unchanged;
+}
+
+/* Map visitor: write one snapshot line for a record still matching the index */
+static void git_write_record(const char *path, object value, object data) {
+   git_record_s *record = value;
+   const git_entry_s *entry = git_find(path);
+   if (entry && entry->is_trusted && entry->hash == record->hash) {
+      fprintf(data, "%s\t%016llx\t%lld\t%lld\n", path, (unsigned long long)record->hash, (long long)record->mtime_ns,
+              (long long)record->size);
+   }
+}
+/* Map visitor: free a snapshot record */
+static void git_free_record(const char *path, object value, object data) {
+   free(value);
+}
+/* Rewrite the snapshot if any record changed (through a temp file, so concurrent builds never read half of it) */
+static void git_save_snapshot(void) {
+   int is_changed = SB_FALSE;
+   for (int i = 0; i < use_count; i++) {
+      file_stat_s st;
+      FileStats.get(uses[i].path, &st);
+      git_record_s *record = uses[i].record;
+      is_changed |= record->hash != uses[i].entry->hash || record->mtime_ns != st.mtime_ns || record->size != st.size;
+      record->hash = uses[i].entry->hash;
+      record->mtime_ns = st.mtime_ns;
+      record->size = st.size;
+   }
+   if (!is_changed) return;
+
+   char tmp_path[4200];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", snapshot_path, (int)getpid());
+   FILE *file = fopen(tmp_path, "w");
+   if (!file) return;
+   fprintf(file, "%s\n", GIT_SNAPSHOT_HEADER);
+   StringMaps.each(snapshot, git_write_record, file);
+   if (fclose(file) != 0 || rename(tmp_path, snapshot_path) != 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Failed to write git snapshot: %s\n", snapshot_path);
+      unlink(tmp_path);
+   }
+}
+
+static void git_index_close(void) {
+   if (query_fd >= 0) git_finish_query();
+   if (snapshot_path && use_count > 0) {
+      git_save_snapshot();
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Git index: %d tracked file(s) unchanged, %d rechecked\n",
+                   reused, use_count - reused);
+   }
+   for (int i = 0; i < use_count; i++) free(uses[i].path);
+   free(uses);
+   uses = NULL;
+   use_count = use_cap = reused = 0;
+   StringMaps.each(snapshot, git_free_record, NULL);
+   StringMaps.dispose(snapshot);
+   snapshot = NULL;
+   StringMaps.dispose(modified);
+   modified = NULL;
+   has_modified_dirs = is_daemon = is_usable = 0;
+   fsmonitor_version = 0;
+   free(snapshot_path);
+   snapshot_path = NULL;
+
+   for (int i = 0; is_v4 && i < entry_count; i++) free((char *)entries[i].path);
+   free(entries);
+   entries = NULL;
+   entry_count = 0;
+   is_v4 = 0;
+   if (mapped) munmap(mapped, mapped_size);
+   mapped = NULL;
+   mapped_size = 0;
+}
+
+const IGitIndex GitIndex = {
+    .open = git_index_open,
+    .lookup = git_index_lookup,
+    .close = git_index_close,
+};
@@ -0,0 +1,51 @@
+/* src/core/git_index.h
+ * Sigma.Build Git Index
+ * Tells which tracked inputs changed since the last build from the git index.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for change detection through the git index of the
+ * workspace's repository. The index records what git last saw of every tracked file; a
+ * snapshot of those records, with the metadata the build read for each file, is kept in the
+ * build directory. A tracked input whose index record is unchanged since the snapshot, and
+ * which fsmonitor does not report modified in the worktree, keeps the snapshot's metadata
+ * without being stat'ed; every other path is stat'ed as usual. Without fsmonitor configured
+ * (core.fsmonitor), the index is not used.
+ */
+#ifndef GIT_INDEX_H
+#define GIT_INDEX_H
+
+#include "sbuild.h"
+#include "file_stats.h"
+
+#define GIT_INDEX_SNAPSHOT ".sbuild_git" // Snapshot file name inside the build directory
+
+/**
+ * @brief IGitIndex interface.
+ * @details Provides an interface for reading the git index and the last build's snapshot of it.
+ */
+typedef struct IGitIndex {
+   /**
+    * @brief Reads the index of the repository holding the working directory and the snapshot, and
+    *        asks fsmonitor for the files modified since the index was written (collected by the first lookup).
+    * @param dir :the build directory holding the snapshot
+    * @return :1 if the index can be used; otherwise, 0 (no repository, no fsmonitor, or an index format not read here)
+    */
+   int (*open)(const char *);
+   /**
+    * @brief Gets a tracked file's metadata from the snapshot if git saw no change to it since.
+    * @param path :the file path, as the build spells it
+    * @param st :receives the metadata recorded by the last build
+    * @return :1 if the file is unchanged since the snapshot; otherwise, 0 (stat it)
+    */
+   int (*lookup)(const char *, file_stat_s *);
+   /**
+    * @brief Writes the snapshot with the metadata the build now holds for the looked-up files, and closes the index.
+    */
+   void (*close)(void);
+} IGitIndex;
+
+extern const IGitIndex GitIndex;
+
+#endif // GIT_INDEX_H
@@ -0,0 +1,489 @@
+/* src/core/include_scanner.c
+ * Sigma.Build Include Scanner
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * A file is parsed into the list of its `#include` directives by a small state machine that
+ * skips comments and string literals; parses are memoized by content hash, and each path keeps
+ * the metadata it was read with, so a later batch reads only files whose mtime or size moved.
+ * Resolutions are memoized per search path, includer directory and name for one batch.
+ *
+ * Each unit walks its includes depth-first with its own visited set, so a header is entered once
+ * per unit: include guards and `#pragma once` need no evaluation, as every header is listed at
+ * its first inclusion whatever guards its later ones. Threads claim units from a shared counter;
+ * the memo maps are shared under one lock, files are read and parsed outside it.
+ */
+#define _GNU_SOURCE
+#include "include_scanner.h"
+#include "string_map.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct scan_include_s {
+   char *name;   // Name between the quotes or brackets
+   int is_angle; // Set for `<name>`
+} scan_include_s;
+
+typedef struct scan_parse_s {
+   scan_include_s *includes; // Directives in file order
+   int count;                // Number of directives
+   int is_computed;          // Set if an `#include` names a macro
+} scan_parse_s;
+
+typedef struct scan_file_s {
+   int64_t mtime_ns;    // Modification time the file was read with
+   int64_t size;        // Size the file was read with
+   uint64_t epoch;      // Batch that last checked the metadata
+   scan_parse_s *parse; // Directives (NULL if unreadable)
+} scan_file_s;
+
+typedef struct scan_dir_s {
+   const char *path; // Directory as the arguments spell it
+   size_t len;       // Length without trailing slashes
+} scan_dir_s;
+
+typedef struct scan_search_s {
+   scan_dir_s *quote;   // `-iquote` dirs, searched for `"name"` only
+   int quote_count;     // Number of quote dirs
+   scan_dir_s *dirs;    // `-I` dirs
+   int dir_count;       // Number of `-I` dirs
+   char **forced;       // `-include` files
+   int forced_count;    // Number of forced includes
+   uint64_t id;         // Hash of the dirs (resolution memo key)
+} scan_search_s;
+
+typedef struct scan_walk_s {
+   StringMap visited;    // Files entered by the unit
+   const char **stack;   // Files left to parse
+   int stack_count, stack_cap;
+   const char **headers; // Headers found, in discovery order
+   int header_count, header_cap;
+} scan_walk_s;
+
+typedef struct scan_batch_s {
+   scan_unit_s *units; // Units to scan
+   int count;          // Number of units
+   int next;           // Next unit to claim (shared by the threads)
+   int known;          // Units whose headers were found
+} scan_batch_s;
+
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+static StringMap files = NULL;    // Path -> scan_file_s
+static StringMap parses = NULL;   // Content hash -> scan_parse_s
+static StringMap resolved = NULL; // Search id + includer dir + name -> path (not_found if none)
+static uint64_t epoch = 0;        // Current batch
+static char not_found[] = "";     // Resolution of names found nowhere outside system dirs
+
+#define SOURCE ((object)1) // Walk marker of a unit's source
+#define HEADER ((object)2) // Walk marker of a header
+
+/* FNV-1a over a block of bytes */
+static uint64_t scan_hash_bytes(const void *data, size_t size, uint64_t hash) {
+   const unsigned char *bytes = data;
+   for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+   return hash;
+}
+/* Skip a comment at p (returns p if none starts there) */
+static const char *scan_skip_comment(const char *p, const char *end) {
+   if (p + 1 >= end || p[0] != '/') return p;
+   if (p[1] == '/') {
+      while (p < end && *p != '\n') p++;
+   } else if (p[1] == '*') {
+      for (p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++);
+      p = p + 1 < end ? p + 2 : end;
+   }
+   return p;
+}
+/* Skip spaces, continued lines and comments within a line (a line comment runs to the end of it) */
+static const char *scan_skip_blank(const char *p, const char *end) {
+   for (;;) {
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' || *p == '\v')) p++;
+      if (p + 1 < end && p[0] == '\\' && p[1] == '\n') {
+         p += 2;
+      } else if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+         p = scan_skip_comment(p, end);
+      } else {
+         return scan_skip_comment(p, end);
+      }
+   }
+}
+/* Add a directive to a parse */
+static int scan_add_include(scan_parse_s *parse, const char *name, size_t len, int is_angle, int *cap) {
+   if (parse->count == *cap) {
+      int grown_cap = *cap ? *cap * 2 : 8;
+      scan_include_s *grown = realloc(parse->includes, grown_cap * sizeof(scan_include_s));
+      if (!grown) return SB_FALSE;
+      parse->includes = grown;
+      *cap = grown_cap;
+   }
+   if (!(parse->includes[parse->count].name = strndup(name, len))) return SB_FALSE;
+   parse->includes[parse->count++].is_angle = is_angle;
+   return SB_TRUE;
+}
+/* Free a parse */
+static void scan_free_parse(scan_parse_s *parse) {
+   for (int i = 0; parse && i < parse->count; i++) free(parse->includes[i].name);
+   if (parse) free(parse->includes);
+   free(parse);
+}
+/* Parse the include directives of a file's contents (NULL if out of memory) */
+static scan_parse_s *scan_parse(const char *text, size_t size) {
+   scan_parse_s *parse = calloc(1, sizeof(scan_parse_s));
+   const char *p = text, *end = text + size;
+   int cap = 0, is_line_start = 1;
+   while (parse && p < end) {
+      char c = *p;
+      if (c == '\n') {
+         is_line_start = 1;
+         p++;
+      } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+         p++;
+      } else if (c == '\\' && p + 1 < end && p[1] == '\n') {
+         p += 2; // Continued line
+      } else if (c == '/' && scan_skip_comment(p, end) != p) {
+         p = scan_skip_comment(p, end);
+      } else if (c == '#' && is_line_start) {
+         // Directive: only the include family matters, the rest of the line is skipped
+         p = scan_skip_blank(p + 1, end);
+         const char *word = p;
+         while (p < end && (*p == '_' || (*p >= 'a' && *p <= 'z'))) p++;
+         size_t word_len = p - word;
+         if ((word_len == 7 && strncmp(word, "include", 7) == 0) || (word_len == 12 && strncmp(word, "include_next", 12) == 0) ||
+             (word_len == 6 && strncmp(word, "import", 6) == 0)) {
+            p = scan_skip_blank(p, end);
+            char close = p < end && *p == '"' ? '"' : p < end && *p == '<' ? '>' : 0;
+            const char *name = p + 1, *stop = name;
+            while (close && stop < end && *stop != close && *stop != '\n') stop++;
+            if (close && stop < end && *stop == close && stop > name) {
+               if (!scan_add_include(parse, name, stop - name, close == '>', &cap)) {
+                  scan_free_parse(parse);
+                  return NULL;
+               }
+            } else if (p < end && *p != '\n') {
+               parse->is_computed = 1; // `#include MACRO`: the name is only known to the preprocessor
+            }
+         }
+         while (p < end && *p != '\n') p += p[0] == '\\' && p + 1 < end ? 2 : 1;
+      } else if (c == '"' || c == '\'') {
+         // Literal: skip to its closing quote so its contents are not read as code
+         for (p++; p < end && *p != c && *p != '\n'; p++) {
+            if (*p == '\\' && p + 1 < end) p++;
+         }
+         if (p < end && *p == c) p++;
+         is_line_start = 0;
+      } else {
+         is_line_start = 0;
+         p++;
+      }
+   }
+   return parse;
+}
+/* Read and parse a file, or take its memoized parse when its metadata (else its contents) is unchanged */
+static scan_parse_s *scan_load(const char *path) {
+   scan_parse_s *parse = NULL;
+   pthread_mutex_lock(&memo_lock);
+   scan_file_s *file = StringMaps.get(files, path);
+   int is_checked = file && file->epoch == epoch;
+   if (is_checked) parse = file->parse;
+   pthread_mutex_unlock(&memo_lock);
+   if (is_checked) return parse;
+
+   struct stat st;
+   int64_t mtime_ns = -1, size = 0;
+   if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+      mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+      size = (int64_t)st.st_size;
+   }
+   pthread_mutex_lock(&memo_lock);
+   file = StringMaps.get(files, path);
+   int is_same = file && file->mtime_ns == mtime_ns && file->size == size;
+   if (is_same) {
+      file->epoch = epoch;
+      parse = file->parse;
+   }
+   pthread_mutex_unlock(&memo_lock);
+   if (is_same) return parse;
+
+   // Read it; a parse of the same contents is reused
+   char *text = NULL, key[40];
+   int fd = mtime_ns >= 0 ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+   size_t len = 0;
+   if (fd >= 0 && (text = malloc(size + 1))) {
+      for (ssize_t n; len < (size_t)size && (n = read(fd, text + len, size - len)) > 0;) len += n;
+   }
+   if (fd >= 0) close(fd);
+   if (text) {
+      snprintf(key, sizeof(key), "%016llx:%zu", (unsigned long long)scan_hash_bytes(text, len, 14695981039346656037ULL), len);
+      pthread_mutex_lock(&memo_lock);
+      parse = StringMaps.get(parses, key);
+      pthread_mutex_unlock(&memo_lock);
+      if (!parse && (parse = scan_parse(text, len))) {
+         pthread_mutex_lock(&memo_lock);
+         scan_parse_s *raced = StringMaps.get(parses, key);
+         if (raced || !StringMaps.put(parses, key, parse)) {
+            scan_free_parse(parse);
+            parse = raced;
+         }
+         pthread_mutex_unlock(&memo_lock);
+      }
+      free(text);
+   }
+
+   pthread_mutex_lock(&memo_lock);
+   if (!(file = StringMaps.get(files, path)) && (file = calloc(1, sizeof(scan_file_s))) && !StringMaps.put(files, path, file)) {
+      free(file);
+      file = NULL;
+   }
+   if (file) {
+      file->mtime_ns = mtime_ns;
+      file->size = size;
+      file->epoch = epoch;
+      file->parse = parse;
+   }
+   pthread_mutex_unlock(&memo_lock);
+   return parse;
+}
+/* Test a candidate `dir/name` (no dir: name alone); returns 1 with it in `path` if it is a file */
+static int scan_try(const char *dir, size_t dir_len, const char *name, char *path, size_t path_len) {
+   int len = !dir_len                    ? snprintf(path, path_len, "%s", name)
+             : dir_len == 1 && *dir == '/' ? snprintf(path, path_len, "/%s", name)
+                                           : snprintf(path, path_len, "%.*s/%s", (int)dir_len, dir, name);
+   struct stat st;
+   return len > 0 && (size_t)len < path_len && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+/* Resolve an include the way the compiler searches: the includer's directory (`"name"` only; the working
+ * directory for `-include`), the `-iquote` dirs (`"name"` only), then the `-I` dirs. Sets `path` to the file
+ * as the compiler spells it, or NULL if the name is found only in system dirs or nowhere; returns 0 if out
+ * of memory. */
+static int scan_resolve(const scan_search_s *search, const char *includer, const scan_include_s *include, const char **path) {
+   const char *slash = includer ? strrchr(includer, '/') : NULL;
+   size_t includer_len = slash == includer && slash ? 1 : slash ? (size_t)(slash - includer) : 0; // `/` for a file in it
+   // Key: search path, kind, the includer's directory (not searched for `<name>`) and the name
+   char buffer[4096], *key = buffer;
+   char kind = include->is_angle ? 'a' : includer ? 'q' : 'f';
+   int dir_len = include->is_angle ? 0 : (int)includer_len;
+   int key_len = snprintf(buffer, sizeof(buffer), "%016llx\t%c\t%.*s\t%s", (unsigned long long)search->id, kind, dir_len,
+                          includer ? includer : "", include->name);
+   if (key_len < 0 || ((size_t)key_len >= sizeof(buffer) && !(key = malloc(key_len + 1)))) return SB_FALSE;
+   if (key != buffer) {
+      snprintf(key, key_len + 1, "%016llx\t%c\t%.*s\t%s", (unsigned long long)search->id, kind, dir_len,
+               includer ? includer : "", include->name);
+   }
+   pthread_mutex_lock(&memo_lock);
+   char *memo = StringMaps.get(resolved, key);
+   pthread_mutex_unlock(&memo_lock);
+
+   char candidate[4096];
+   int is_found = 0;
+   if (memo) {
+      // Resolved earlier in the batch
+   } else if (include->name[0] == '/') {
+      is_found = scan_try(NULL, 0, include->name, candidate, sizeof(candidate));
+   } else {
+      if (!include->is_angle) is_found = scan_try(includer, includer_len, include->name, candidate, sizeof(candidate));
+      for (int i = 0; !is_found && !include->is_angle && i < search->quote_count; i++) {
+         is_found = scan_try(search->quote[i].path, search->quote[i].len, include->name, candidate, sizeof(candidate));
+      }
+      for (int i = 0; !is_found && i < search->dir_count; i++) {
+         is_found = scan_try(search->dirs[i].path, search->dirs[i].len, include->name, candidate, sizeof(candidate));
+      }
+   }
+   if (!memo) {
+      char *result = is_found ? strdup(candidate) : not_found;
+      pthread_mutex_lock(&memo_lock);
+      if (!result || (memo = StringMaps.get(resolved, key))) {
+         if (result != not_found) free(result); // Another thread resolved it meanwhile
+      } else if (StringMaps.put(resolved, key, result)) {
+         memo = result;
+      } else if (result != not_found) {
+         free(result);
+      }
+      pthread_mutex_unlock(&memo_lock);
+   }
+   if (key != buffer) free(key);
+   *path = memo == not_found ? NULL : memo;
+   return memo != NULL;
+}
+/* Append a directory argument to a search list */
+static int scan_add_dir(scan_dir_s **list, int *count, const char *path) {
+   scan_dir_s *grown = realloc(*list, (*count + 1) * sizeof(scan_dir_s));
+   if (!grown) return SB_FALSE;
+   size_t len = strlen(path);
+   while (len > 1 && path[len - 1] == '/') len--;
+   grown[*count].path = path;
+   grown[(*count)++].len = len;
+   *list = grown;
+   return SB_TRUE;
+}
+/* Read the search path from compile arguments */
+static int scan_read_args(char **args, scan_search_s *search) {
+   uint64_t id = 14695981039346656037ULL;
+   for (char **arg = args; arg && *arg; arg++) {
+      char kind = 0;
+      const char *value = NULL;
+      if (strncmp(*arg, "-I", 2) == 0) {
+         kind = 'I';
+         value = (*arg)[2] ? *arg + 2 : *++arg;
+      } else if (strcmp(*arg, "-iquote") == 0) {
+         kind = 'q';
+         value = *++arg;
+      } else if (strcmp(*arg, "-include") == 0) {
+         kind = 'f';
+         value = *++arg;
+      } else if (strcmp(*arg, "-isystem") == 0 || strcmp(*arg, "-idirafter") == 0) {
+         if (!*++arg) break; // System dirs are not followed
+         continue;
+      }
+      if (!kind) continue;
+      if (!value) break;
+
+      if (kind == 'f') {
+         char **grown = realloc(search->forced, (search->forced_count + 1) * sizeof(char *));
+         if (!grown) return SB_FALSE;
+         search->forced = grown;
+         search->forced[search->forced_count++] = (char *)value;
+      } else if (!(kind == 'q' ? scan_add_dir(&search->quote, &search->quote_count, value)
+                               : scan_add_dir(&search->dirs, &search->dir_count, value))) {
+         return SB_FALSE;
+      }
+      id = scan_hash_bytes(&kind, 1, id);
+      id = scan_hash_bytes(value, strlen(value) + 1, id);
+   }
+   search->id = id;
+   return SB_TRUE;
+}
+/* Push a file on a unit's walk unless the unit entered it already; headers are also listed */
+static int scan_push(scan_walk_s *walk, const char *path, object marker) {
+   if (StringMaps.get(walk->visited, path)) return SB_TRUE;
+   if (!StringMaps.put(walk->visited, path, marker)) return SB_FALSE;
+   if (walk->stack_count == walk->stack_cap) {
+      int cap = walk->stack_cap ? walk->stack_cap * 2 : 32;
+      const char **grown = realloc(walk->stack, cap * sizeof(char *));
+      if (!grown) return SB_FALSE;
+      walk->stack = grown;
+      walk->stack_cap = cap;
+   }
+   walk->stack[walk->stack_count++] = path;
+   if (marker != HEADER) return SB_TRUE;
+   if (walk->header_count == walk->header_cap) {
+      int cap = walk->header_cap ? walk->header_cap * 2 : 32;
+      const char **grown = realloc(walk->headers, cap * sizeof(char *));
+      if (!grown) return SB_FALSE;
+      walk->headers = grown;
+      walk->header_cap = cap;
+   }
+   walk->headers[walk->header_count++] = path;
+   return SB_TRUE;
+}
+/* Find the headers of one unit; returns 0 if they cannot be known */
+static int scan_unit(scan_unit_s *unit) {
+   scan_search_s search = {0};
+   scan_walk_s walk = {.visited = StringMaps.create()};
+   int is_known = walk.visited && scan_read_args(unit->args, &search);
+   for (char **source = unit->sources; is_known && *source; source++) is_known = scan_push(&walk, *source, SOURCE);
+   // `-include` files are searched from the working directory
+   for (int i = 0; is_known && i < search.forced_count; i++) {
+      scan_include_s forced = {.name = search.forced[i]};
+      const char *path;
+      is_known = scan_resolve(&search, NULL, &forced, &path) && (!path || scan_push(&walk, path, HEADER));
+   }
+
+   while (is_known && walk.stack_count > 0) {
+      const char *path = walk.stack[--walk.stack_count];
+      scan_parse_s *parse = scan_load(path);
+      if (!parse) {
+         // An unreadable source leaves the unit to the compiler; a header that vanished is left out
+         is_known = StringMaps.get(walk.visited, path) == HEADER;
+         continue;
+      }
+      is_known = !parse->is_computed;
+      for (int i = parse->count - 1; is_known && i >= 0; i--) {
+         const char *header;
+         is_known = scan_resolve(&search, path, &parse->includes[i], &header) && (!header || scan_push(&walk, header, HEADER));
+      }
+   }
+
+   // Copy the headers out into one block: the pointer array, then the strings
+   size_t size = (walk.header_count + 1) * sizeof(char *);
+   for (int i = 0; i < walk.header_count; i++) size += strlen(walk.headers[i]) + 1;
+   char **headers = is_known ? malloc(size) : NULL;
+   if (headers) {
+      char *next = (char *)(headers + walk.header_count + 1);
+      for (int i = 0; i < walk.header_count; i++) {
+         headers[i] = strcpy(next, walk.headers[i]);
+         next += strlen(next) + 1;
+      }
+      headers[walk.header_count] = NULL;
+   }
+   unit->headers = headers;
+   StringMaps.dispose(walk.visited);
+   free(walk.stack);
+   free(walk.headers);
+   free(search.quote);
+   free(search.dirs);
+   free(search.forced);
+   return headers != NULL;
+}
+/* Batch thread: scan units until none are left to claim */
+static void *scan_worker(void *data) {
+   scan_batch_s *batch = data;
+   for (int i; (i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count;) {
+      if (scan_unit(&batch->units[i])) __atomic_fetch_add(&batch->known, 1, __ATOMIC_RELAXED);
+   }
+   return NULL;
+}
+/* Map visitor: free a resolved path */
+static void scan_free_resolved(const char *key, object value, object data) {
+   if (value != not_found) free(value);
+}
+
+static int scan_scan(scan_unit_s *units, int count) {
+   if (count <= 0) return 0;
+   if ((!files && !(files = StringMaps.create())) || (!parses && !(parses = StringMaps.create()))) return 0;
+   // Resolutions hold for one batch: headers may have been added or removed since the last
+   StringMaps.each(resolved, scan_free_resolved, NULL);
+   StringMaps.dispose(resolved);
+   if (!(resolved = StringMaps.create())) return 0;
+   epoch++;
+
+   scan_batch_s batch = {.units = units, .count = count};
+   pthread_t threads[INCLUDE_SCANNER_THREADS];
+   int thread_count = count < INCLUDE_SCANNER_THREADS ? count : INCLUDE_SCANNER_THREADS;
+   int started = 0;
+   for (; started < thread_count - 1; started++) {
+      if (pthread_create(&threads[started], NULL, scan_worker, &batch) != 0) break;
+   }
+   scan_worker(&batch); // The calling thread takes a share too
+   for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+   return batch.known;
+}
+
+/* Map visitor: free a file entry */
+static void scan_free_file(const char *path, object value, object data) {
+   free(value);
+}
+/* Map visitor: free a parse */
+static void scan_free_parse_entry(const char *key, object value, object data) {
+   scan_free_parse(value);
+}
+static void scan_reset(void) {
+   StringMaps.each(files, scan_free_file, NULL);
+   StringMaps.dispose(files);
+   StringMaps.each(parses, scan_free_parse_entry, NULL);
+   StringMaps.dispose(parses);
+   StringMaps.each(resolved, scan_free_resolved, NULL);
+   StringMaps.dispose(resolved);
+   files = parses = resolved = NULL;
+}
+
+const IIncludeScanner IncludeScanner = {
+    .scan = scan_scan,
+    .reset = scan_reset,
+};
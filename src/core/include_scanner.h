@@ -0,0 +1,49 @@
+/* src/core/include_scanner.h
+ * Sigma.Build Include Scanner
+ * Finds the headers a compile reads without running the preprocessor.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for scanning `#include` directives. A unit's sources are
+ * followed through their includes along the search path its compile arguments give (`-iquote`,
+ * `-I`, `-isystem`, `-include`), the way the compiler would resolve them; headers found in
+ * system directories, or not found at all, are left out, as `-MMD` depfiles leave them out.
+ * Conditionals are not evaluated, so the set may hold headers the compiler skips - never fewer.
+ * Units are scanned in parallel; each file is read and parsed once, and a parse is reused by
+ * every file with the same contents.
+ */
+#ifndef INCLUDE_SCANNER_H
+#define INCLUDE_SCANNER_H
+
+#include "sbuild.h"
+
+#define INCLUDE_SCANNER_THREADS 8 // Threads scanning a batch of units
+
+typedef struct scan_unit_s {
+   char **sources;  // Files compiled together (a unity compile lists its members; NULL-terminated)
+   char **args;     // Compile arguments holding the search path (NULL-terminated)
+   char **headers;  // Receives the headers read, NULL-terminated in one block to free() (NULL if unknown)
+} scan_unit_s;
+
+/**
+ * @brief IIncludeScanner interface.
+ * @details Provides an interface for scanning the headers of compile units.
+ */
+typedef struct IIncludeScanner {
+   /**
+    * @brief Scans a batch of units in parallel; files changed since an earlier batch are read again.
+    * @param units :the units; each receives its headers
+    * @param count :number of units
+    * @return :number of units whose headers are known (a computed `#include MACRO` leaves a unit unknown)
+    */
+   int (*scan)(scan_unit_s *, int);
+   /**
+    * @brief Forgets every file read.
+    */
+   void (*reset)(void);
+} IIncludeScanner;
+
+extern const IIncludeScanner IncludeScanner;
+
+#endif // INCLUDE_SCANNER_H
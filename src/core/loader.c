@@ -14,7 +14,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define CONFIG_LOADER_VERSION "0.00.02.002"
+#define CONFIG_LOADER_VERSION "0.00.02.004"
 
 static const char *loader_get_version(void) {
    return CONFIG_LOADER_VERSION; // Return the version of the JSON parser
@@ -25,6 +25,9 @@ static char **load_string_array(cJSON *array);
 static BuildTarget load_target(cJSON *target_json);
 static char **load_platform_commands(cJSON *);
 static char *resolve_vars(const char *);
+static long load_timeout_ms(cJSON *, const char *);
+static void load_variant_vars(cJSON *, cJSON *);
+static int apply_variant(BuildTarget, cJSON *);
 static void loader_cleanup(void);
 
 /* Load configuration for Build */
@@ -67,10 +70,17 @@ static int loader_load_config(const char *filename, BuildConfig *config) {
    }
    (*config)->default_target =
        cJSON_IsString(default_target) ? strdup(default_target->valuestring) : NULL;
-   // Load targets
+   cJSON *build_dir = cJSON_GetObjectItemCaseSensitive(json, CONFIG_FIELD_BUILD_DIR);
+   (*config)->build_dir = cJSON_IsString(build_dir) ? resolve_vars(build_dir->valuestring) : NULL;
+   (*config)->action_timeout_ms = load_timeout_ms(json, CONFIG_FIELD_ACTION_TIMEOUT);
+   // Load targets: once per variant when the config has variants, each specialized for its variant
+   cJSON *variants = cJSON_GetObjectItemCaseSensitive(json, CONFIG_FIELD_VARIANTS);
+   int variant_count = cJSON_IsObject(variants) ? cJSON_GetArraySize(variants) : 0;
    int target_count = cJSON_IsArray(targets) ? cJSON_GetArraySize(targets) : 0;
-   addr targets_addr;
-   if (!Resources.alloc(&targets_addr, (target_count + 1) * sizeof(BuildTarget))) {
+   int total_count = target_count * (variant_count > 0 ? variant_count : 1);
+   addr targets_addr, variants_addr;
+   if (!Resources.alloc(&targets_addr, (total_count + 1) * sizeof(BuildTarget)) ||
+       !Resources.alloc(&variants_addr, (variant_count + 1) * sizeof(char *))) {
       Logger.debug(stderr, LOG_NORMAL, DBG_ERROR,
                    "Failed to allocate memory for targets array.\n");
       cJSON_Delete(json);
@@ -78,28 +88,51 @@ static int loader_load_config(const char *filename, BuildConfig *config) {
       goto loadExit;
    }
    (*config)->targets = (BuildTarget *)targets_addr;
+   (*config)->variants = variant_count > 0 ? (char **)variants_addr : NULL;
+   if (variant_count == 0) free((char **)variants_addr);
+
+   int loaded = 0;
+   for (int v = 0; v < (variant_count > 0 ? variant_count : 1); v++) {
+      cJSON *variant = variant_count > 0 ? cJSON_GetArrayItem(variants, v) : NULL;
+      if (variant) {
+         (*config)->variants[v] = strdup(variant->string);
+         load_variant_vars(variables, variant);
+      }
+      for (int i = 0; i < target_count; i++) {
+         cJSON *target_json = cJSON_GetArrayItem(targets, i);
+         BuildTarget target = load_target(target_json);
+         if (target && variant && !apply_variant(target, variant)) {
+            Resources.dispose_target(target);
+            target = NULL;
+         }
+         if (target) {
+            (*config)->targets[loaded++] = target;
+            continue;
+         }
 
-   for (int i = 0; i < target_count; i++) {
-      cJSON *target_json = cJSON_GetArrayItem(targets, i);
-      (*config)->targets[i] = load_target(target_json);
-      if (!(*config)->targets[i]) {
-         for (int j = 0; j < i; j++) {
+         for (int j = 0; j < loaded; j++) {
             Resources.dispose_target((*config)->targets[j]);
          }
          free((*config)->targets);
          free((*config)->name);
          free((*config)->log_file);
+         free((*config)->build_dir);
          for (char **var = (*config)->variables; var && *var; var++)
             free(*var);
          free((*config)->variables);
+         for (char **name = (*config)->variants; name && *name; name++)
+            free(*name);
+         free((*config)->variants);
          free((*config));
+         *config = NULL;
          cJSON_Delete(json);
          VarTable.dispose();
 
          goto loadExit;
       }
    }
-   (*config)->targets[target_count] = NULL;
+   (*config)->targets[loaded] = NULL;
+   if (variant_count > 0) VarTable.load(variables); // Back to the plain configuration variables
 
    cJSON_Delete(json);
    Logger.fwriteln(stdout, "Parsed config: %s", filename);
@@ -154,6 +187,16 @@ static BuildTarget load_target(cJSON *target_json) {
    target->type = strdup(type->valuestring);
    if (!target->name || !target->type) goto fail;
 
+   target->timeout_ms = load_timeout_ms(target_json, CONFIG_TARGET_TIMEOUT);
+   target->action_timeout_ms = load_timeout_ms(target_json, CONFIG_TARGET_ACTION_TIMEOUT);
+
+   // Dependencies are optional; any target type may depend on others
+   cJSON *dependencies = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_DEPENDENCIES);
+   if (dependencies) {
+      target->dependencies = load_string_array(dependencies);
+      if (!target->dependencies) goto fail;
+   }
+
    if (strcmp(target->type, TARGET_TYPE_OP) == 0) {
       cJSON *commands = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_COMMANDS);
       target->commands = load_platform_commands(commands);
@@ -185,6 +228,18 @@ static BuildTarget load_target(cJSON *target_json) {
    target->ld_flags = load_string_array(
        cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_LINKER_FLAGS));
 
+   cJSON *pch = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_PCH);
+   if (cJSON_IsString(pch) && !(target->pch = resolve_vars(pch->valuestring))) goto fail;
+
+   // Unity build (opt-in): sources are compiled in batches, except the excluded ones
+   cJSON *unity = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_UNITY);
+   if (cJSON_IsObject(unity)) {
+      cJSON *batch_size = cJSON_GetObjectItemCaseSensitive(unity, CONFIG_UNITY_BATCH_SIZE);
+      cJSON *exclude = cJSON_GetObjectItemCaseSensitive(unity, CONFIG_UNITY_EXCLUDE);
+      target->unity_batch_size = cJSON_IsNumber(batch_size) && batch_size->valueint > 0 ? batch_size->valueint : 0;
+      if (exclude && !(target->unity_exclude = load_string_array(exclude))) goto fail;
+   }
+
    cJSON *out_dir = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_OUTDIR);
    if (cJSON_IsString(out_dir)) {
       raw_out_dir = strdup(out_dir->valuestring);
@@ -204,6 +259,20 @@ static BuildTarget load_target(cJSON *target_json) {
    }
    if (!target->output) goto fail;
 
+   // Libraries: shared unless "kind" says static; static ones may be thin and name their archiver
+   if (strcmp(target->type, TARGET_TYPE_LIB) == 0) {
+      cJSON *kind = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_KIND);
+      cJSON *archiver = cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_ARCHIVER);
+      target->kind = strdup(cJSON_IsString(kind) ? kind->valuestring : TARGET_KIND_SHARED);
+      target->archiver = strdup(cJSON_IsString(archiver) ? archiver->valuestring : TARGET_ARCHIVER);
+      target->is_thin = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(target_json, CONFIG_TARGET_THIN));
+      if (!target->kind || !target->archiver) goto fail;
+      if (strcmp(target->kind, TARGET_KIND_STATIC) != 0 && strcmp(target->kind, TARGET_KIND_SHARED) != 0) {
+         Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Unknown library kind %s of target %s\n", target->kind, target->name);
+         goto fail;
+      }
+   }
+
    return target;
 
 fail:
@@ -214,6 +283,95 @@ fail:
 
    return NULL;
 }
+/* Load the configuration variables overlaid with a variant's own and `{VARIANT}` */
+static void load_variant_vars(cJSON *variables, cJSON *variant) {
+   cJSON *merged = cJSON_IsObject(variables) ? cJSON_Duplicate(variables, 1) : cJSON_CreateObject();
+   if (merged && !cJSON_GetObjectItemCaseSensitive(merged, VARIANT_VAR_NAME)) {
+      cJSON_AddStringToObject(merged, VARIANT_VAR_NAME, variant->string);
+   }
+   cJSON *overlay = cJSON_GetObjectItemCaseSensitive(variant, CONFIG_FIELD_VARIABLES);
+   cJSON *var;
+   cJSON_ArrayForEach(var, overlay) {
+      cJSON *copy = cJSON_Duplicate(var, 1);
+      if (!merged || !copy) {
+         cJSON_Delete(copy);
+         continue;
+      }
+      if (cJSON_GetObjectItemCaseSensitive(merged, var->string)) {
+         cJSON_ReplaceItemInObjectCaseSensitive(merged, var->string, copy);
+      } else {
+         cJSON_AddItemToObject(merged, var->string, copy);
+      }
+   }
+   VarTable.load(merged);
+   cJSON_Delete(merged);
+}
+/* Join `name`, the variant separator and `variant` */
+static char *variant_name(const char *name, const char *variant) {
+   char *joined = malloc(strlen(name) + strlen(variant) + 2);
+   if (joined) sprintf(joined, "%s" TARGET_VARIANT_SEPARATOR "%s", name, variant);
+
+   return joined;
+}
+/* Give each variant its own subdirectory: `<dir>/<variant>/` */
+static char *variant_dir(const char *dir, const char *variant) {
+   size_t len = dir ? strlen(dir) : 0;
+   char *joined = malloc(len + strlen(variant) + 3);
+   if (joined) sprintf(joined, "%s%s%s/", dir ? dir : "", len && dir[len - 1] != '/' ? "/" : "", variant);
+
+   return joined;
+}
+/* Append a variant's flags to a target's flag list; returns 0 if allocation fails */
+static int append_flags(char ***flags, cJSON *extra_json) {
+   char **extra = load_string_array(extra_json);
+   if (!extra) return !extra_json; // Nothing to append
+
+   int count = 0, extra_count = 0;
+   for (char **flag = *flags; flag && *flag; flag++) count++;
+   for (char **flag = extra; *flag; flag++) extra_count++;
+   char **grown = realloc(*flags, (count + extra_count + 1) * sizeof(char *));
+   if (!grown) {
+      for (char **flag = extra; *flag; flag++) free(*flag);
+      free(extra);
+      return SB_FALSE;
+   }
+   memcpy(grown + count, extra, (extra_count + 1) * sizeof(char *));
+   free(extra);
+   *flags = grown;
+
+   return SB_TRUE;
+}
+/* Specialize a target for a variant: qualified name and dependencies, variant flags, per-variant directories */
+static int apply_variant(BuildTarget target, cJSON *variant) {
+   const char *name = variant->string;
+   char *qualified = variant_name(target->name, name);
+   if (!qualified || !(target->variant = strdup(name))) {
+      free(qualified);
+      return SB_FALSE;
+   }
+   free(target->name);
+   target->name = qualified;
+   for (char **dependency = target->dependencies; dependency && *dependency; dependency++) {
+      if (!(qualified = variant_name(*dependency, name))) return SB_FALSE;
+      free(*dependency);
+      *dependency = qualified;
+   }
+   if (strcmp(target->type, TARGET_TYPE_OP) == 0) return SB_TRUE;
+
+   if (!append_flags(&target->c_flags, cJSON_GetObjectItemCaseSensitive(variant, CONFIG_TARGET_COMPILER_FLAGS)) ||
+       !append_flags(&target->ld_flags, cJSON_GetObjectItemCaseSensitive(variant, CONFIG_TARGET_LINKER_FLAGS))) {
+      return SB_FALSE;
+   }
+   // Objects and outputs of each variant live apart, so switching variants never rebuilds
+   char *build_dir = variant_dir(target->build_dir, name);
+   char *out_dir = variant_dir(target->out_dir, name);
+   if (target->out_dir != target->build_dir) free(target->out_dir);
+   free(target->build_dir);
+   target->build_dir = build_dir;
+   target->out_dir = out_dir;
+
+   return build_dir && out_dir;
+}
 /* Load platform commands*/
 static char **load_platform_commands(cJSON *commands) {
    if (!commands || !cJSON_IsObject(commands)) {
@@ -235,6 +393,13 @@ static char **load_platform_commands(cJSON *commands) {
 
    return load_string_array(platform_commands);
 }
+/* Load a timeout given in (possibly fractional) seconds as milliseconds */
+static long load_timeout_ms(cJSON *json, const char *field) {
+   cJSON *timeout = cJSON_GetObjectItemCaseSensitive(json, field);
+   if (!cJSON_IsNumber(timeout) || timeout->valuedouble <= 0) return 0;
+
+   return (long)(timeout->valuedouble * 1000.0);
+}
 /* Raplaces variable symbols with the value in VarTable */
 static char *resolve_vars(const char *input) {
    if (!input) return strdup("");
@@ -23,6 +23,9 @@
 #define CONFIG_FIELD_LOG_FILE "log_file"
 #define CONFIG_FIELD_TARGETS "targets"
 #define CONFIG_FIELD_DEFAULT_TARGET "default_target"
+#define CONFIG_FIELD_BUILD_DIR "build_dir"
+#define CONFIG_FIELD_ACTION_TIMEOUT "action_timeout"
+#define CONFIG_FIELD_VARIANTS "variants"
 
 #define CONFIG_TARGET_NAME "name"
 #define CONFIG_TARGET_TYPE "type"
@@ -34,11 +37,27 @@
 #define CONFIG_TARGET_OUTDIR "out_dir"
 #define CONFIG_TARGET_OUTPUT "output"
 #define CONFIG_TARGET_COMMANDS "commands"
+#define CONFIG_TARGET_TIMEOUT "timeout"
+#define CONFIG_TARGET_ACTION_TIMEOUT "action_timeout"
+#define CONFIG_TARGET_DEPENDENCIES "dependencies"
+#define CONFIG_TARGET_KIND "kind"
+#define CONFIG_TARGET_THIN "thin"
+#define CONFIG_TARGET_ARCHIVER "archiver"
+#define CONFIG_TARGET_UNITY "unity"
+#define CONFIG_UNITY_BATCH_SIZE "batch_size"
+#define CONFIG_UNITY_EXCLUDE "exclude"
+#define CONFIG_TARGET_PCH "pch"
 
 #define TARGET_TYPE_OP "op"
 #define TARGET_TYPE_EXEC "exe"
 #define TARGET_TYPE_LIB "lib"
 
+#define TARGET_KIND_STATIC "static" // lib kind: `ar` archive of the objects
+#define TARGET_KIND_SHARED "shared" // lib kind: shared object linked with -shared (default)
+#define TARGET_ARCHIVER "ar"        // Archiver used when a static lib names none
+#define TARGET_VARIANT_SEPARATOR "@" // Variant targets are named `<target>@<variant>`
+#define VARIANT_VAR_NAME "VARIANT"     // Variable holding the variant's name while its targets load
+
 /**
  * @brief ILoader interface.
  * @details Provides an interface for parsing JSON files.
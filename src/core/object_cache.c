@@ -0,0 +1,253 @@
+/* src/core/object_cache.c
+ * Sigma.Build Object Cache
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * Entries are plain files at `<dir>/<key[0..1]>/<key[2..]>`. A key is two independent 64-bit
+ * hashes of the preprocessed output, both seeded with the compile's signature. Line markers in
+ * the output name files by absolute path where the compiler found them so: the workspace root
+ * is hashed as `.` and home as `~` there, as in signatures, so checkouts share keys. Objects are
+ * copied in and out (copy_file_range, so reflinking file systems share the blocks): an object
+ * handed out gets a fresh mtime, and nothing the build later does to it touches the entry.
+ * Stores write a temp file renamed into place, so concurrent builds never read a partial entry.
+ * The remote layer is only asked about keys missing locally, and each remote hit is stored
+ * locally, so an object crosses the network once per machine.
+ */
+#define _GNU_SOURCE
+#include "object_cache.h"
+#include "remote_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char cache_dir[4096];         // Cache directory (empty while closed or remote only)
+static int is_remote = 0;            // Set while a remote cache is open
+static char root_dir[4096];          // Workspace root, hashed as `.` in line markers (empty if it is `/`)
+static const char *home_dir = NULL;  // $HOME, hashed as `~` in line markers (NULL if unset or the root itself)
+
+/* Path of an entry; returns 0 if it does not fit */
+static int cache_entry_path(const char *key, char *path, size_t size) {
+   int len = snprintf(path, size, "%s/%.2s/%s", cache_dir, key, key + 2);
+   return cache_dir[0] && strlen(key) == OBJECT_CACHE_KEY_SIZE - 1 && len > 0 && (size_t)len < size;
+}
+/* Format a key from its two hashes */
+static void cache_format_key(uint64_t first, uint64_t second, char *key) {
+   snprintf(key, OBJECT_CACHE_KEY_SIZE, "%016llx%016llx", (unsigned long long)first, (unsigned long long)second);
+}
+/* Copy a file's contents (and permissions: linked outputs are executable) into a new file; returns 0 (removing the
+ * copy) on failure */
+static int cache_copy(const char *from, const char *to) {
+   int in = open(from, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (in >= 0 && fstat(in, &st) != 0) {
+      close(in);
+      in = -1;
+   }
+   if (in < 0) return SB_FALSE;
+   int out = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+   if (out < 0) {
+      close(in);
+      return SB_FALSE;
+   }
+
+   int is_copied = SB_TRUE;
+   for (;;) {
+      ssize_t n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+      if (n > 0) continue;
+      if (n == 0) break;
+      if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+         is_copied = SB_FALSE;
+         break;
+      }
+      // No in-kernel copy between these files: plain reads and writes from where it stopped
+      char buffer[65536];
+      for (ssize_t len; is_copied && (len = read(in, buffer, sizeof(buffer))) != 0;) {
+         is_copied = len > 0 && write(out, buffer, len) == len;
+      }
+      break;
+   }
+   close(in);
+   if (close(out) != 0) is_copied = SB_FALSE;
+   if (!is_copied) unlink(to);
+   return is_copied;
+}
+
+/* Record the workspace root and home the way the action graph does for signatures */
+static void cache_set_prefixes(void) {
+   if (!getcwd(root_dir, sizeof(root_dir)) || strcmp(root_dir, "/") == 0) root_dir[0] = '\0';
+   home_dir = getenv("HOME");
+   size_t home_len = home_dir ? strlen(home_dir) : 0;
+   if (home_len <= 1 || home_dir[home_len - 1] == '/' || strcmp(home_dir, root_dir) == 0) home_dir = NULL;
+}
+/* Length of the root or home directory a path of `size` bytes starts with (up to a path boundary); `alias` names it */
+static size_t cache_match_prefix(const char *path, size_t size, const char **alias) {
+   size_t len = strlen(root_dir);
+   if (len && len < size && memcmp(path, root_dir, len) == 0 && (path[len] == '/' || path[len] == '"')) {
+      *alias = ".";
+      return len;
+   }
+   len = home_dir ? strlen(home_dir) : 0;
+   if (len && len < size && memcmp(path, home_dir, len) == 0 && (path[len] == '/' || path[len] == '"')) {
+      *alias = "~";
+      return len;
+   }
+   return 0;
+}
+/* Copy a preprocessed unit with the root spelled `.` and home `~` in its line markers (`# <line> "<path>" ...`), which
+ * -ffile-prefix-map leaves alone; returns the copy's length (never more than the unit's) */
+static size_t cache_normalize(const char *data, size_t size, char *out) {
+   size_t len = 0;
+   for (size_t i = 0; i < size;) {
+      const char *newline = memchr(data + i, '\n', size - i);
+      size_t line_end = newline ? (size_t)(newline - data) + 1 : size;
+      int is_marker = line_end - i > 3 && data[i] == '#' && data[i + 1] == ' ' && data[i + 2] >= '0' && data[i + 2] <= '9';
+      const char *quote = is_marker ? memchr(data + i, '"', line_end - i) : NULL;
+      if (quote) {
+         size_t head = quote + 1 - (data + i);
+         memcpy(out + len, data + i, head);
+         len += head;
+         i += head;
+         const char *alias = NULL;
+         size_t prefix = cache_match_prefix(data + i, line_end - i, &alias);
+         if (prefix) {
+            len += strlen(strcpy(out + len, alias)); // Never longer than the prefix (at least one character)
+            i += prefix;
+         }
+      }
+      memcpy(out + len, data + i, line_end - i);
+      len += line_end - i;
+      i = line_end;
+   }
+   return len;
+}
+
+static int cache_open(const char *dir, const char *url) {
+   cache_set_prefixes();
+   is_remote = url && RemoteCache.open(url);
+   if (url && !is_remote) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Unusable remote cache URL (expected http://host[:port][/path]): %s\n", url);
+   }
+   if (!dir) return is_remote;
+   const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+   int len;
+   if (*dir) {
+      len = snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+   } else if (xdg && *xdg) {
+      len = snprintf(cache_dir, sizeof(cache_dir), "%s/" OBJECT_CACHE_DIR, xdg);
+   } else if (home && *home) {
+      len = snprintf(cache_dir, sizeof(cache_dir), "%s/.cache/" OBJECT_CACHE_DIR, home);
+   } else {
+      len = -1;
+   }
+   while (len > 1 && cache_dir[len - 1] == '/') cache_dir[--len] = '\0';
+   if (len <= 0 || (size_t)len >= sizeof(cache_dir) - 64 || !Files.make_dirs(cache_dir)) {
+      cache_dir[0] = '\0';
+      return is_remote;
+   }
+   return SB_TRUE;
+}
+
+static int cache_key(const char *path, uint64_t signature, char *key) {
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) close(fd);
+      return SB_FALSE;
+   }
+   const unsigned char *mapped = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+   close(fd);
+   if (mapped == MAP_FAILED) return SB_FALSE;
+   size_t size = st.st_size, i = 0;
+   unsigned char *normalized = mapped && (root_dir[0] || home_dir) ? malloc(size) : NULL;
+   if (normalized) size = cache_normalize((const char *)mapped, size, (char *)normalized);
+   const unsigned char *data = normalized ? normalized : mapped;
+
+   // FNV-1a and a multiply-rotate hash over 8-byte words (then the tail bytes)
+   uint64_t first = (1469598103934665603ULL ^ signature) ^ (uint64_t)size;
+   uint64_t second = (signature * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)size;
+   for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof(word));
+      first = (first ^ word) * 1099511628211ULL;
+      first ^= first >> 32;
+      second = ((second ^ word) * 0xC2B2AE3D27D4EB4FULL);
+      second = (second << 31 | second >> 33) + 0x165667B19E3779F9ULL;
+   }
+   for (; i < size; i++) {
+      first = (first ^ data[i]) * 1099511628211ULL;
+      second = ((second ^ data[i]) * 0xC2B2AE3D27D4EB4FULL);
+   }
+   if (mapped) munmap((void *)mapped, st.st_size);
+   free(normalized);
+   cache_format_key(first, second, key);
+   return SB_TRUE;
+}
+
+static void cache_combine(const uint64_t *values, int count, char *key) {
+   // The same two hashes, over the values as words
+   uint64_t first = 1469598103934665603ULL ^ (uint64_t)count, second = 0x9E3779B97F4A7C15ULL * (uint64_t)count;
+   for (int i = 0; i < count; i++) {
+      first = (first ^ values[i]) * 1099511628211ULL;
+      first ^= first >> 32;
+      second = ((second ^ values[i]) * 0xC2B2AE3D27D4EB4FULL);
+      second = (second << 31 | second >> 33) + 0x165667B19E3779F9ULL;
+   }
+   cache_format_key(first, second, key);
+}
+
+static int cache_contains(const char *key) {
+   char entry[4200];
+   return (cache_entry_path(key, entry, sizeof(entry)) && access(entry, F_OK) == 0) || (is_remote && RemoteCache.contains(key));
+}
+
+/* Store an object in the local cache */
+static int cache_store_local(const char *key, const char *path) {
+   char entry[4200], tmp[4300];
+   if (!cache_entry_path(key, entry, sizeof(entry))) return SB_FALSE;
+   char *slash = strrchr(entry, '/');
+   *slash = '\0';
+   int is_dir = mkdir(entry, 0755) == 0 || errno == EEXIST;
+   *slash = '/';
+   snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", entry, (long)getpid());
+   if (!is_dir || !cache_copy(path, tmp)) return SB_FALSE;
+   if (rename(tmp, entry) != 0) {
+      unlink(tmp);
+      return SB_FALSE;
+   }
+   return SB_TRUE;
+}
+
+static int cache_fetch(const char *key, const char *path) {
+   char entry[4200];
+   if (cache_entry_path(key, entry, sizeof(entry)) && cache_copy(entry, path)) return SB_TRUE;
+   if (!is_remote || !RemoteCache.fetch(key, path)) return SB_FALSE;
+   if (cache_dir[0]) cache_store_local(key, path);
+   return SB_TRUE;
+}
+
+static int cache_store(const char *key, const char *path) {
+   int is_stored = cache_dir[0] && cache_store_local(key, path);
+   return (is_remote && RemoteCache.store(key, path)) || is_stored;
+}
+
+static void cache_close(void) {
+   if (is_remote) RemoteCache.close();
+   is_remote = 0;
+   cache_dir[0] = '\0';
+}
+
+const IObjectCache ObjectCache = {
+    .open = cache_open,
+    .key = cache_key,
+    .combine = cache_combine,
+    .contains = cache_contains,
+    .fetch = cache_fetch,
+    .store = cache_store,
+    .close = cache_close,
+};
@@ -0,0 +1,79 @@
+/* src/core/object_cache.h
+ * Sigma.Build Object Cache
+ * Keeps compiled objects by the content of their preprocessed translation unit.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for a local content-addressed object cache. An entry is keyed
+ * by the preprocessed output of a compile together with the compile's signature (command and
+ * toolchain), so a unit whose headers and macros expand to the same text gets the same object
+ * back whatever file timestamps say; a link is keyed by its command and the digests of the
+ * objects and libraries it reads. Entries live in the user cache directory by default and
+ * are shared by every workspace and build directory on the machine. A remote cache, when given,
+ * is consulted after the local one and receives every object stored.
+ */
+#ifndef OBJECT_CACHE_H
+#define OBJECT_CACHE_H
+
+#include "sbuild.h"
+
+#define OBJECT_CACHE_DIR "sbuild/objects" // Default cache directory inside the user cache directory
+#define OBJECT_CACHE_KEY_SIZE 33           // Hex key length plus the terminator
+
+/**
+ * @brief IObjectCache interface.
+ * @details Provides an interface for looking up and storing objects by preprocessed content.
+ */
+typedef struct IObjectCache {
+   /**
+    * @brief Opens the cache, creating its directory when missing.
+    * @param dir :the cache directory (empty: `$XDG_CACHE_HOME` or `~/.cache`, then OBJECT_CACHE_DIR; NULL: none)
+    * @param url :the remote cache URL (NULL: none)
+    * @return :1 if the cache can be used; otherwise, 0
+    */
+   int (*open)(const char *, const char *);
+   /**
+    * @brief Computes the key of a compile from its preprocessed output.
+    * @param path :the preprocessed output
+    * @param signature :the compile's signature
+    * @param key :receives the key (OBJECT_CACHE_KEY_SIZE chars)
+    * @return :1 if the key was computed; otherwise, 0 (the output is unreadable)
+    */
+   int (*key)(const char *, uint64_t, char *);
+   /**
+    * @brief Computes the key of an action from the digests of its inputs.
+    * @param values :the action's signature followed by its input digests
+    * @param count :number of values
+    * @param key :receives the key (OBJECT_CACHE_KEY_SIZE chars)
+    */
+   void (*combine)(const uint64_t *, int, char *);
+   /**
+    * @brief Checks whether an object is cached, without copying it out.
+    * @param key :the action's key
+    * @return :1 if the object is cached locally or remotely; otherwise, 0
+    */
+   int (*contains)(const char *);
+   /**
+    * @brief Copies a cached object out (a remote hit is kept locally as well).
+    * @param key :the action's key
+    * @param path :the file to write the object to
+    * @return :1 on a hit; otherwise, 0 (nothing is left at path)
+    */
+   int (*fetch)(const char *, const char *);
+   /**
+    * @brief Stores an object under a key (atomically: readers never see a partial entry); the upload runs in the background.
+    * @param key :the action's key
+    * @param path :the object just built
+    * @return :1 if stored; otherwise, 0
+    */
+   int (*store)(const char *, const char *);
+   /**
+    * @brief Closes the cache once the uploads are done.
+    */
+   void (*close)(void);
+} IObjectCache;
+
+extern const IObjectCache ObjectCache;
+
+#endif // OBJECT_CACHE_H
@@ -0,0 +1,719 @@
+/* src/core/remote_cache.c
+ * Sigma.Build Remote Cache
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * The client keeps two HTTP/1.1 connections alive: one for lookups on the build's thread and one
+ * for the upload thread, each reconnected once if the server closed it while idle. A server that
+ * cannot be reached or stops answering is given up on for the rest of the run, so a dead cache
+ * costs one timeout, not one per action. An entry is `SBC1`, the codec, the object's permissions,
+ * its size and its digest (little-endian), then the object: compression happens on the upload thread and a
+ * download is only used once it decompresses to an object matching the digest. libzstd is loaded
+ * at run time; without it entries are stored uncompressed and zstd entries are misses.
+ * The server runs a thread per connection and keeps entries at `<dir>/<key[0..1]>/<key[2..]>`,
+ * writing each upload to a temp file renamed into place.
+ */
+#define _GNU_SOURCE
+#include "remote_cache.h"
+#include "string_map.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define ENTRY_MAGIC "SBC1"
+#define ENTRY_HEADER_SIZE 24 // Magic, codec (2 bytes), permissions (2 bytes), object size, object digest
+#define CODEC_NONE 0
+#define CODEC_ZSTD 1
+#define ZSTD_LEVEL 3
+#define KEY_MAX 128             // Longest key sent or served
+#define HTTP_LINE_MAX 8192      // Longest request, status or header line
+#define SERVER_BACKLOG 64
+#define SERVER_IDLE_TIMEOUT_S 60 // A connection idle this long is closed by the server
+
+typedef struct http_conn_s {
+   int fd;             // Connected socket (-1: not connected)
+   int is_reused;      // Set once a request went through the connection (the server may have closed it since)
+   size_t pos;         // Next unread byte of buffer
+   size_t len;         // Bytes received into buffer
+   char buffer[16384]; // Received bytes not yet consumed
+} http_conn_s;
+
+typedef struct http_message_s {
+   int status;            // Status code (client) or 0 (server)
+   char method[8];        // Request method (server)
+   char target[2048];     // Request target (server)
+   long content_length;   // Content-Length (-1 if absent)
+   int is_chunked;        // Set for `Transfer-Encoding: chunked`
+   int is_close;          // Set when the connection closes after this message
+   int is_continue;       // Set for `Expect: 100-continue`
+} http_message_s;
+
+typedef struct upload_s {
+   struct upload_s *next; // Next queued upload
+   char key[KEY_MAX + 1]; // Entry key
+   size_t size;           // Object size
+   unsigned mode;         // Object permissions
+   int is_replacing;      // Set when the server's entry was found corrupt (uploaded without checking for it)
+   unsigned char data[];  // Object bytes
+} upload_s;
+
+static struct {
+   size_t (*bound)(size_t);
+   size_t (*compress)(void *, size_t, const void *, size_t, int);
+   size_t (*decompress)(void *, size_t, const void *, size_t);
+   unsigned (*is_error)(size_t);
+} zstd; // libzstd, when installed (bound is NULL without it)
+
+static char url_host[256];                                  // Server host
+static char url_authority[300];                             // Server host and port, as sent in Host headers
+static char url_port[16];                                   // Server port
+static char url_path[2048];                                 // Path the keys are appended to (no trailing slash)
+static int is_open = 0;                                     // Set while a URL is open
+static int is_down = 0;                                     // Set once the server failed (read by both threads)
+static http_conn_s *lookup_conn = NULL;                     // Connection of the build's thread
+static http_conn_s *upload_conn = NULL;                     // Connection of the upload thread
+static StringMap corrupt_keys = NULL;                       // Keys whose downloads did not match their digest
+static char CORRUPT[] = "corrupt";                          // Marker of corrupt_keys entries
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the upload queue
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;   // Signals queued uploads (and closing)
+static upload_s *queue_head = NULL;                         // Next upload
+static upload_s *queue_tail = NULL;                         // Last upload
+static size_t queued_bytes = 0;                             // Object bytes queued
+static int is_closing = 0;                                  // Set when the upload thread should drain and exit
+static int is_uploading = 0;                                // Set while the upload thread runs
+static pthread_t uploader;                                  // The upload thread
+static char serve_dir[4096];                                // Directory served
+static unsigned long serve_counter = 0;                     // Numbers the server's temp files
+
+/* Load libzstd if it is installed (no headers needed: the few entry points are declared above) */
+static void remote_load_zstd(void) {
+   if (zstd.bound) return;
+   void *lib = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+   if (!lib) return;
+   *(void **)&zstd.compress = dlsym(lib, "ZSTD_compress");
+   *(void **)&zstd.decompress = dlsym(lib, "ZSTD_decompress");
+   *(void **)&zstd.is_error = dlsym(lib, "ZSTD_isError");
+   *(void **)&zstd.bound = dlsym(lib, "ZSTD_compressBound");
+   if (!zstd.compress || !zstd.decompress || !zstd.is_error || !zstd.bound) {
+      memset(&zstd, 0, sizeof(zstd));
+      dlclose(lib);
+   }
+}
+/* Digest of an object (FNV-1a over 8-byte words, then the tail bytes) */
+static uint64_t remote_digest(const unsigned char *data, size_t size) {
+   uint64_t hash = 1469598103934665603ULL ^ (uint64_t)size;
+   size_t i = 0;
+   for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * 1099511628211ULL;
+      hash ^= hash >> 32;
+   }
+   for (; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ULL;
+   return hash;
+}
+static void remote_put64(unsigned char *p, uint64_t value) {
+   for (int i = 0; i < 8; i++) p[i] = (unsigned char)(value >> (8 * i));
+}
+static uint64_t remote_get64(const unsigned char *p) {
+   uint64_t value = 0;
+   for (int i = 7; i >= 0; i--) value = value << 8 | p[i];
+   return value;
+}
+/* Wrap an object in an entry, compressed when that makes it smaller; returns NULL if out of memory */
+static unsigned char *remote_encode(const unsigned char *data, size_t size, unsigned mode, size_t *entry_size) {
+   size_t bound = zstd.bound ? zstd.bound(size) : 0;
+   unsigned char *entry = malloc(ENTRY_HEADER_SIZE + (bound > size ? bound : size));
+   if (!entry) return NULL;
+   unsigned codec = CODEC_NONE;
+   size_t body = size;
+   if (zstd.bound) {
+      size_t len = zstd.compress(entry + ENTRY_HEADER_SIZE, bound, data, size, ZSTD_LEVEL);
+      if (!zstd.is_error(len) && len < size) {
+         codec = CODEC_ZSTD;
+         body = len;
+      }
+   }
+   if (codec == CODEC_NONE) memcpy(entry + ENTRY_HEADER_SIZE, data, size);
+   memcpy(entry, ENTRY_MAGIC, 4);
+   entry[4] = (unsigned char)codec;
+   entry[5] = 0;
+   entry[6] = (unsigned char)(mode & 0777);
+   entry[7] = (unsigned char)((mode & 0777) >> 8);
+   remote_put64(entry + 8, size);
+   remote_put64(entry + 16, remote_digest(data, size));
+   *entry_size = ENTRY_HEADER_SIZE + body;
+   return entry;
+}
+/* Unwrap an entry into a file; returns 0 (leaving no file) unless the object matches its digest */
+static int remote_decode(const unsigned char *entry, size_t entry_size, const char *path) {
+   if (entry_size < ENTRY_HEADER_SIZE || memcmp(entry, ENTRY_MAGIC, 4) != 0) return SB_FALSE;
+   unsigned codec = entry[4] | entry[5] << 8, mode = (entry[6] | entry[7] << 8) & 0777;
+   uint64_t size = remote_get64(entry + 8), digest = remote_get64(entry + 16);
+   const unsigned char *body = entry + ENTRY_HEADER_SIZE;
+   size_t body_size = entry_size - ENTRY_HEADER_SIZE;
+   if (size > REMOTE_CACHE_MAX_ENTRY) return SB_FALSE;
+
+   unsigned char *data = NULL;
+   if (codec == CODEC_ZSTD && zstd.bound && (data = malloc(size ? size : 1))) {
+      size_t len = zstd.decompress(data, size, body, body_size);
+      if (zstd.is_error(len) || len != size) {
+         free(data);
+         return SB_FALSE;
+      }
+      body = data;
+   } else if (codec != CODEC_NONE || body_size != size) {
+      return SB_FALSE;
+   }
+
+   int is_written = remote_digest(body, size) == digest;
+   int fd = is_written ? open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode ? mode : 0666) : -1;
+   for (size_t done = 0; fd >= 0 && is_written && done < size;) {
+      ssize_t n = write(fd, body + done, size - done);
+      is_written = n > 0;
+      if (n > 0) done += n;
+   }
+   if (fd < 0 || close(fd) != 0) is_written = SB_FALSE;
+   if (!is_written && fd >= 0) unlink(path);
+   free(data);
+   return is_written;
+}
+
+/* Send a whole buffer; returns 0 if the connection failed */
+static int http_send(int fd, const void *data, size_t size) {
+   for (size_t done = 0; done < size;) {
+      ssize_t n = send(fd, (const char *)data + done, size - done, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue; // A child exited (the executor's handlers do not restart calls)
+      if (n <= 0) return SB_FALSE;
+      done += n;
+   }
+   return SB_TRUE;
+}
+/* Receive exactly size bytes (into data, or discarded if NULL); returns 0 if the connection ended first */
+static int http_receive(http_conn_s *conn, void *data, size_t size) {
+   while (size > 0) {
+      if (conn->pos == conn->len) {
+         ssize_t n = recv(conn->fd, conn->buffer, sizeof(conn->buffer), 0);
+         if (n < 0 && errno == EINTR) continue;
+         if (n <= 0) return SB_FALSE;
+         conn->pos = 0;
+         conn->len = n;
+      }
+      size_t n = conn->len - conn->pos < size ? conn->len - conn->pos : size;
+      if (data) memcpy(data, conn->buffer + conn->pos, n);
+      if (data) data = (char *)data + n;
+      conn->pos += n;
+      size -= n;
+   }
+   return SB_TRUE;
+}
+/* Receive one CRLF-terminated line (without the CRLF); returns 0 if the connection ended or the line is too long */
+static int http_receive_line(http_conn_s *conn, char *line, size_t size) {
+   size_t len = 0;
+   for (;;) {
+      char c;
+      if (!http_receive(conn, &c, 1)) return SB_FALSE;
+      if (c == '\n') break;
+      if (len + 1 >= size) return SB_FALSE;
+      line[len++] = c;
+   }
+   if (len > 0 && line[len - 1] == '\r') len--;
+   line[len] = '\0';
+   return SB_TRUE;
+}
+/* Receive a message's start line and headers; returns 0 if the connection ended or the message is malformed */
+static int http_receive_head(http_conn_s *conn, http_message_s *message) {
+   char line[HTTP_LINE_MAX];
+   memset(message, 0, sizeof(*message));
+   message->content_length = -1;
+   if (!http_receive_line(conn, line, sizeof(line))) return SB_FALSE;
+   if (strncmp(line, "HTTP/1.", 7) == 0) {
+      message->status = atoi(line + 9);
+      message->is_close = line[7] == '0';
+   } else if (sscanf(line, "%7s %2047s HTTP/1.", message->method, message->target) == 2) {
+      message->is_close = strstr(line, " HTTP/1.0") != NULL;
+   } else {
+      return SB_FALSE;
+   }
+
+   while (http_receive_line(conn, line, sizeof(line))) {
+      if (!line[0]) return SB_TRUE;
+      char *value = strchr(line, ':');
+      if (!value) continue;
+      *value++ = '\0';
+      while (*value == ' ' || *value == '\t') value++;
+      if (strcasecmp(line, "Content-Length") == 0) {
+         char *end = NULL;
+         message->content_length = strtol(value, &end, 10);
+         if (*end || message->content_length < 0) return SB_FALSE;
+      } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+         message->is_chunked = strcasestr(value, "chunked") != NULL;
+      } else if (strcasecmp(line, "Connection") == 0) {
+         message->is_close = strcasecmp(value, "close") == 0;
+      } else if (strcasecmp(line, "Expect") == 0) {
+         message->is_continue = strcasecmp(value, "100-continue") == 0;
+      }
+   }
+   return SB_FALSE;
+}
+/* Receive a message body into a new buffer (NULL if empty); returns 0 if it is malformed or too large */
+static int http_receive_body(http_conn_s *conn, http_message_s *message, unsigned char **body, size_t *size) {
+   *body = NULL;
+   *size = 0;
+   if (!message->is_chunked) {
+      if (message->content_length < 0) return SB_FALSE; // Read-until-close bodies are not used by caches
+      if (message->content_length > REMOTE_CACHE_MAX_ENTRY) return SB_FALSE;
+      *size = message->content_length;
+      if (*size == 0) return SB_TRUE;
+      if (!(*body = malloc(*size)) || !http_receive(conn, *body, *size)) {
+         free(*body);
+         *body = NULL;
+         return SB_FALSE;
+      }
+      return SB_TRUE;
+   }
+
+   char line[HTTP_LINE_MAX];
+   for (;;) {
+      if (!http_receive_line(conn, line, sizeof(line))) break;
+      char *end = NULL;
+      unsigned long chunk = strtoul(line, &end, 16);
+      if (end == line || *size + chunk > (size_t)REMOTE_CACHE_MAX_ENTRY) break;
+      if (chunk == 0) {
+         while (http_receive_line(conn, line, sizeof(line))) {
+            if (!line[0]) return SB_TRUE; // End of the trailers
+         }
+         break;
+      }
+      unsigned char *grown = realloc(*body, *size + chunk);
+      if (!grown) break;
+      *body = grown;
+      if (!http_receive(conn, *body + *size, chunk) || !http_receive_line(conn, line, sizeof(line))) break;
+      *size += chunk;
+   }
+   free(*body);
+   *body = NULL;
+   return SB_FALSE;
+}
+
+/* Connect to the server, closing any earlier connection */
+static int remote_connect(http_conn_s *conn) {
+   if (conn->fd >= 0) close(conn->fd);
+   conn->fd = -1;
+   conn->is_reused = 0;
+   conn->pos = conn->len = 0;
+
+   struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *addrs = NULL;
+   if (getaddrinfo(url_host, url_port, &hints, &addrs) != 0) return SB_FALSE;
+   struct timeval timeout = {.tv_sec = REMOTE_CACHE_TIMEOUT_S};
+   for (struct addrinfo *addr = addrs; addr && conn->fd < 0; addr = addr->ai_next) {
+      int fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+      if (fd < 0) continue;
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)); // Also bounds connect()
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      int is_connected = connect(fd, addr->ai_addr, addr->ai_addrlen) == 0;
+      if (!is_connected && errno == EINTR) {
+         // Interrupted by a signal, the connection goes on: wait for its outcome
+         struct pollfd ready = {.fd = fd, .events = POLLOUT};
+         int n, error = 0;
+         socklen_t len = sizeof(error);
+         while ((n = poll(&ready, 1, REMOTE_CACHE_TIMEOUT_S * 1000)) < 0 && errno == EINTR) {}
+         is_connected = n == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+      }
+      if (is_connected) {
+         conn->fd = fd;
+      } else {
+         close(fd);
+      }
+   }
+   freeaddrinfo(addrs);
+   return conn->fd >= 0;
+}
+/* Send one request for a key and receive the response (its body only if wanted); returns the status, or -1 */
+static int remote_request(http_conn_s *conn, const char *method, const char *key, const unsigned char *body, size_t size,
+                          unsigned char **response, size_t *response_size) {
+   char head[4096];
+   int is_put = strcmp(method, "PUT") == 0;
+   int len = snprintf(head, sizeof(head), "%s %s/%s HTTP/1.1\r\nHost: %s\r\nUser-Agent: sbuild\r\n", method, url_path, key,
+                      url_authority);
+   if (is_put) {
+      len += snprintf(head + len, sizeof(head) - len, "Content-Type: application/octet-stream\r\nContent-Length: %zu\r\n",
+                      size);
+   }
+   len += snprintf(head + len, sizeof(head) - len, "\r\n");
+   if (len >= (int)sizeof(head)) return -1;
+
+   // A kept-alive connection may have been closed by the server meanwhile: one retry on a new one
+   for (int attempt = 0; attempt < 2; attempt++) {
+      if ((conn->fd < 0 || attempt > 0) && !remote_connect(conn)) return -1;
+      int is_reused = conn->is_reused;
+      http_message_s message;
+      unsigned char *received = NULL;
+      size_t received_size = 0;
+      if (http_send(conn->fd, head, len) && (!is_put || http_send(conn->fd, body, size)) &&
+          http_receive_head(conn, &message) &&
+          (strcmp(method, "HEAD") == 0 || http_receive_body(conn, &message, &received, &received_size))) {
+         conn->is_reused = 1;
+         if (message.is_close) {
+            close(conn->fd);
+            conn->fd = -1;
+         }
+         if (response && message.status == 200) {
+            *response = received;
+            *response_size = received_size;
+         } else {
+            free(received);
+         }
+         return message.status;
+      }
+      close(conn->fd);
+      conn->fd = -1;
+      if (!is_reused) break;
+   }
+   return -1;
+}
+/* Give up on the server for the rest of the run */
+static void remote_fail(void) {
+   if (__atomic_exchange_n(&is_down, 1, __ATOMIC_SEQ_CST)) return;
+   Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Remote cache http://%s%s unavailable; continuing without it\n", url_authority,
+                url_path);
+}
+static int remote_is_usable(const char *key) {
+   return is_open && !__atomic_load_n(&is_down, __ATOMIC_SEQ_CST) && key && strlen(key) <= KEY_MAX;
+}
+/* Upload one object unless the server already holds it */
+static void remote_upload(upload_s *upload) {
+   int status = upload->is_replacing ? 404 : remote_request(upload_conn, "HEAD", upload->key, NULL, 0, NULL, NULL);
+   if (status == 200) return;
+   size_t entry_size = 0;
+   unsigned char *entry = status < 0 ? NULL : remote_encode(upload->data, upload->size, upload->mode, &entry_size);
+   if (entry) status = remote_request(upload_conn, "PUT", upload->key, entry, entry_size, NULL, NULL);
+   free(entry);
+   if (status < 0) remote_fail();
+}
+/* Upload thread: send queued objects until the cache closes and the queue is empty */
+static void *remote_upload_loop(void *arg) {
+   (void)arg;
+   pthread_mutex_lock(&queue_lock);
+   for (;;) {
+      while (!queue_head && !is_closing) pthread_cond_wait(&queue_cond, &queue_lock);
+      upload_s *upload = queue_head;
+      if (!upload) break;
+      queue_head = upload->next;
+      if (!queue_head) queue_tail = NULL;
+      pthread_mutex_unlock(&queue_lock);
+      if (remote_is_usable(upload->key)) remote_upload(upload);
+      pthread_mutex_lock(&queue_lock);
+      queued_bytes -= upload->size;
+      free(upload);
+   }
+   pthread_mutex_unlock(&queue_lock);
+   return NULL;
+}
+
+static int remote_open(const char *url) {
+   if (is_open || !url || strncmp(url, "http://", 7) != 0) return SB_FALSE;
+   // `host[:port][/path]`, the host possibly a bracketed IPv6 address
+   const char *authority = url + 7, *path = strchr(authority, '/');
+   size_t authority_len = path ? (size_t)(path - authority) : strlen(authority);
+   const char *colon = memrchr(authority, ':', authority_len), *bracket = memrchr(authority, ']', authority_len);
+   if (colon && bracket && colon < bracket) colon = NULL;
+   const char *host = authority;
+   size_t name_len = colon ? (size_t)(colon - authority) : authority_len;
+   size_t port_len = colon ? authority_len - name_len - 1 : 0;
+   if (name_len > 1 && host[0] == '[' && host[name_len - 1] == ']') {
+      host++;
+      name_len -= 2;
+   }
+   if (name_len == 0 || name_len >= sizeof(url_host) || port_len >= sizeof(url_port) || (colon && port_len == 0) ||
+       (path && strlen(path) >= sizeof(url_path))) {
+      return SB_FALSE;
+   }
+   memcpy(url_host, host, name_len);
+   url_host[name_len] = '\0';
+   snprintf(url_authority, sizeof(url_authority), "%.*s", (int)authority_len, authority);
+   snprintf(url_port, sizeof(url_port), "%.*s", colon ? (int)port_len : 2, colon ? colon + 1 : "80");
+   snprintf(url_path, sizeof(url_path), "%s", path ? path : "");
+   for (size_t len = strlen(url_path); len > 0 && url_path[len - 1] == '/';) url_path[--len] = '\0';
+
+   if (!(lookup_conn = malloc(sizeof(http_conn_s))) || !(upload_conn = malloc(sizeof(http_conn_s)))) {
+      free(lookup_conn);
+      lookup_conn = NULL;
+      return SB_FALSE;
+   }
+   lookup_conn->fd = upload_conn->fd = -1;
+   remote_load_zstd();
+   is_down = 0;
+   is_open = SB_TRUE;
+   return SB_TRUE;
+}
+
+static int remote_contains(const char *key) {
+   if (!remote_is_usable(key)) return SB_FALSE;
+   int status = remote_request(lookup_conn, "HEAD", key, NULL, 0, NULL, NULL);
+   if (status < 0) remote_fail();
+   return status == 200;
+}
+
+static int remote_fetch(const char *key, const char *path) {
+   if (!remote_is_usable(key)) return SB_FALSE;
+   unsigned char *entry = NULL;
+   size_t entry_size = 0;
+   int status = remote_request(lookup_conn, "GET", key, NULL, 0, &entry, &entry_size);
+   if (status < 0) remote_fail();
+   int is_hit = status == 200 && remote_decode(entry, entry_size, path);
+   if (status == 200 && !is_hit) {
+      if (corrupt_keys || (corrupt_keys = StringMaps.create())) StringMaps.put(corrupt_keys, key, CORRUPT);
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Ignoring remote cache entry %s: it does not match its digest\n", key);
+   }
+   free(entry);
+   return is_hit;
+}
+
+static int remote_store(const char *key, const char *path) {
+   if (!remote_is_usable(key)) return SB_FALSE;
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0 || st.st_size > REMOTE_CACHE_MAX_ENTRY) {
+      if (fd >= 0) close(fd);
+      return SB_FALSE;
+   }
+   upload_s *upload = malloc(sizeof(upload_s) + st.st_size);
+   size_t done = 0;
+   while (upload && done < (size_t)st.st_size) {
+      ssize_t n = read(fd, upload->data + done, st.st_size - done);
+      if (n <= 0) break;
+      done += n;
+   }
+   close(fd);
+   if (!upload || done != (size_t)st.st_size) {
+      free(upload);
+      return SB_FALSE;
+   }
+   snprintf(upload->key, sizeof(upload->key), "%s", key);
+   upload->size = done;
+   upload->mode = st.st_mode & 0777;
+   upload->is_replacing = corrupt_keys && StringMaps.get(corrupt_keys, key) == CORRUPT;
+   upload->next = NULL;
+
+   pthread_mutex_lock(&queue_lock);
+   if (!is_uploading && queued_bytes + done <= REMOTE_CACHE_MAX_QUEUED) {
+      // Signals stay with the build's thread: the upload thread starts with all of them blocked
+      sigset_t all, saved;
+      sigfillset(&all);
+      pthread_sigmask(SIG_SETMASK, &all, &saved);
+      is_uploading = pthread_create(&uploader, NULL, remote_upload_loop, NULL) == 0;
+      pthread_sigmask(SIG_SETMASK, &saved, NULL);
+   }
+   int is_queued = is_uploading && queued_bytes + done <= REMOTE_CACHE_MAX_QUEUED;
+   if (is_queued) {
+      if (queue_tail) queue_tail->next = upload;
+      if (!queue_head) queue_head = upload;
+      queue_tail = upload;
+      queued_bytes += done;
+      pthread_cond_signal(&queue_cond);
+   }
+   pthread_mutex_unlock(&queue_lock);
+   if (!is_queued) free(upload); // The uploads are behind: this object is left out
+   return is_queued;
+}
+
+static void remote_close(void) {
+   if (!is_open) return;
+   pthread_mutex_lock(&queue_lock);
+   if (queue_head) Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_INFO, "Finishing uploads to the remote cache\n");
+   is_closing = 1;
+   pthread_cond_signal(&queue_cond);
+   pthread_mutex_unlock(&queue_lock);
+   if (is_uploading) pthread_join(uploader, NULL);
+   is_uploading = is_closing = 0;
+
+   if (lookup_conn->fd >= 0) close(lookup_conn->fd);
+   if (upload_conn->fd >= 0) close(upload_conn->fd);
+   free(lookup_conn);
+   free(upload_conn);
+   lookup_conn = upload_conn = NULL;
+   StringMaps.dispose(corrupt_keys);
+   corrupt_keys = NULL;
+   is_open = 0;
+}
+
+/* Path of a served entry; returns 0 for keys that are not plain names */
+static int serve_entry_path(const char *target, char *path, size_t size) {
+   const char *key = strrchr(target, '/');
+   key = key ? key + 1 : target;
+   size_t len = strcspn(key, "?#");
+   if (len < 3 || len > KEY_MAX || key[0] == '.') return SB_FALSE;
+   for (size_t i = 0; i < len; i++) {
+      char c = key[i];
+      if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '_' || c == '.')) {
+         return SB_FALSE;
+      }
+   }
+   int n = snprintf(path, size, "%s/%.2s/%.*s", serve_dir, key, (int)len - 2, key + 2);
+   return n > 0 && (size_t)n < size;
+}
+/* Send a response without a body */
+static int serve_respond(int fd, const char *status, long length, int is_close) {
+   char head[256];
+   int len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: %ld\r\n%s\r\n", status, length,
+                      is_close ? "Connection: close\r\n" : "");
+   return http_send(fd, head, len);
+}
+/* Answer GET and HEAD from an entry file */
+static int serve_get(int fd, const char *path, int is_head, int is_close) {
+   int file = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (file < 0 || fstat(file, &st) != 0) {
+      if (file >= 0) close(file);
+      return serve_respond(fd, "404 Not Found", 0, is_close);
+   }
+   char head[256];
+   int len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %ld\r\n%s\r\n",
+                      (long)st.st_size, is_close ? "Connection: close\r\n" : "");
+   int is_sent = http_send(fd, head, len);
+   for (off_t offset = 0; is_sent && !is_head && offset < st.st_size;) {
+      is_sent = sendfile(fd, file, &offset, st.st_size - offset) > 0;
+   }
+   close(file);
+   return is_sent;
+}
+/* Answer PUT: the body goes to a temp file renamed over the entry once complete */
+static int serve_put(http_conn_s *conn, http_message_s *request, const char *path) {
+   if (request->content_length < 0 || request->is_chunked || request->content_length > REMOTE_CACHE_MAX_ENTRY) {
+      serve_respond(conn->fd, request->content_length > 0 ? "413 Content Too Large" : "411 Length Required", 0, SB_TRUE);
+      return SB_FALSE; // The body is not read: the connection is out of step
+   }
+   if (request->is_continue && !http_send(conn->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25)) return SB_FALSE;
+
+   char dir[4300], tmp[4400];
+   snprintf(dir, sizeof(dir), "%s", path);
+   *strrchr(dir, '/') = '\0';
+   snprintf(tmp, sizeof(tmp), "%s.%ld.%lu.tmp", path, (long)getpid(), __atomic_add_fetch(&serve_counter, 1, __ATOMIC_SEQ_CST));
+   int file = mkdir(dir, 0755) == 0 || errno == EEXIST ? open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+
+   // The body is read even if it cannot be kept, so the connection stays in step
+   int is_stored = file >= 0;
+   char buffer[65536];
+   for (long left = request->content_length; left > 0;) {
+      size_t n = left < (long)sizeof(buffer) ? (size_t)left : sizeof(buffer);
+      if (!http_receive(conn, buffer, n)) {
+         if (file >= 0) close(file);
+         if (file >= 0) unlink(tmp);
+         return SB_FALSE;
+      }
+      if (is_stored) is_stored = write(file, buffer, n) == (ssize_t)n;
+      left -= n;
+   }
+   if (file >= 0 && close(file) != 0) is_stored = SB_FALSE;
+   if (is_stored) is_stored = rename(tmp, path) == 0;
+   if (!is_stored && file >= 0) unlink(tmp);
+   return serve_respond(conn->fd, is_stored ? "201 Created" : "500 Internal Server Error", 0, request->is_close);
+}
+/* Serve one connection until the client closes it (or stays idle too long) */
+static void *serve_connection(void *arg) {
+   http_conn_s *conn = arg;
+   struct timeval timeout = {.tv_sec = SERVER_IDLE_TIMEOUT_S};
+   setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+   http_message_s request;
+   char path[4400];
+   int is_alive = SB_TRUE;
+   while (is_alive && http_receive_head(conn, &request)) {
+      int is_get = strcmp(request.method, "GET") == 0, is_head = strcmp(request.method, "HEAD") == 0;
+      int is_put = strcmp(request.method, "PUT") == 0;
+      if (!is_put && (request.content_length > 0 || request.is_chunked)) {
+         serve_respond(conn->fd, "400 Bad Request", 0, SB_TRUE); // Bodies are only read for PUT
+         is_alive = SB_FALSE;
+      } else if (!is_get && !is_head && !is_put) {
+         is_alive = serve_respond(conn->fd, "405 Method Not Allowed", 0, request.is_close);
+      } else if (!serve_entry_path(request.target, path, sizeof(path))) {
+         serve_respond(conn->fd, is_put ? "400 Bad Request" : "404 Not Found", 0, is_put || request.is_close);
+         is_alive = !is_put; // A rejected upload's body is not read
+      } else {
+         is_alive = is_put ? serve_put(conn, &request, path) : serve_get(conn->fd, path, is_head, request.is_close);
+      }
+      if (request.is_close) is_alive = SB_FALSE;
+   }
+   close(conn->fd);
+   free(conn);
+   return NULL;
+}
+
+static int remote_serve(const char *dir, int port) {
+   const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+   int len = dir && *dir     ? snprintf(serve_dir, sizeof(serve_dir), "%s", dir)
+             : xdg && *xdg   ? snprintf(serve_dir, sizeof(serve_dir), "%s/" REMOTE_CACHE_DIR, xdg)
+             : home && *home ? snprintf(serve_dir, sizeof(serve_dir), "%s/.cache/" REMOTE_CACHE_DIR, home)
+                             : -1;
+   while (len > 1 && serve_dir[len - 1] == '/') serve_dir[--len] = '\0';
+   if (len <= 0 || (size_t)len >= sizeof(serve_dir) - 256 || !Files.make_dirs(serve_dir)) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to create the cache directory %s\n", len > 0 ? serve_dir : "(no HOME)");
+      return -1;
+   }
+
+   struct sockaddr_in6 addr = {.sin6_family = AF_INET6, .sin6_port = htons(port), .sin6_addr = in6addr_any};
+   int fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0), one = 1, zero = 0;
+   if (fd >= 0) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)); // IPv4 clients too
+   }
+   if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to serve the cache on port %d: %s\n", port, strerror(errno));
+      if (fd >= 0) close(fd);
+      return -1;
+   }
+
+   Logger.writeln("Cache server listening on port %d, serving %s (Ctrl-C to stop)", port, serve_dir);
+   pthread_attr_t attr;
+   pthread_attr_init(&attr);
+   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+   for (;;) {
+      int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+      if (client < 0) {
+         if (errno == EMFILE || errno == ENFILE) usleep(100000); // Out of descriptors until connections close
+         if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) continue;
+         break;
+      }
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      http_conn_s *conn = malloc(sizeof(http_conn_s));
+      pthread_t thread;
+      if (conn) *conn = (http_conn_s){.fd = client};
+      if (!conn || pthread_create(&thread, &attr, serve_connection, conn) != 0) {
+         close(client);
+         free(conn);
+      }
+   }
+   pthread_attr_destroy(&attr);
+   Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Cache server stopped: %s\n", strerror(errno));
+   close(fd);
+   return -1;
+}
+
+const IRemoteCache RemoteCache = {
+    .open = remote_open,
+    .contains = remote_contains,
+    .fetch = remote_fetch,
+    .store = remote_store,
+    .close = remote_close,
+    .serve = remote_serve,
+};
@@ -0,0 +1,73 @@
+/* src/core/remote_cache.h
+ * Sigma.Build Remote Cache
+ * Shares cache entries between machines through an HTTP build cache.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for the remote layer of the object cache. Entries are plain
+ * HTTP resources at `<url>/<key>`: HEAD checks for one, GET downloads it and PUT uploads it, the
+ * protocol of common HTTP build caches (ccache's HTTP storage, a WebDAV-enabled web server). An
+ * entry is a small header (size and digest of the object) followed by the object, compressed with
+ * zstd when libzstd is installed. Uploads run on a background thread, off the build's critical
+ * path. The same module serves a directory over that protocol, so a team (or a test) needs no
+ * cache infrastructure of its own.
+ */
+#ifndef REMOTE_CACHE_H
+#define REMOTE_CACHE_H
+
+#include "sbuild.h"
+
+#define REMOTE_CACHE_DIR "sbuild/remote"            // Default directory served, inside the user cache directory
+#define REMOTE_CACHE_PORT 8780                      // Default port of the cache server
+#define REMOTE_CACHE_TIMEOUT_S 5                    // Socket timeout; a server not answering in time is given up on
+#define REMOTE_CACHE_MAX_QUEUED (256L * 1024 * 1024) // Object bytes waiting for upload before further stores are dropped
+#define REMOTE_CACHE_MAX_ENTRY (1L << 30)           // Largest entry downloaded or accepted
+
+/**
+ * @brief IRemoteCache interface.
+ * @details Provides an interface for looking up, downloading and uploading entries of an HTTP cache.
+ */
+typedef struct IRemoteCache {
+   /**
+    * @brief Opens the remote cache (nothing is sent until an entry is needed).
+    * @param url :the cache URL, `http://host[:port][/path]`
+    * @return :1 if the URL is usable; otherwise, 0
+    */
+   int (*open)(const char *);
+   /**
+    * @brief Checks whether the cache holds an entry, without downloading it.
+    * @param key :the entry's key
+    * @return :1 if the entry exists; otherwise, 0
+    */
+   int (*contains)(const char *);
+   /**
+    * @brief Downloads an entry, verifying the object against the digest it was stored with.
+    * @param key :the entry's key
+    * @param path :the file to write the object to
+    * @return :1 on a hit; otherwise, 0 (nothing is left at path)
+    */
+   int (*fetch)(const char *, const char *);
+   /**
+    * @brief Queues an object for upload (the file is read now; it may change once this returns).
+    * @param key :the entry's key
+    * @param path :the object
+    * @return :1 if queued; otherwise, 0
+    */
+   int (*store)(const char *, const char *);
+   /**
+    * @brief Finishes the queued uploads and closes the remote cache.
+    */
+   void (*close)(void);
+   /**
+    * @brief Serves a directory as an HTTP cache until the process is stopped.
+    * @param dir :the directory holding the entries (NULL or empty: `$XDG_CACHE_HOME` or `~/.cache`, then REMOTE_CACHE_DIR)
+    * @param port :the TCP port to listen on
+    * @return :non-zero if the directory or port cannot be served
+    */
+   int (*serve)(const char *, int);
+} IRemoteCache;
+
+extern const IRemoteCache RemoteCache;
+
+#endif // REMOTE_CACHE_H
@@ -0,0 +1,194 @@
+/* src/core/server.c
+ * Sigma.Build Build Server
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * The socket is a SOCK_SEQPACKET socket, so a request is one message: the client's working
+ * directory and arguments as consecutive NUL-terminated strings, with its stdout and stderr
+ * passed as SCM_RIGHTS; the reply is one message holding the exit status. The server sleeps in
+ * the executor's wait loop (the listening socket is its watched descriptor) so interrupts stop
+ * it cleanly; during a request the client's socket is watched instead, and its hang-up wakes
+ * the build. The socket is only accessible to its owner, and peers of another user are turned
+ * away (SO_PEERCRED) without a reply.
+ */
+#define _GNU_SOURCE
+#include "server.h"
+#include "executor.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_BACKLOG 16
+#define SERVER_RECEIVE_TIMEOUT_S 2
+
+/* Fill a socket address; returns 0 if the path does not fit */
+static int server_address(const char *path, struct sockaddr_un *addr) {
+   memset(addr, 0, sizeof(*addr));
+   addr->sun_family = AF_UNIX;
+   if (strlen(path) >= sizeof(addr->sun_path)) return SB_FALSE;
+   strcpy(addr->sun_path, path);
+   return SB_TRUE;
+}
+/* Connect to a server; returns the socket, or -1 if none answers */
+static int server_connect(const char *path) {
+   struct sockaddr_un addr;
+   if (!server_address(path, &addr)) return -1;
+   int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+   if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) return fd;
+   if (fd >= 0) close(fd);
+   return -1;
+}
+/* Check that a client runs as our own user */
+static int server_is_own_peer(int client) {
+   struct ucred cred;
+   socklen_t len = sizeof(cred);
+   return getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+}
+/* Run one request with the client's stdout/stderr in place of ours, then reply with its status */
+static void server_handle(int client, ServerHandler handler) {
+   char *buffer = malloc(SERVER_MAX_REQUEST);
+   char control[CMSG_SPACE(2 * sizeof(int))];
+   struct iovec iov = {.iov_base = buffer, .iov_len = SERVER_MAX_REQUEST};
+   struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control)};
+   ssize_t len = buffer ? recvmsg(client, &msg, MSG_CMSG_CLOEXEC) : -1;
+
+   int fds[2] = {-1, -1};
+   struct cmsghdr *cmsg = len > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+   if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+      memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+   }
+
+   // Split the request: working directory, then the arguments
+   int32_t status = SERVER_DECLINED;
+   char **argv = NULL;
+   int argc = 0;
+   char cwd[4096];
+   int is_valid = len > 0 && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) && buffer[len - 1] == '\0' && fds[0] >= 0;
+   if (is_valid && getcwd(cwd, sizeof(cwd)) && strcmp(cwd, buffer) == 0) {
+      for (char *arg = buffer + strlen(buffer) + 1; arg < buffer + len; arg += strlen(arg) + 1) argc++;
+      argv = calloc(argc + 1, sizeof(char *));
+      argc = 0;
+      for (char *arg = buffer + strlen(buffer) + 1; argv && arg < buffer + len; arg += strlen(arg) + 1) argv[argc++] = arg;
+   }
+
+   if (argv && argc > 0) {
+      int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+      fflush(stdout);
+      fflush(stderr);
+      dup2(fds[0], STDOUT_FILENO);
+      dup2(fds[1], STDERR_FILENO);
+      Executor.watch(client); // A client that hangs up (e.g. on Ctrl-C) cancels its build
+      status = handler(argc, argv);
+      Executor.watch(-1);
+      fflush(stdout);
+      fflush(stderr);
+      dup2(saved_out, STDOUT_FILENO);
+      dup2(saved_err, STDERR_FILENO);
+      close(saved_out);
+      close(saved_err);
+   }
+   send(client, &status, sizeof(status), MSG_NOSIGNAL);
+
+   for (int i = 0; i < 2; i++) {
+      if (fds[i] >= 0) close(fds[i]);
+   }
+   free(argv);
+   free(buffer);
+}
+
+static int server_serve(const char *path, ServerHandler handler) {
+   struct sockaddr_un addr;
+   if (!path || !handler || !server_address(path, &addr)) return -1;
+
+   // A socket nobody answers on is left over from a server that died
+   int other = server_connect(path);
+   if (other >= 0) {
+      close(other);
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "A build server already serves this directory (%s)\n", path);
+      return -1;
+   }
+   unlink(path);
+   int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+   mode_t saved_umask = umask(0177); // The socket is created 0600: nobody else may run builds as us
+   int is_bound = fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+   umask(saved_umask);
+   if (!is_bound || listen(fd, SERVER_BACKLOG) != 0 || !Executor.watch(fd)) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_ERROR, "Failed to serve %s: %s\n", path, strerror(errno));
+      if (fd >= 0) close(fd);
+      return -1;
+   }
+
+   Logger.writeln("Build server listening on %s (Ctrl-C to stop)", path);
+   while (!Executor.interrupted()) {
+      // No jobs run between requests: the wait returns on a connection (or an interrupt)
+      if (Executor.wait() || Executor.interrupted()) continue;
+      int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+      if (client < 0) continue;
+      if (!server_is_own_peer(client)) {
+         Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Refused a request from another user\n");
+         close(client);
+         continue;
+      }
+      struct timeval timeout = {.tv_sec = SERVER_RECEIVE_TIMEOUT_S};
+      setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // A silent client cannot stall the server
+      server_handle(client, handler);
+      close(client);
+      Executor.watch(fd);
+   }
+   Executor.watch(-1);
+   close(fd);
+   unlink(path);
+
+   return 0;
+}
+
+static int server_forward(const char *path, int argc, char **argv) {
+   char cwd[4096];
+   if (!getcwd(cwd, sizeof(cwd))) return SERVER_DECLINED;
+   size_t size = strlen(cwd) + 1;
+   for (int i = 0; i < argc; i++) size += strlen(argv[i]) + 1;
+   char *buffer = size <= SERVER_MAX_REQUEST ? malloc(size) : NULL;
+   int fd = buffer ? server_connect(path) : -1;
+   if (fd < 0) {
+      free(buffer);
+      return SERVER_DECLINED;
+   }
+
+   char *next = stpcpy(buffer, cwd) + 1;
+   for (int i = 0; i < argc; i++) next = stpcpy(next, argv[i]) + 1;
+   int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+   char control[CMSG_SPACE(sizeof(fds))];
+   memset(control, 0, sizeof(control));
+   struct iovec iov = {.iov_base = buffer, .iov_len = size};
+   struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control)};
+   struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level = SOL_SOCKET;
+   cmsg->cmsg_type = SCM_RIGHTS;
+   cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+   memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+   // Our own buffered output must come before the server's
+   fflush(stdout);
+   fflush(stderr);
+   // The status arrives once the build is done (nothing, if the server died: then the client builds itself)
+   int32_t status = SERVER_DECLINED;
+   ssize_t received = 0;
+   if (sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)size) {
+      do received = recv(fd, &status, sizeof(status), 0);
+      while (received < 0 && errno == EINTR);
+   }
+   if (received != sizeof(status)) status = SERVER_DECLINED;
+   close(fd);
+   free(buffer);
+
+   return status;
+}
+
+const IServer Server = {
+    .serve = server_serve,
+    .forward = server_forward,
+};
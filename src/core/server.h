@@ -0,0 +1,48 @@
+/* src/core/server.h
+ * Sigma.Build Build Server
+ * Serves builds from a resident process to thin clients over a Unix socket.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for the per-workspace build server. A client forwards its
+ * working directory and command line together with its own stdout and stderr descriptors; the
+ * server runs the request with those descriptors in place, so output reaches the client's
+ * terminal directly, and answers with the exit status. A client that goes away cancels its build.
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "sbuild.h"
+
+#define SERVER_SOCKET ".sbuild_server"  // Socket of the build server, in the workspace (working) directory
+#define SERVER_MAX_REQUEST (64 * 1024)  // Largest forwarded command line (with the working directory)
+#define SERVER_DECLINED -1              // Status of a request the server does not serve (the client builds itself)
+
+typedef int (*ServerHandler)(int, char **); // Request handler: argc, argv; returns the exit status or SERVER_DECLINED
+
+/**
+ * @brief IServer interface.
+ * @details Provides an interface for serving builds and forwarding them to a server.
+ */
+typedef struct IServer {
+   /**
+    * @brief Serves requests one at a time until interrupted (the executor must be initialized).
+    * @param path :the socket path
+    * @param handler :the function running each request
+    * @return :0 when interrupted; non-zero if the socket cannot be served (e.g. a server already runs)
+    */
+   int (*serve)(const char *, ServerHandler);
+   /**
+    * @brief Forwards a command line to the server and waits for its exit status.
+    * @param path :the socket path
+    * @param argc :number of arguments
+    * @param argv :the arguments (argv[0] included)
+    * @return :the exit status, or SERVER_DECLINED if no server took the request
+    */
+   int (*forward)(const char *, int, char **);
+} IServer;
+
+extern const IServer Server;
+
+#endif // SERVER_H
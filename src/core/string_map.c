@@ -0,0 +1,110 @@
+/* src/core/string_map.c
+ * Sigma.Build String Map
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * Open addressing with linear probing; the table doubles at 75% load.
+ */
+#include "string_map.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STRING_MAP_MIN_SLOTS 64
+
+typedef struct map_slot_s {
+   char *key;     // Key (NULL if the slot is empty)
+   uint64_t hash; // Cached hash of the key
+   object value;  // Stored value
+} map_slot_s;
+
+typedef struct string_map_s {
+   map_slot_s *slots; // Slot array (power-of-two size)
+   size_t size;       // Number of slots
+   size_t count;      // Number of keys
+} string_map_s;
+
+/* Find the slot holding a key, or the empty slot it would occupy */
+static map_slot_s *map_find(StringMap map, const char *key, uint64_t hash) {
+   size_t mask = map->size - 1;
+   for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      map_slot_s *slot = &map->slots[i];
+      if (!slot->key || (slot->hash == hash && strcmp(slot->key, key) == 0)) return slot;
+   }
+}
+static int map_resize(StringMap map, size_t size) {
+   addr slots_addr;
+   if (!Resources.alloc(&slots_addr, size * sizeof(map_slot_s))) return SB_FALSE;
+
+   map_slot_s *old = map->slots;
+   size_t old_size = map->size;
+   map->slots = (map_slot_s *)slots_addr;
+   map->size = size;
+   for (size_t i = 0; i < old_size; i++) {
+      if (old[i].key) *map_find(map, old[i].key, old[i].hash) = old[i];
+   }
+   free(old);
+   return SB_TRUE;
+}
+
+static StringMap map_create(void) {
+   addr map_addr;
+   if (!Resources.alloc(&map_addr, sizeof(string_map_s))) return NULL;
+
+   StringMap map = (StringMap)map_addr;
+   if (!map_resize(map, STRING_MAP_MIN_SLOTS)) {
+      free(map);
+      return NULL;
+   }
+   return map;
+}
+
+static object map_get(StringMap map, const char *key) {
+   if (!map || !key) return NULL;
+
+   map_slot_s *slot = map_find(map, key, get_string_hash(key));
+   return slot->key ? slot->value : NULL;
+}
+
+static int map_put(StringMap map, const char *key, object value) {
+   if (!map || !key) return SB_FALSE;
+   if ((map->count + 1) * 4 > map->size * 3 && !map_resize(map, map->size * 2)) return SB_FALSE;
+
+   uint64_t hash = get_string_hash(key);
+   map_slot_s *slot = map_find(map, key, hash);
+   if (!slot->key) {
+      slot->key = strdup(key);
+      if (!slot->key) return SB_FALSE;
+      slot->hash = hash;
+      map->count++;
+   }
+   slot->value = value;
+   return SB_TRUE;
+}
+
+static size_t map_count(StringMap map) {
+   return map ? map->count : 0;
+}
+
+static void map_each(StringMap map, StringMapVisitor visitor, object data) {
+   for (size_t i = 0; map && i < map->size; i++) {
+      if (map->slots[i].key) visitor(map->slots[i].key, map->slots[i].value, data);
+   }
+}
+
+static void map_dispose(StringMap map) {
+   if (!map) return;
+
+   for (size_t i = 0; i < map->size; i++) free(map->slots[i].key);
+   free(map->slots);
+   free(map);
+}
+
+const IStringMaps StringMaps = {
+    .create = map_create,
+    .get = map_get,
+    .put = map_put,
+    .count = map_count,
+    .each = map_each,
+    .dispose = map_dispose,
+};
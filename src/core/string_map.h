@@ -0,0 +1,67 @@
+/* src/core/string_map.h
+ * Sigma.Build String Map
+ * A string-keyed hash map used for lookups by path or name.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for creating and using string maps. Keys are copied
+ * into the map; values are caller-owned pointers.
+ */
+#ifndef STRING_MAP_H
+#define STRING_MAP_H
+
+#include "sbuild.h"
+
+struct string_map_s;                          // Forward declaration of StringMap structure
+typedef struct string_map_s *StringMap;       // StringMap is a pointer to the string_map_s structure
+typedef void (*StringMapVisitor)(const char *, object, object); // Visitor: key, value, caller data
+
+/**
+ * @brief IStringMaps interface.
+ * @details Provides an interface for open-addressed string maps.
+ */
+typedef struct IStringMaps {
+   /**
+    * @brief Creates an empty map.
+    * @return :the new map, or NULL if allocation failed
+    */
+   StringMap (*create)(void);
+   /**
+    * @brief Looks up a key.
+    * @param map :the map
+    * @param key :the key to look up
+    * @return :the value stored for the key, or NULL if absent
+    */
+   object (*get)(StringMap, const char *);
+   /**
+    * @brief Stores a value for a key, replacing any previous value.
+    * @param map :the map
+    * @param key :the key (copied)
+    * @param value :the value to store
+    * @return :1 if stored; otherwise, 0
+    */
+   int (*put)(StringMap, const char *, object);
+   /**
+    * @brief Gets the number of keys in the map.
+    * @param map :the map
+    * @return :the number of keys
+    */
+   size_t (*count)(StringMap);
+   /**
+    * @brief Visits every key/value pair (in no particular order).
+    * @param map :the map
+    * @param visitor :the function called for each pair
+    * @param data :caller data passed to the visitor
+    */
+   void (*each)(StringMap, StringMapVisitor, object);
+   /**
+    * @brief Disposes of the map and its keys (values are not freed).
+    * @param map :the map
+    */
+   void (*dispose)(StringMap);
+} IStringMaps;
+
+extern const IStringMaps StringMaps;
+
+#endif // STRING_MAP_H
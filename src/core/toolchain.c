@@ -0,0 +1,343 @@
+/* src/core/toolchain.c
+ * Sigma.Build Toolchain Probe
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * A compiler is asked once with `-v -E -dM -x c /dev/null`: stderr names its version, target
+ * and include search list, stdout lists its predefined macros. Answers are cached as
+ * `<path>\t<inode>\t<mtime_ns>\t<size>\t<binary_hash>\t<macros_hash>\t<triple>\t<version>[\t<dir>]...`
+ * lines. A cached answer is reused while the binary's inode, mtime and size are unchanged; when
+ * they differ the binary is hashed, and only a different hash runs the compiler again.
+ */
+#define _GNU_SOURCE
+#include "toolchain.h"
+#include "string_map.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TOOLCHAIN_CACHE_HEADER "# sbuild toolchains v1"
+#define PROBE_INCLUDES_BEGIN "#include <...> search starts here:"
+#define PROBE_INCLUDES_END "End of search list."
+#define PROBE_MAX_OUTPUT (4 * 1024 * 1024) // Stop reading a probe that prints more than this
+
+extern char **environ;
+
+static StringMap probed = NULL;          // Compiler as configured -> toolchain
+static StringMap cached = NULL;          // Resolved binary path -> toolchain (as in the cache file)
+static toolchain_s **toolchains = NULL;  // Every toolchain created (owned here)
+static int toolchain_count = 0;          // Number of toolchains created
+static int is_loaded = 0;                // Set once the cache file was read
+
+static void toolchain_cleanup(void);
+
+/* FNV-1a over a block of bytes, continuing from `hash` */
+static uint64_t toolchain_hash_bytes(uint64_t hash, const void *data, size_t size) {
+   const unsigned char *bytes = data;
+   for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+   return hash;
+}
+/* Hash a file's contents */
+static int toolchain_hash_file(const char *path, uint64_t *hash) {
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) close(fd);
+      return SB_FALSE;
+   }
+
+   *hash = 14695981039346656037ULL;
+   void *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+   close(fd);
+   if (data == MAP_FAILED) return SB_FALSE;
+   if (data) {
+      *hash = toolchain_hash_bytes(*hash, data, st.st_size);
+      munmap(data, st.st_size);
+   }
+   return SB_TRUE;
+}
+/* Resolve a compiler to the binary that runs: paths as given, bare names through PATH */
+static int toolchain_resolve(const char *compiler, char *path, size_t size) {
+   char resolved[PATH_MAX]; // What realpath() writes
+   int is_resolved = strchr(compiler, '/') && realpath(compiler, resolved);
+
+   const char *dirs = getenv("PATH");
+   for (const char *dir = dirs ? dirs : "/usr/bin:/bin"; !strchr(compiler, '/') && !is_resolved && *dir;) {
+      size_t len = strcspn(dir, ":");
+      char candidate[PATH_MAX];
+      snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)(len ? len : 1), len ? dir : ".", compiler);
+      is_resolved = access(candidate, X_OK) == 0 && realpath(candidate, resolved);
+      dir += len + (dir[len] == ':');
+   }
+   if (!is_resolved || strlen(resolved) >= size) return SB_FALSE;
+   strcpy(path, resolved);
+   return SB_TRUE;
+}
+/* Path of the probe cache (`$XDG_CACHE_HOME` or `~/.cache`); returns 0 if there is no home */
+static int toolchain_cache_path(char *dir, size_t size, char *file, size_t file_size) {
+   const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+   if (xdg && *xdg) {
+      snprintf(dir, size, "%s/" TOOLCHAIN_CACHE_DIR, xdg);
+   } else if (home && *home) {
+      snprintf(dir, size, "%s/.cache/" TOOLCHAIN_CACHE_DIR, home);
+   } else {
+      return SB_FALSE;
+   }
+   snprintf(file, file_size, "%s" TOOLCHAIN_CACHE_FILE, dir);
+   return SB_TRUE;
+}
+
+/* Create an empty toolchain for a binary */
+static toolchain_s *toolchain_new(const char *path) {
+   addr tc_addr;
+   toolchain_s **grown = realloc(toolchains, (toolchain_count + 1) * sizeof(toolchain_s *));
+   if (!grown) return NULL;
+   toolchains = grown;
+   if (!Resources.alloc(&tc_addr, sizeof(toolchain_s))) return NULL;
+
+   toolchain_s *tc = (toolchain_s *)tc_addr;
+   if (!(tc->path = strdup(path))) {
+      free(tc);
+      return NULL;
+   }
+   toolchains[toolchain_count++] = tc;
+   return tc;
+}
+/* Append a builtin include directory */
+static int toolchain_add_dir(toolchain_s *tc, const char *dir) {
+   int count = 0;
+   for (char **existing = tc->include_dirs; existing && *existing; existing++) count++;
+   char **grown = realloc(tc->include_dirs, (count + 2) * sizeof(char *));
+   if (!grown) return SB_FALSE;
+   tc->include_dirs = grown;
+   grown[count + 1] = NULL;
+
+   return (grown[count] = strdup(dir)) != NULL;
+}
+/* Combine everything known about a toolchain into its fingerprint */
+static void toolchain_fingerprint(toolchain_s *tc) {
+   uint64_t hash = toolchain_hash_bytes(14695981039346656037ULL, &tc->binary_hash, sizeof(tc->binary_hash));
+   hash = toolchain_hash_bytes(hash, &tc->macros_hash, sizeof(tc->macros_hash));
+   hash = toolchain_hash_bytes(hash, tc->version, strlen(tc->version) + 1);
+   hash = toolchain_hash_bytes(hash, tc->triple, strlen(tc->triple) + 1);
+   for (char **dir = tc->include_dirs; dir && *dir; dir++) hash = toolchain_hash_bytes(hash, *dir, strlen(*dir) + 1);
+   tc->fingerprint = hash;
+}
+/* Run the compiler's probe and collect its combined output; returns NULL if it could not run */
+static char *toolchain_run(const char *path) {
+   // Untranslated messages: the include search list is found by its English markers
+   int env_count = 0;
+   for (char **var = environ; var && *var; var++) env_count++;
+   char **env = calloc(env_count + 2, sizeof(char *));
+   int fds[2];
+   if (!env || pipe2(fds, O_CLOEXEC) != 0) {
+      free(env);
+      return NULL;
+   }
+   int count = 0;
+   env[count++] = "LC_ALL=C";
+   for (char **var = environ; var && *var; var++) {
+      if (strncmp(*var, "LC_ALL=", 7) != 0) env[count++] = *var;
+   }
+
+   char *argv[] = {(char *)path, "-v", "-E", "-dM", "-x", "c", "/dev/null", NULL};
+   posix_spawn_file_actions_t actions;
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+   posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+   posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+   pid_t pid;
+   int spawned = posix_spawn(&pid, path, &actions, NULL, argv, env) == 0;
+   posix_spawn_file_actions_destroy(&actions);
+   close(fds[1]);
+   free(env);
+
+   size_t size = 0, cap = 0;
+   char *output = NULL;
+   while (spawned) {
+      if (size + 4096 + 1 > cap) {
+         char *grown = cap < PROBE_MAX_OUTPUT ? realloc(output, cap = cap ? cap * 2 : 16384) : NULL;
+         if (!grown) break;
+         output = grown;
+      }
+      ssize_t n = read(fds[0], output + size, cap - size - 1);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      size += n;
+   }
+   close(fds[0]);
+   while (spawned && waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+
+   if (output) output[size] = '\0';
+   return output;
+}
+/* Ask the compiler for its version, target, include directories and predefined macros */
+static int toolchain_ask(toolchain_s *tc) {
+   char *output = toolchain_run(tc->path);
+   char *version = NULL, *triple = NULL, *save = NULL;
+   int is_include = 0, is_added = SB_TRUE;
+   tc->macros_hash = 14695981039346656037ULL;
+   for (char *line = output ? strtok_r(output, "\n", &save) : NULL; line && is_added; line = strtok_r(NULL, "\n", &save)) {
+      size_t len = strlen(line);
+      while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\r')) line[--len] = '\0';
+      if (strncmp(line, "#define ", 8) == 0) {
+         tc->macros_hash = toolchain_hash_bytes(tc->macros_hash, line, len + 1);
+      } else if (strncmp(line, "Target: ", 8) == 0) {
+         triple = line + 8;
+      } else if (!version && strstr(line, " version ")) {
+         version = line;
+      } else if (strcmp(line, PROBE_INCLUDES_BEGIN) == 0) {
+         is_include = 1;
+      } else if (strcmp(line, PROBE_INCLUDES_END) == 0) {
+         is_include = 0;
+      } else if (is_include && line[0] == ' ') {
+         is_added = toolchain_add_dir(tc, line + 1);
+      }
+   }
+   tc->version = strdup(version ? version : "");
+   tc->triple = strdup(triple ? triple : "");
+   free(output);
+   if (!tc->version || !tc->triple || !is_added) return SB_FALSE;
+
+   Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_DEBUG, "Probed %s: %s (%s)\n", tc->path,
+                *tc->version ? tc->version : "no version", *tc->triple ? tc->triple : "unknown target");
+   toolchain_fingerprint(tc);
+   return SB_TRUE;
+}
+
+/* Read the probe cache */
+static void toolchain_load_cache(void) {
+   is_loaded = 1;
+   char dir[4096], path[4096];
+   FILE *file = toolchain_cache_path(dir, sizeof(dir), path, sizeof(path)) ? fopen(path, "r") : NULL;
+   if (!file) return;
+
+   char *line = NULL;
+   size_t cap = 0;
+   ssize_t n = getline(&line, &cap, file);
+   int is_current = n > 0 && strncmp(line, TOOLCHAIN_CACHE_HEADER, strlen(TOOLCHAIN_CACHE_HEADER)) == 0;
+   while (is_current && (n = getline(&line, &cap, file)) > 0) {
+      if (line[n - 1] == '\n') line[n - 1] = '\0';
+      char *fields[8], *rest = line;
+      int count = 0;
+      while (count < 8 && rest) fields[count++] = strsep(&rest, "\t");
+      if (count < 8) continue;
+
+      toolchain_s *tc = toolchain_new(fields[0]);
+      if (!tc) break;
+      tc->inode = strtoull(fields[1], NULL, 10);
+      tc->mtime_ns = strtoll(fields[2], NULL, 10);
+      tc->size = strtoll(fields[3], NULL, 10);
+      tc->binary_hash = strtoull(fields[4], NULL, 16);
+      tc->macros_hash = strtoull(fields[5], NULL, 16);
+      tc->triple = strdup(fields[6]);
+      tc->version = strdup(fields[7]);
+      for (char *dir_field; (dir_field = strsep(&rest, "\t"));) toolchain_add_dir(tc, dir_field);
+      if (!tc->triple || !tc->version) continue;
+      toolchain_fingerprint(tc);
+      StringMaps.put(cached, tc->path, tc);
+   }
+   free(line);
+   fclose(file);
+}
+/* Map visitor: write one cache line */
+static void toolchain_write_entry(const char *path, object value, object data) {
+   toolchain_s *tc = value;
+   FILE *file = data;
+   fprintf(file, "%s\t%llu\t%lld\t%lld\t%016llx\t%016llx\t%s\t%s", path, (unsigned long long)tc->inode,
+           (long long)tc->mtime_ns, (long long)tc->size, (unsigned long long)tc->binary_hash,
+           (unsigned long long)tc->macros_hash, tc->triple, tc->version);
+   for (char **dir = tc->include_dirs; dir && *dir; dir++) fprintf(file, "\t%s", *dir);
+   fputc('\n', file);
+}
+/* Rewrite the probe cache (through a temp file, so concurrent builds never read half of it) */
+static void toolchain_save_cache(void) {
+   char dir[4096], path[4096], tmp_path[4200];
+   if (!toolchain_cache_path(dir, sizeof(dir), path, sizeof(path)) || !Files.make_dirs(dir)) return;
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+   FILE *file = fopen(tmp_path, "w");
+   if (!file) return;
+   fprintf(file, "%s\n", TOOLCHAIN_CACHE_HEADER);
+   StringMaps.each(cached, toolchain_write_entry, file);
+   if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+      Logger.debug(stderr, LOG_NORMAL, DBG_WARNING, "Failed to write toolchain cache: %s\n", path);
+      unlink(tmp_path);
+   }
+}
+
+/* Check whether a toolchain's binary is as it was when probed */
+static int toolchain_is_unchanged(const toolchain_s *tc, const struct stat *st) {
+   int64_t mtime_ns = (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+   return tc->inode == (uint64_t)st->st_ino && tc->mtime_ns == mtime_ns && tc->size == (int64_t)st->st_size;
+}
+
+/* Probe a compiler: memory first, then the cache while the binary is unchanged, then the compiler itself */
+static Toolchain toolchain_probe(const char *compiler) {
+   if (!compiler || !*compiler) return NULL;
+   if (!probed && (!(probed = StringMaps.create()) || !(cached = StringMaps.create()))) return NULL;
+   // A resident server outlives compiler upgrades: a remembered answer holds while its binary is unchanged
+   struct stat st;
+   toolchain_s *tc = StringMaps.get(probed, compiler);
+   if (tc && stat(tc->path, &st) == 0 && toolchain_is_unchanged(tc, &st)) return tc;
+   if (!is_loaded) toolchain_load_cache();
+
+   char path[PATH_MAX];
+   if (!toolchain_resolve(compiler, path, sizeof(path)) || stat(path, &st) != 0) {
+      Logger.debug(Logger.log_stream(), LOG_VERBOSE, DBG_WARNING, "Compiler not found: %s\n", compiler);
+      return NULL;
+   }
+   int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+   tc = StringMaps.get(cached, path);
+   if (!tc || !toolchain_is_unchanged(tc, &st)) {
+      // Touched or replaced: only a different binary is asked again
+      uint64_t hash;
+      if (!toolchain_hash_file(path, &hash)) return NULL;
+      if (!tc || tc->binary_hash != hash) {
+         if (!(tc = toolchain_new(path))) return NULL;
+         tc->binary_hash = hash;
+         if (!toolchain_ask(tc) || !StringMaps.put(cached, path, tc)) return NULL;
+      }
+      tc->inode = st.st_ino;
+      tc->mtime_ns = mtime_ns;
+      tc->size = st.st_size;
+      toolchain_save_cache();
+   }
+
+   return StringMaps.put(probed, compiler, tc) ? tc : NULL;
+}
+
+/* Release every toolchain */
+static void toolchain_cleanup(void) {
+   for (int i = 0; i < toolchain_count; i++) {
+      toolchain_s *tc = toolchains[i];
+      free(tc->path);
+      free(tc->version);
+      free(tc->triple);
+      for (char **dir = tc->include_dirs; dir && *dir; dir++) free(*dir);
+      free(tc->include_dirs);
+      free(tc);
+   }
+   free(toolchains);
+   toolchains = NULL;
+   toolchain_count = 0;
+   StringMaps.dispose(probed);
+   StringMaps.dispose(cached);
+   probed = cached = NULL;
+   is_loaded = 0;
+}
+
+const IToolchains Toolchains = {
+    .probe = toolchain_probe,
+    .cleanup = toolchain_cleanup,
+};
@@ -0,0 +1,54 @@
+/* src/core/toolchain.h
+ * Sigma.Build Toolchain Probe
+ * Identifies compilers and what they build with, caching the answer between invocations.
+ *
+ * David Boarman
+ * 2026-10-18
+ *
+ * This file provides an interface for probing compilers. A compiler is resolved through PATH
+ * and fingerprinted by the inode, mtime, size and content hash of its binary; its version,
+ * target triple, builtin include directories and predefined macros are asked once and kept in
+ * the user cache directory until the binary changes.
+ */
+#ifndef TOOLCHAIN_H
+#define TOOLCHAIN_H
+
+#include "sbuild.h"
+
+#define TOOLCHAIN_CACHE_DIR "sbuild/"        // Directory inside the user cache directory
+#define TOOLCHAIN_CACHE_FILE "toolchains"    // Probe cache file name inside TOOLCHAIN_CACHE_DIR
+
+typedef struct toolchain_s {
+   string path;          // Resolved path of the compiler binary
+   uint64_t inode;       // Inode of the binary when probed
+   int64_t mtime_ns;     // Modification time of the binary when probed
+   int64_t size;         // Size of the binary when probed
+   uint64_t binary_hash; // Hash of the binary's contents
+   string version;       // Version line reported by the compiler (empty if it did not answer)
+   string triple;        // Target triple (empty if unknown)
+   string *include_dirs; // Builtin include directories (NULL-terminated)
+   uint64_t macros_hash; // Hash of the predefined macros
+   uint64_t fingerprint; // Identity of everything above: equal fingerprints compile alike
+} toolchain_s;
+typedef const toolchain_s *Toolchain;
+
+/**
+ * @brief IToolchains interface.
+ * @details Provides an interface for probing compilers.
+ */
+typedef struct IToolchains {
+   /**
+    * @brief Probes a compiler, answering from memory or the cache while its binary is unchanged.
+    * @param compiler :the compiler as configured (a path, or a name looked up in PATH)
+    * @return :the toolchain, or NULL if the compiler cannot be found
+    */
+   Toolchain (*probe)(const char *);
+   /**
+    * @brief Releases the probed toolchains.
+    */
+   void (*cleanup)(void);
+} IToolchains;
+
+extern const IToolchains Toolchains;
+
+#endif // TOOLCHAIN_H
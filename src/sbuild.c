@@ -11,12 +11,17 @@
 #include "sbuild.h"
 #include "core/builder.h"
 #include "core/cli_parser.h"
+#include "core/executor.h"
 #include "core/loader.h"
+#include "core/remote_cache.h"
+#include "core/server.h"
 #include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #define SIGMABUILD_VERSION "0.00.03.001"
 #define SIGMABUILD_NAME "Sigma.Build"
@@ -30,6 +35,14 @@ void cli_init_context(void);
 void cli_init_state(int, char **);
 int cli_load_config(void);
 void cli_run(void);
+static void cli_default_options(CLIOptions);
+static void cli_dispose_options(CLIOptions);
+static int cli_select_targets(BuildTarget **);
+static void cli_report_build_failure(int);
+static int cli_serve_request(int, char **);
+static int cli_is_servable(CLIOptions);
+static int cli_is_same_value(const char *, const char *);
+static int cli_reload_config(void);
 static void cli_cleanup(void);
 const char *cli_get_err_msg(CLIErrorCode);
 void cli_display_help(void);
@@ -51,6 +64,7 @@ void resources_dispose_target(BuildTarget);
 
 // Files declarations
 size_t files_read_file(const char *, char **);
+int files_make_dirs(const char *);
 
 // For dynamic log level annotation
 static const char *DEBUG_LEVELS[] = {
@@ -68,6 +82,29 @@ void get_timestamp(char *buffer, const char *format) {
    time_t now = time(NULL);
    strftime(buffer, 32, format, localtime(&now));
 }
+// Function to get the current monotonic time in milliseconds
+long get_monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+// Function to hash a string (64-bit FNV-1a)
+uint64_t get_string_hash(const char *str) {
+   uint64_t hash = 1469598103934665603ULL;
+   for (; str && *str; str++) hash = (hash ^ (unsigned char)*str) * 1099511628211ULL;
+   return hash;
+}
+// Hash an argument vector (FNV-1a over each argument and its terminator)
+uint64_t get_argv_hash(char **argv) {
+   uint64_t hash = 1469598103934665603ULL;
+   for (; argv && *argv; argv++) {
+      for (const char *c = *argv;; c++) {
+         hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+         if (!*c) break;
+      }
+   }
+   return hash;
+}
 // Function to get the target configuration by name
 BuildTarget get_target(const char *name) {
    if (!context || !context->config || !context->config->targets) {
@@ -84,6 +121,37 @@ BuildTarget get_target(const char *name) {
    return NULL; // Return NULL if target not found
 }
 
+// Check whether the configuration defines a variant
+static int cli_is_variant(const char *variant) {
+   for (char **name = context->config->variants; name && *name; name++) {
+      if (strcmp(*name, variant) == 0) return 1;
+   }
+   return 0;
+}
+// Check whether a target belongs to a variant selected with --variant (targets without a variant always do)
+static int cli_is_variant_selected(BuildTarget target) {
+   if (!target->variant || !cli_state->options->variant_names) return 1;
+   for (char **name = cli_state->options->variant_names; *name; name++) {
+      if (strcmp(*name, target->variant) == 0) return 1;
+   }
+   return 0;
+}
+// Add the variant targets `<name>@<variant>` of every selected variant; returns the number added
+static int cli_add_variant_targets(const char *name, BuildTarget *targets, int *count) {
+   int added = 0;
+   size_t len = strlen(name);
+   for (BuildTarget *target = context->config->targets; target && *target; target++) {
+      const char *qualified = (*target)->name;
+      if ((*target)->variant && strncmp(qualified, name, len) == 0 &&
+          strncmp(qualified + len, TARGET_VARIANT_SEPARATOR, strlen(TARGET_VARIANT_SEPARATOR)) == 0 &&
+          strcmp(qualified + len + strlen(TARGET_VARIANT_SEPARATOR), (*target)->variant) == 0 && cli_is_variant_selected(*target)) {
+         targets[(*count)++] = *target;
+         added++;
+      }
+   }
+   return added;
+}
+
 // CLI App Functions
 // This function initializes the CLI state with the provided arguments
 void cli_init(int argc, char **args) {
@@ -108,6 +176,13 @@ void cli_init(int argc, char **args) {
    context->log_level = cli_state->options->log_level;     // Set log level from options
    context->debug_level = cli_state->options->debug_level; // Set debug level from options
    context->log_stream = cli_state->options->log_stream;   // Set log stream based on verbosity
+   context->max_jobs = cli_state->options->max_jobs;       // Set parallel job count from options
+   context->max_failures = cli_state->options->max_failures; // Set failure policy from options
+   context->watchdog = cli_state->options->watchdog;           // Set watchdog factor from options
+   context->is_git_index = cli_state->options->is_git_index;   // Set change detection from options
+   context->cache_dir = cli_state->options->cache_dir;         // Set the object cache from options
+   context->remote_cache = cli_state->options->remote_cache;   // Set the remote cache from options
+   context->is_lazy_objects = cli_state->options->is_lazy_objects; // Set object materialization from options
    context->project_name = SIGMABUILD_NAME;                // Set default project name
 }
 // This function initializes the build context with default values
@@ -144,14 +219,31 @@ void cli_init_state(int argc, char **args) {
       exit(EXIT_FAILURE);
    }
    cli_state->options = (CLIOptions)options_addr; // Cast the allocated address to CLIOptions
-   // Initialize CLI options with default values
-   cli_state->options->show_help = 0;
-   cli_state->options->show_about = 0;
-   cli_state->options->log_level = LOG_NORMAL; // Default log level
-   cli_state->options->debug_level = DBG_INFO; // Default debug level
-   cli_state->options->is_verbose = 0;         // Verbose logging is off by default
-   cli_state->options->log_stream = stdout;    // Default log stream is stdout
-   cli_state->error = CLI_SUCCESS;             // Initialize error code to success
+   cli_default_options(cli_state->options);
+   cli_state->error = CLI_SUCCESS; // Initialize error code to success
+}
+// Initialize CLI options with default values
+static void cli_default_options(CLIOptions options) {
+   options->show_help = 0;
+   options->show_about = 0;
+   options->log_level = LOG_NORMAL; // Default log level
+   options->debug_level = DBG_INFO; // Default debug level
+   options->is_verbose = 0;         // Verbose logging is off by default
+   options->max_failures = 1;       // Fail fast by default
+   options->watchdog = 3;           // Report actions running 3x longer than usual
+   options->log_stream = stdout;    // Default log stream is stdout
+}
+// Free CLI options and the strings they own
+static void cli_dispose_options(CLIOptions options) {
+   free(options->config_file);
+   free(options->file_path);
+   free(options->cache_dir);
+   free(options->remote_cache);
+   for (char **name = options->target_names; name && *name; name++) free(*name);
+   free(options->target_names);
+   for (char **name = options->variant_names; name && *name; name++) free(*name);
+   free(options->variant_names);
+   free(options);
 }
 // Load the configuration file specified in the command line options
 int cli_load_config(void) {
@@ -197,28 +289,186 @@ void cli_run(void) {
       cli_display_about();
       return;
    }
+   // Serving a cache directory needs no configuration
+   CLIOptions options = cli_state->options;
+   if (options->cache_port) exit(RemoteCache.serve(options->cache_dir, options->cache_port) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+   // A build server in this directory answers plain builds: nothing is loaded here
+   if (!options->is_daemon && !options->is_watch && !options->is_pch_report && access(SERVER_SOCKET, F_OK) == 0) {
+      int status = Server.forward(SERVER_SOCKET, cli_state->argc, cli_state->argv);
+      if (status != SERVER_DECLINED) exit(status);
+   }
    // Load the configuration file if specified
    if (cli_load_config() != CLI_SUCCESS) {
       logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Failed to load configuration file: %s\n",
                      cli_get_err_msg(LOADER_ERR_LOAD_CONFIG));
       exit(EXIT_FAILURE);
    }
-   BuildConfig config = context->config; // Get the loaded configuration from the context
+   if (cli_state->options->is_daemon) {
+      // Serve builds until interrupted; each request names its own targets
+      if (Builder.init(context) != 0 || Builder.resident(SB_TRUE) != 0 || Server.serve(SERVER_SOCKET, cli_serve_request) != 0) {
+         exit(EXIT_FAILURE);
+      }
+      return;
+   }
 
-   // if we have a target in cli_options, override the default target
-   context->current_target = cli_state->options->target_name
-                                 ? cli_state->options->target_name
-                                 : config->default_target; // Set the default target from options
+   BuildTarget *targets = NULL;
+   int count = cli_select_targets(&targets);
+   if (count < 0) exit(EXIT_FAILURE);
+   const char *file_path = cli_state->options->file_path;
 
-   BuildTarget target = get_target(context->current_target);
-   if (!target) {
-      exit(EXIT_FAILURE); // Exit if the target is not found
-   } else if (Builder.build(target) != 0) {
-      logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "%s: %s\n",
-                     cli_get_err_msg(BUILD_ERR_BUILD_TARGET), target->name);
-      exit(EXIT_FAILURE); // Exit if any build target fails
+   int result = -1;
+   if (count > 0 && Builder.init(context) == 0) {
+      if (cli_state->options->is_pch_report) {
+         result = Builder.report_headers(targets);
+      } else if (cli_state->options->is_watch) {
+         result = Builder.watch(targets, file_path);
+      } else {
+         result = file_path ? Builder.build_file(targets, file_path) : Builder.build(targets);
+      }
+   }
+   free(targets);
+   if (result == BUILDER_WATCH_RELOAD) {
+      // The graph depends on the config: start over from the new one (the build log carries the state across)
+      logger_writelnf("Configuration changed: reloading %s", context->config_file);
+      Builder.cleanup();
+      fflush(NULL);
+      execv("/proc/self/exe", cli_state->argv);
+      logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Failed to restart: %s\n", strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+   if (result != 0) {
+      cli_report_build_failure(count);
+      // Interrupted builds exit like the signal would have, after cleanup has flushed the build log
+      exit(Executor.interrupted() ? 128 + Executor.interrupted() : EXIT_FAILURE);
    }
 }
+// Resolve the requested targets into a new NULL-terminated array; returns their count, or -1 on error
+static int cli_select_targets(BuildTarget **selected) {
+   BuildConfig config = context->config;
+
+   // Targets named on the command line override the default target; all are built in one job pool
+   char *default_names[] = {config->default_target, NULL};
+   char **names = cli_state->options->target_names ? cli_state->options->target_names : default_names;
+   for (char **variant = cli_state->options->variant_names; variant && *variant; variant++) {
+      if (!cli_is_variant(*variant)) {
+         logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Unknown variant: %s\n", *variant);
+         return -1;
+      }
+   }
+   // A name stands for its target in every selected variant, so it may expand to several targets
+   int count = 0, capacity = 0;
+   for (BuildTarget *target = config->targets; target && *target; target++) capacity++;
+   while (names[count]) count++;
+   capacity = capacity * (count + 1) + count;
+   addr targets_addr;
+   if (!Resources.alloc(&targets_addr, (capacity + 1) * sizeof(BuildTarget))) {
+      return -1; // Nothing to build
+   }
+   BuildTarget *targets = (BuildTarget *)targets_addr;
+   if (cli_state->options->file_path && !cli_state->options->target_names) {
+      // A file given without targets may belong to any target that compiles sources
+      count = 0;
+      for (BuildTarget *target = config->targets; target && *target; target++) {
+         if (strcmp((*target)->type, TARGET_TYPE_OP) != 0 && cli_is_variant_selected(*target)) targets[count++] = *target;
+      }
+   } else {
+      count = 0;
+      for (int i = 0; names[i]; i++) {
+         if (cli_add_variant_targets(names[i], targets, &count) > 0) continue;
+         if (!(targets[count++] = get_target(names[i]))) {
+            logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Target not found: %s\n", names[i]);
+            free(targets);
+            return -1; // A target is not found
+         }
+      }
+   }
+   context->current_target = count > 0 ? targets[0]->name : NULL;
+
+   *selected = targets;
+   return count;
+}
+// Report a failed build of the requested targets (or file)
+static void cli_report_build_failure(int count) {
+   const char *file_path = cli_state->options->file_path;
+   logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "%s: %s%s\n", cli_get_err_msg(BUILD_ERR_BUILD_TARGET),
+                  file_path ? file_path : context->current_target ? context->current_target : "",
+                  !file_path && count > 1 ? " (and other requested targets)" : "");
+}
+// Check whether a forwarded request can run in the resident context. Targets, variants, --file, the log level and the
+// failure policy apply to the request alone; every other option is fixed when the server starts (its executor, change
+// detection and cache), so it must be the server's own. A new option belongs on one side or the other.
+static int cli_is_servable(CLIOptions options) {
+   CLIOptions served = cli_state->options;
+   if (options->show_help || options->show_about || options->is_watch || options->is_daemon || options->is_pch_report ||
+       options->cache_port) {
+      return SB_FALSE; // Not a build
+   }
+   return options->config_file && strcmp(options->config_file, context->config_file) == 0 &&
+          options->max_jobs == served->max_jobs && options->watchdog == served->watchdog &&
+          options->is_git_index == served->is_git_index && cli_is_same_value(options->cache_dir, served->cache_dir) &&
+          cli_is_same_value(options->remote_cache, served->remote_cache) && options->is_lazy_objects == served->is_lazy_objects;
+}
+// Compare two optional string options (NULL: not given)
+static int cli_is_same_value(const char *value, const char *served) {
+   return value == served || (value && served && strcmp(value, served) == 0);
+}
+// Run one build forwarded to the build server: the request's own options against the resident config
+static int cli_serve_request(int argc, char **argv) {
+   addr options_addr;
+   CLIErrorCode error = CLI_ERR_PARSE_FAILED;
+   if (!resources_alloc(&options_addr, sizeof(struct cli_options_s))) return SERVER_DECLINED;
+   CLIOptions options = (CLIOptions)options_addr;
+   cli_default_options(options);
+   CLI.parse_args(argc, argv, &options, &error);
+
+   // Only plain builds of the served config, with the server's own settings, are served; anything else runs in the client
+   int status = SERVER_DECLINED;
+   if (error != CLI_SUCCESS || !cli_is_servable(options)) {
+      cli_dispose_options(options);
+      return status;
+   }
+
+   // The request's options stand in for the server's own while it runs
+   CLIOptions served = cli_state->options;
+   LogLevel log_level = context->log_level;
+   DebugLevel debug_level = context->debug_level;
+   int max_failures = context->max_failures;
+   cli_state->options = options;
+   context->log_level = options->log_level;
+   context->debug_level = options->debug_level;
+   context->max_failures = options->max_failures;
+
+   BuildTarget *targets = NULL;
+   int count = Builder.refresh() == BUILDER_WATCH_RELOAD && cli_reload_config() != CLI_SUCCESS ? -1 : cli_select_targets(&targets);
+   int result = -1;
+   if (count > 0) result = options->file_path ? Builder.build_file(targets, options->file_path) : Builder.build(targets);
+   if (result != 0 && count >= 0) cli_report_build_failure(count);
+   status = result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+   free(targets);
+   cli_state->options = served;
+   context->log_level = log_level;
+   context->debug_level = debug_level;
+   context->max_failures = max_failures;
+   cli_dispose_options(options);
+   return status;
+}
+// Reload the served config after it changed; the resident build state starts over from it
+static int cli_reload_config(void) {
+   addr config_addr;
+   if (!resources_alloc(&config_addr, sizeof(struct build_config_s))) return LOADER_ERR_LOAD_CONFIG;
+   BuildConfig config = (BuildConfig)config_addr;
+   if (!Loader.load_config(context->config_file, &config) || !config->targets) {
+      // Kept pending: the next request tries again (the file may be mid-save)
+      logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Failed to reload configuration from file: %s\n", context->config_file);
+      if (config) resources_dispose_config(config);
+      return LOADER_ERR_LOAD_CONFIG;
+   }
+   Builder.resident(SB_FALSE); // The graph points into the old config
+   resources_dispose_config(context->config);
+   context->config = config;
+   return Builder.resident(SB_TRUE) == 0 ? CLI_SUCCESS : LOADER_ERR_LOAD_CONFIG;
+}
 // Cleanup function to free resources allocated during the CLI initialization
 static void cli_cleanup(void) {
    static int is_disposed = 0; // Flag to ensure cleanup is only done once
@@ -243,21 +493,14 @@ static void cli_cleanup(void) {
 
    if (cli_state) {
       if (cli_state->options) {
-         if (cli_state->options->config_file) {
-            free(cli_state->options->config_file);
-            cli_state->options->config_file = NULL;
-         }
-         if (cli_state->options->target_name) {
-            free(cli_state->options->target_name);
-            cli_state->options->target_name = NULL;
-         }
-         free(cli_state->options);
+         cli_dispose_options(cli_state->options);
          cli_state->options = NULL; // Set to NULL after freeing
       }
       free(cli_state);
       cli_state = NULL; // Set to NULL after freeing
    }
 
+   Builder.cleanup();
    Loader.cleanup();
 
    is_disposed = 1; // Set the flag to indicate cleanup has been done
@@ -311,15 +554,31 @@ void cli_display_help(void) {
    app = app ? app + 1 : cli_state->argv[0]; // Get the application name from the path
    // Build options string
    char options[128];
-   snprintf(options, sizeof(options), "[%s]|[%s]|[%s <file>]|[%s0-2]",
-            OPT_SHOW_HELP, OPT_SHOW_ABOUT, OPT_BUILD_CONFIG, OPT_LOG_LEVEL);
+   snprintf(options, sizeof(options), "[%s]|[%s]|[%s <file>]|[%s0-2]|[%s N]",
+            OPT_SHOW_HELP, OPT_SHOW_ABOUT, OPT_BUILD_CONFIG, OPT_LOG_LEVEL, OPT_MAX_JOBS);
 
    logger_fwritelnf(stdout, "Usage: %s %s", app, options);
    logger_fwritelnf(stdout, "Options:");
    logger_fwritelnf(stdout, "  %-25s Show this help message", OPT_SHOW_HELP);
    logger_fwritelnf(stdout, "  %-25s Show version information", OPT_SHOW_ABOUT);
-   logger_fwritelnf(stdout, "  %-9s%-16s Specify the configuration file with optional target", OPT_BUILD_CONFIG, "<file>[:target]");
+   logger_fwritelnf(stdout, "  %-9s%-16s Specify the configuration file with optional targets", OPT_BUILD_CONFIG, "<file>[:t1,t2]");
+   logger_fwritelnf(stdout, "  %-25s Build further targets (with their dependencies) in the same job pool", "<target>...");
+   logger_fwritelnf(stdout, "  %-7s%-18s Build only the object or output for one file of the targets", OPT_BUILD_FILE, "<path>");
+   logger_fwritelnf(stdout, "  %-10s%-15s Build only these configured variants (default: all)", OPT_VARIANT, "<v1,v2>");
+   logger_fwritelnf(stdout, "  %-25s Suggest headers to precompile from the recorded depfiles (no build)", OPT_PCH_REPORT);
+   logger_fwritelnf(stdout, "  %-25s Rebuild whenever an input, header or the config file changes (Ctrl-C to stop)", OPT_WATCH);
+   logger_fwritelnf(stdout, "  %-25s Serve builds of this directory from memory; later invocations here forward to it", OPT_DAEMON);
+   logger_fwritelnf(stdout, "  %-25s Skip stat'ing tracked inputs git and fsmonitor show unchanged since the last build", OPT_GIT_INDEX);
+   logger_fwritelnf(stdout, "  %-8s%-17s Reuse objects of compiles whose preprocessed source was compiled before", OPT_CACHE, "[=<dir>]");
+   logger_fwritelnf(stdout, "  %-15s%-10s Also look objects up in (and upload them to) an HTTP cache", OPT_REMOTE_CACHE, "<url>");
+   logger_fwritelnf(stdout, "  %-25s Leave cached objects in the cache; write only those a link or archive that runs reads", OPT_LAZY_OBJECTS);
+   logger_fwritelnf(stdout, "  %-15s%-10s Serve the %s directory as an HTTP cache (default port %d)", OPT_CACHE_SERVER, "[=<port>]",
+                    OPT_CACHE, REMOTE_CACHE_PORT);
    logger_fwritelnf(stdout, "  %-6s%-19s Set the log level", OPT_LOG_LEVEL, "(0-2)");
+   logger_fwritelnf(stdout, "  %-3s%-22s Run up to N jobs in parallel (default: online CPUs)", OPT_MAX_JOBS, "N");
+   logger_fwritelnf(stdout, "  %-3s%-22s Keep going until N actions fail (0: never stop)", OPT_KEEP_GOING, "N");
+   logger_fwritelnf(stdout, "  %-25s Stop at the first failure and terminate running jobs (default)", OPT_FAIL_FAST);
+   logger_fwritelnf(stdout, "  %-11s%-14s Report actions running N times longer than usual (0: off, default 3)", OPT_WATCHDOG, "N");
 }
 // Display application and optional component versions
 void cli_display_about(void) {
@@ -331,6 +590,7 @@ void cli_display_about(void) {
       logger_fwritelnf(stdout, "  - %-15s%26s", "CLI Parser", CLI.get_version());
       logger_fwritelnf(stdout, "  - %-15s%26s", "JSON Loader", Loader.get_version());
       logger_fwritelnf(stdout, "  - %-15s%26s", "Builder", Builder.get_version());
+      logger_fwritelnf(stdout, "  - %-15s%26s", "Executor", Executor.get_version());
    } else {
       // display simple version - trim last part of the version string.xxx
       char *version = strdup(SIGMABUILD_VERSION);
@@ -457,9 +717,13 @@ void resources_dispose_config(BuildConfig config) {
 
    free(config->name);
    free(config->log_file);
+   free(config->build_dir);
    for (char **var = config->variables; var && *var; var++)
       free(*var);
    free(config->variables);
+   for (char **variant = config->variants; variant && *variant; variant++)
+      free(*variant);
+   free(config->variants);
 
    // Dispose of each target
    for (BuildTarget *target = config->targets; target && *target; target++) {
@@ -488,6 +752,16 @@ void resources_dispose_target(BuildTarget target) {
    free(target->ld_flags);
    free(target->out_dir);
    if (target->output) free(target->output);
+   for (char **dep = target->dependencies; dep && *dep; dep++)
+      free(*dep);
+   free(target->dependencies);
+   free(target->kind);
+   free(target->archiver);
+   for (char **src = target->unity_exclude; src && *src; src++)
+      free(*src);
+   free(target->unity_exclude);
+   free(target->pch);
+   free(target->variant);
    if (target->commands) {
       for (char **cmd = target->commands; *cmd; cmd++) {
          free(*cmd); // Free individual command strings
@@ -538,6 +812,29 @@ size_t files_read_file(const char *filename, char **buffer) {
    return size;
 }
 
+// This function creates a directory and any missing parents
+int files_make_dirs(const char *path) {
+   if (!path || !*path) return SB_TRUE;
+
+   char *dir = strdup(path);
+   if (!dir) return SB_FALSE;
+   for (char *p = dir + 1;; p++) {
+      if (*p != '/' && *p != '\0') continue;
+      char c = *p;
+      *p = '\0';
+      if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+         logger_fdebugf(stderr, LOG_NORMAL, DBG_ERROR, "Failed to create directory %s: %s\n", dir, strerror(errno));
+         free(dir);
+         return SB_FALSE;
+      }
+      *p = c;
+      if (c == '\0' || p[1] == '\0') break;
+   }
+   free(dir);
+
+   return SB_TRUE;
+}
+
 // Global Logger Interface
 const ILogger Logger = {
     .log_stream = logger_get_log_stream,
@@ -563,4 +860,5 @@ const IResources Resources = {
 // Global Files Interface
 const IFiles Files = {
     .read = files_read_file, // No file reading function defined
+    .make_dirs = files_make_dirs,
 };
\ No newline at end of file
@@ -0,0 +1,392 @@
+// test_action_graph.c
+#include "sigtest.h"
+#include "action_graph.h"
+#include "loader.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Test cases for lowering configurations into action graphs: argv, outputs and signatures of
+ * compiles and links, response files past the threshold, unity batches and their files, shared
+ * precompiled headers, compiles shared by identity, renamed objects when flags differ (probing only
+ * the compilers of targets sharing a build directory), and the `<name>@<variant>` targets of a
+ * configuration with variants.
+ */
+
+// Executable `o/<name>` built in `o/` with gcc; `sources` and `flags` are JSON string lists, `extra` more fields
+#define EXE(name, sources, flags, extra)                                                                      \
+	" {\"name\": \"" name "\", \"type\": \"exe\", \"sources\": [" sources "], \"build_dir\": \"o/\",\n"               \
+	"  \"out_dir\": \"o/\", \"compiler\": \"gcc\", \"compiler_flags\": [" flags "], \"output\": \"" name "\"" extra "}"
+#define CONFIG(targets) "{\"name\": \"g\", \"targets\": [\n" targets "]}\n"
+
+static char project_dir[64];
+static char test_dir[4096];
+static BuildConfig config = NULL;
+static ActionGraph graph = NULL;
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_action_graph.log", "w");
+	// Lowering logs through the application context; keep it quiet
+	char *args[] = {"sbuild", "--log=0", NULL};
+	App.init(2, args);
+}
+
+//	helpers
+static int write_file(const char *name, const char *content)
+{
+	FILE *file = fopen(name, "w");
+	if (!file)
+		return 0;
+	fputs(content, file);
+	return fclose(file) == 0;
+}
+// Load a configuration from its JSON text
+static int load(const char *json)
+{
+	if (config)
+		Resources.dispose_config(config);
+	addr config_addr;
+	config = Resources.alloc(&config_addr, sizeof(build_config_s)) ? (BuildConfig)config_addr : NULL;
+	return config && write_file("build.json", json) && Loader.load_config("build.json", &config) && config->targets;
+}
+static BuildTarget find_target(const char *name)
+{
+	for (BuildTarget *target = config ? config->targets : NULL; target && *target; target++)
+	{
+		if (strcmp((*target)->name, name) == 0)
+			return *target;
+	}
+	return NULL;
+}
+// Lower (or only plan) the named targets; the previous graph is disposed
+static ActionGraph lower(int is_planned, const char *name, const char *other)
+{
+	BuildTarget targets[3] = {find_target(name), other ? find_target(other) : NULL, NULL};
+	ActionGraphs.dispose(graph);
+	graph = targets[0] ? (is_planned ? ActionGraphs.plan : ActionGraphs.lower)(config, targets) : NULL;
+	return graph;
+}
+static graph_action_s *action_of(const char *path)
+{
+	int id = ActionGraphs.find_file(graph, path);
+	return id >= 0 ? graph->actions[id] : NULL;
+}
+// Check that an argv ends with the given arguments (NULL-terminated)
+static int ends_with(char **argv, ...)
+{
+	int count = 0, expected_count = 0;
+	char *expected[32];
+	va_list args;
+	va_start(args, argv);
+	for (char *arg = va_arg(args, char *); arg && expected_count < 32; arg = va_arg(args, char *))
+		expected[expected_count++] = arg;
+	va_end(args);
+	while (argv && argv[count])
+		count++;
+	if (count < expected_count)
+		return 0;
+	for (int i = 0; i < expected_count; i++)
+	{
+		if (strcmp(argv[count - expected_count + i], expected[i]) != 0)
+			return 0;
+	}
+	return 1;
+}
+static int has_arg(char **argv, const char *arg)
+{
+	for (; argv && *argv; argv++)
+	{
+		if (strcmp(*argv, arg) == 0)
+			return 1;
+	}
+	return 0;
+}
+static int depends_on(graph_action_s *action, graph_action_s *dependency)
+{
+	for (int i = 0; action && dependency && i < dependency->dependent_count; i++)
+	{
+		if (dependency->dependents[i] == action->id)
+			return 1;
+	}
+	return 0;
+}
+static long mtime_of(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 ? (long)st.st_mtime : -1;
+}
+static void set_up(void)
+{
+	if (!getcwd(test_dir, sizeof(test_dir)))
+		test_dir[0] = '\0';
+	strcpy(project_dir, "/tmp/sbuild_graph_XXXXXX");
+	if (!mkdtemp(project_dir) || chdir(project_dir) != 0)
+		project_dir[0] = '\0';
+}
+static void tear_down(void)
+{
+	ActionGraphs.dispose(graph);
+	graph = NULL;
+	if (config)
+		Resources.dispose_config(config);
+	config = NULL;
+	char command[128];
+	snprintf(command, sizeof(command), "rm -rf %s", project_dir);
+	if (chdir(test_dir) != 0 || system(command) != 0)
+		project_dir[0] = '\0';
+}
+
+//	test cases - compiles and links
+static void test_compile_and_link(void)
+{
+	set_up();
+	Assert.isTrue(load(CONFIG(EXE("m", "\"src/a.c\", \"src/b.c\"", "\"-c\", \"-O2\"", ", \"linker_flags\": [\"-lm\"]"))),
+				  "Configuration should load");
+	Assert.isTrue(lower(1, "m", NULL) && graph->action_count == 3, "Two compiles and a link should be planned");
+
+	graph_action_s *compile = action_of("src/a.c"), *link = action_of("o/m");
+	Assert.isTrue(compile && compile->kind == ACTION_COMPILE && strcmp(compile->output, "o/src_a.o") == 0,
+				  "src/a.c should compile to o/src_a.o");
+	Assert.isTrue(compile && strcmp(compile->argv[0], "gcc") == 0 && has_arg(compile->argv, "-O2") &&
+					  ends_with(compile->argv, "-MMD", "-MF", "o/src_a.d", "-o", "o/src_a.o.tmp", "src/a.c", NULL),
+				  "The compile should run the template, then depfile, temp output and source");
+	Assert.isTrue(link && link->kind == ACTION_LINK && link->id == 2 &&
+					  ends_with(link->argv, "-lm", "-o", "o/m.tmp", "o/src_a.o", "o/src_b.o", NULL),
+				  "The link should take the flags, temp output and objects");
+	Assert.isTrue(depends_on(link, compile) && link->dependency_count == 2, "The link should wait on both compiles");
+	Assert.isTrue(compile && !compile->rsp_arg && link && !link->rsp_arg, "Short commands need no response file");
+
+	// Signatures follow the command: stable across lowerings, changed by a flag
+	uint64_t signature = compile ? compile->signature : 0;
+	Assert.isTrue(lower(1, "m", NULL) && (compile = action_of("src/a.c")) && compile->signature == signature,
+				  "The same command should keep its signature");
+	Assert.isTrue(load(CONFIG(EXE("m", "\"src/a.c\", \"src/b.c\"", "\"-c\", \"-O3\"", ", \"linker_flags\": [\"-lm\"]"))),
+				  "Configuration should load");
+	Assert.isTrue(lower(1, "m", NULL) && (compile = action_of("src/a.c")) && compile->signature != signature,
+				  "Another flag should change the signature");
+	tear_down();
+}
+static void test_response_file_threshold(void)
+{
+	set_up();
+	// Enough defines to push the compile's command line past GRAPH_RSP_THRESHOLD
+	size_t size = 2 * GRAPH_RSP_THRESHOLD, len = 0;
+	char *flags = malloc(size), *json = malloc(size + 512);
+	for (int i = 0; flags && i < GRAPH_RSP_THRESHOLD / 20; i++)
+		len += snprintf(flags + len, size - len, ", \"-DDEFINITION_NUMBER_%05d=1\"", i);
+	if (flags && json)
+		snprintf(json, size + 512, CONFIG(EXE("m", "\"src/a.c\"", "\"-c\"%s", "")), flags);
+	Assert.isTrue(json && load(json), "Configuration should load");
+	free(flags);
+	free(json);
+
+	graph_action_s *compile = lower(1, "m", NULL) ? action_of("src/a.c") : NULL;
+	graph_action_s *link = action_of("o/m");
+	Assert.isTrue(compile && compile->argv_len > GRAPH_RSP_THRESHOLD, "The compile should be long");
+	Assert.isTrue(compile && compile->rsp_arg && strcmp(compile->rsp_arg, "@o/src_a.o" GRAPH_RSP_SUFFIX) == 0,
+				  "The long compile should pass its arguments through a response file");
+	Assert.isTrue(link && link->argv_len <= GRAPH_RSP_THRESHOLD && !link->rsp_arg, "The short link should not");
+	tear_down();
+}
+
+//	test cases - unity builds
+#define UNITY_CONFIG(sources) \
+	CONFIG(EXE("u", sources, "\"-c\"", ", \"unity\": {\"batch_size\": 2, \"exclude\": [\"src/x.c\"]}"))
+
+static void test_unity_batches(void)
+{
+	set_up();
+	Assert.isTrue(load(UNITY_CONFIG("\"src/c.c\", \"src/a.c\", \"src/x.c\", \"src/b.c\", \"src/e.cpp\", \"src/f.cpp\","
+									"\"src/sub/d.c\", \"src/g.s\"")),
+				  "Configuration should load");
+	Assert.isTrue(lower(1, "u", NULL) != NULL, "The unity target should be planned");
+
+	// Sorted per directory and language: [a b] [c] and [e f]; d, x (excluded) and g (not C/C++) compile alone
+	graph_action_s *first = action_of("o/src__unity_0.o"), *cpp = action_of("o/src__unity_cpp_0.o");
+	Assert.isTrue(first && first->is_unity && strcmp(first->inputs[0], "o/src__unity_0.c") == 0 &&
+					  strcmp(first->inputs[1], "src/a.c") == 0 && strcmp(first->inputs[2], "src/b.c") == 0 && !first->inputs[3],
+				  "src/a.c and src/b.c should share the first unity file");
+	Assert.isTrue(first && ends_with(first->argv, "-o", "o/src__unity_0.o.tmp", "o/src__unity_0.c", NULL),
+				  "The unity file should be compiled");
+	Assert.isTrue(cpp && cpp->is_unity && strcmp(cpp->inputs[0], "o/src__unity_cpp_0.cpp") == 0,
+				  "C++ sources should get a unity file of their own");
+	Assert.isTrue(action_of("o/src_c.o") && !action_of("o/src_c.o")->is_unity, "A single-file batch should compile alone");
+	Assert.isTrue(action_of("o/src_sub_d.o") && action_of("o/src_x.o") && action_of("o/src_g.o"),
+				  "Other directories, excluded and other languages should compile alone");
+	Assert.isTrue(action_of("src/a.c") == first, "A member should be found through its unity compile");
+	Assert.isTrue(access("o/src__unity_0.c", F_OK) != 0, "Planning should not write unity files");
+	tear_down();
+}
+static void test_unity_rewrite_on_change(void)
+{
+	set_up();
+	Assert.isTrue(load(UNITY_CONFIG("\"src/a.c\", \"src/b.c\", \"src/c.c\"")), "Configuration should load");
+	Assert.isTrue(lower(0, "u", NULL) && access("o/src__unity_0.c", F_OK) == 0, "Lowering should write the unity file");
+	char line[256] = "";
+	FILE *file = fopen("o/src__unity_0.c", "r");
+	Assert.isTrue(file && fgets(line, sizeof(line), file) && strcmp(line, "#include \"../src/a.c\"\n") == 0,
+				  "Members should be included relative to the unity file, got %s", line);
+	if (file)
+		fclose(file);
+
+	// Unchanged batches leave the file (and its compile) alone
+	Assert.isTrue(system("touch -d '2000-01-01' o/src__unity_0.c") == 0, "The unity file should be backdated");
+	long backdated = mtime_of("o/src__unity_0.c");
+	Assert.isTrue(lower(0, "u", NULL) && mtime_of("o/src__unity_0.c") == backdated, "An unchanged batch should not be rewritten");
+
+	// A new source moves c into a batch with it; the first batch keeps its members
+	Assert.isTrue(load(UNITY_CONFIG("\"src/a.c\", \"src/b.c\", \"src/c.c\", \"src/c2.c\"")), "Configuration should load");
+	Assert.isTrue(lower(0, "u", NULL) && mtime_of("o/src__unity_0.c") == backdated, "The first batch should be untouched");
+	graph_action_s *second = action_of("o/src__unity_1.o");
+	Assert.isTrue(second && strcmp(second->inputs[1], "src/c.c") == 0 && strcmp(second->inputs[2], "src/c2.c") == 0,
+				  "src/c.c and src/c2.c should form the second batch");
+	Assert.isTrue(access("o/src__unity_1.c", F_OK) == 0, "The second unity file should be written");
+
+	// Removing a member rewrites the batch
+	Assert.isTrue(load(UNITY_CONFIG("\"src/a.c\", \"src/b2.c\", \"src/c.c\"")), "Configuration should load");
+	Assert.isTrue(lower(0, "u", NULL) && mtime_of("o/src__unity_0.c") != backdated, "A changed batch should be rewritten");
+	tear_down();
+}
+
+//	test cases - precompiled headers
+#define PCH ", \"pch\": \"include/all.h\""
+
+static void test_pch_shared(void)
+{
+	set_up();
+	Assert.isTrue(load(CONFIG(EXE("p", "\"src/a.c\"", "\"-c\"", PCH) ",\n" EXE("q", "\"src/b.c\"", "\"-c\"", PCH) ",\n"
+									  EXE("r", "\"src/c.c\"", "\"-c\", \"-O2\"", PCH))),
+				  "Configuration should load");
+	Assert.isTrue(lower(1, "p", "q") != NULL, "Both targets should be planned");
+
+	// Identical flags share one precompile; every compile force-includes it
+	graph_action_s *a = action_of("src/a.c"), *b = action_of("src/b.c");
+	graph_action_s *pch = a ? graph->actions[graph->targets[0]->pch] : NULL;
+	Assert.isTrue(pch && strncmp(pch->output, "o/" GRAPH_PCH_PREFIX, strlen("o/" GRAPH_PCH_PREFIX)) == 0 &&
+					  ends_with(pch->argv, "-o", pch->tmp_path, "include/all.h", NULL),
+				  "The header should be precompiled into o/" GRAPH_PCH_PREFIX "<hash>/");
+	Assert.isTrue(graph->target_count == 2 && graph->targets[0]->pch == graph->targets[1]->pch,
+				  "Targets with the same flags should share the precompiled header");
+	Assert.isTrue(a && b && depends_on(a, pch) && depends_on(b, pch), "Both compiles should wait on it");
+	Assert.isTrue(a && has_arg(a->argv, "-include") && has_arg(a->argv, graph->targets[0]->pch_include),
+				  "Compiles should force-include the header");
+
+	// Other flags get a precompile of their own
+	char shared[256];
+	snprintf(shared, sizeof(shared), "%s", pch ? pch->output : "");
+	graph_action_s *other = lower(1, "p", "r") ? graph->actions[graph->targets[1]->pch] : NULL;
+	Assert.isTrue(other && graph->targets[0]->pch != graph->targets[1]->pch && strcmp(other->output, shared) != 0,
+				  "Other flags should precompile the header separately");
+	tear_down();
+}
+
+//	test cases - shared and renamed compiles
+static void test_dedup_by_identity(void)
+{
+	set_up();
+	Assert.isTrue(load(CONFIG(EXE("m", "\"src/a.c\", \"src/m.c\"", "\"-c\"", "") ",\n" EXE("n", "\"src/a.c\", \"src/n.c\"", "\"-c\"", ""))),
+				  "Configuration should load");
+	Assert.isTrue(lower(1, "m", "n") && graph->action_count == 5, "The shared compile should be lowered once");
+	graph_action_s *shared = action_of("o/src_a.o"), *m = action_of("o/m"), *n = action_of("o/n");
+	Assert.isTrue(shared && depends_on(m, shared) && depends_on(n, shared), "Both links should wait on the shared compile");
+	Assert.isTrue(n && has_arg(n->argv, "o/src_a.o"), "Both links should take the shared object");
+	tear_down();
+}
+static void test_claim_collision_rename(void)
+{
+	set_up();
+	Assert.isTrue(load(CONFIG(EXE("m", "\"src/a.c\"", "\"-c\"", "") ",\n" EXE("n", "\"src/a.c\"", "\"-c\", \"-DN\"", ""))),
+				  "Configuration should load");
+
+	// The first configured compile owns o/src_a.o; the other variant goes to o/src_a.<identity>.o
+	Assert.isTrue(lower(1, "m", "n") && graph->action_count == 4, "Both compiles should be lowered");
+	graph_action_s *m = action_of("o/m"), *n = action_of("o/n");
+	char *renamed = n ? n->inputs[0] : NULL;
+	size_t renamed_len = renamed ? strlen(renamed) : 0;
+	Assert.isTrue(m && strcmp(m->inputs[0], "o/src_a.o") == 0, "m should own o/src_a.o");
+	Assert.isTrue(renamed_len == strlen("o/src_a.12345678.o") && strncmp(renamed, "o/src_a.", 8) == 0 &&
+					  strspn(renamed + 8, "0123456789abcdef") == 8 && strcmp(renamed + 16, ".o") == 0,
+				  "n should compile into o/src_a.%%08x.o, got %s", renamed ? renamed : "nothing");
+
+	// The names do not depend on which targets are requested
+	char expected[64];
+	snprintf(expected, sizeof(expected), "%s", renamed ? renamed : "");
+	Assert.isTrue(lower(1, "n", NULL) && (n = action_of("o/n")) && strcmp(n->inputs[0], expected) == 0,
+				  "n alone should still use its renamed object");
+	Assert.isFalse(action_of("o/src_a.o") != NULL, "n alone should not take o/src_a.o");
+	tear_down();
+}
+static void test_claims_probe_shared_dirs(void)
+{
+	set_up();
+	// Compilers that leave a mark when probed
+	Assert.isTrue(system("mkdir -p tools && for cc in far near; do printf '#!/bin/sh\\ntouch \"$0.probed\"\\nexec gcc \"$@\"\\n' "
+						 "> tools/$cc && chmod +x tools/$cc; done") == 0,
+				  "The compilers should be written");
+	Assert.isTrue(load(CONFIG(EXE("m", "\"src/a.c\"", "\"-c\"", "") ",\n"
+								  " {\"name\": \"far\", \"type\": \"exe\", \"sources\": [\"src/a.c\"], \"build_dir\": \"other/\",\n"
+								  "  \"out_dir\": \"other/\", \"compiler\": \"tools/far\", \"compiler_flags\": [\"-c\"], \"output\": \"far\"},\n"
+								  " {\"name\": \"near\", \"type\": \"exe\", \"sources\": [\"src/b.c\"], \"build_dir\": \"o/\",\n"
+								  "  \"out_dir\": \"o/\", \"compiler\": \"tools/near\", \"compiler_flags\": [\"-c\"], \"output\": \"near\"}\n")),
+				  "Configuration should load");
+
+	// Only targets that can write objects into o/ are templated for claims
+	Assert.isTrue(lower(1, "m", NULL) != NULL, "m should lower");
+	Assert.isTrue(access("tools/near.probed", F_OK) == 0, "A target sharing o/ should be probed for its claims");
+	Assert.isFalse(access("tools/far.probed", F_OK) == 0, "A target building in other/ should not be probed");
+
+	// The far target still probes its compiler when it is lowered itself
+	Assert.isTrue(lower(1, "far", NULL) && access("tools/far.probed", F_OK) == 0, "Lowering far should probe its compiler");
+	tear_down();
+}
+
+//	test cases - variants
+static void test_variant_targets(void)
+{
+	set_up();
+	Assert.isTrue(load("{\"name\": \"g\", \"variants\": {\"debug\": {\"compiler_flags\": [\"-O0\"]},\n"
+					   " \"release\": {\"compiler_flags\": [\"-O2\"], \"linker_flags\": [\"-s\"]}},\n"
+					   " \"targets\": [\n"
+					   " {\"name\": \"l\", \"type\": \"lib\", \"kind\": \"static\", \"sources\": [\"src/l.c\"], \"build_dir\": \"o/\",\n"
+					   "  \"out_dir\": \"o/\", \"compiler\": \"gcc\", \"compiler_flags\": [\"-c\"], \"output\": \"libl.a\"},\n"
+					   EXE("m", "\"src/m.c\"", "\"-c\"", ", \"dependencies\": [\"l\"]") "]}\n"),
+				  "Configuration should load");
+	Assert.isTrue(find_target("m@debug") && find_target("m@release") && find_target("l@release") && !find_target("m"),
+				  "Each target should exist once per variant");
+	BuildTarget debug = find_target("m@debug");
+	Assert.isTrue(debug && strcmp(debug->variant, "debug") == 0 && strcmp(debug->dependencies[0], "l@debug") == 0,
+				  "Dependencies should name the same variant");
+
+	// Each variant builds apart, with its own flags
+	Assert.isTrue(lower(1, "m@release", NULL) && graph->target_count == 2, "m@release should lower with its dependency");
+	graph_action_s *lib = action_of("o/release/libl.a"), *link = action_of("o/release/m");
+	graph_action_s *compile = action_of("o/release/src_m.o");
+	Assert.isTrue(lib && lib->kind == ACTION_ARCHIVE && link && depends_on(link, lib), "The link should wait on l@release");
+	Assert.isTrue(compile && has_arg(compile->argv, "-O2") && !has_arg(compile->argv, "-O0"),
+				  "The compile should take the release flags");
+	Assert.isTrue(link && has_arg(link->argv, "-s"), "The link should take the release linker flags");
+	Assert.isTrue(!action_of("o/debug/m") && !action_of("o/src_m.o"), "Only the requested variant should be lowered");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_action_graph_tests(void)
+{
+	testset("action_graph_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Compile And Link", test_compile_and_link);
+	testcase("Response File Threshold", test_response_file_threshold);
+	testcase("Unity Batches", test_unity_batches);
+	testcase("Unity Rewrite On Change", test_unity_rewrite_on_change);
+	testcase("PCH Shared", test_pch_shared);
+	testcase("Dedup By Identity", test_dedup_by_identity);
+	testcase("Claim Collision Rename", test_claim_collision_rename);
+	testcase("Claims Probe Shared Dirs", test_claims_probe_shared_dirs);
+	testcase("Variant Targets", test_variant_targets);
+}
@@ -0,0 +1,145 @@
+// test_build_log.c
+#include "sigtest.h"
+#include "build_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Test cases for the build log: records survive closing and reopening the log (journaled and
+ * compacted), and a journal torn by a crash is cut off at the torn record.
+ */
+
+static char log_dir[64];
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_build_log.log", "w");
+}
+static void set_up(void)
+{
+	strcpy(log_dir, "/tmp/sbuild_log_XXXXXX");
+	if (!mkdtemp(log_dir))
+		log_dir[0] = '\0';
+}
+static void tear_down(void)
+{
+	char path[128];
+	snprintf(path, sizeof(path), "%s/" BUILD_LOG_FILE, log_dir);
+	unlink(path);
+	rmdir(log_dir);
+}
+
+//	helpers
+static void record_entry(const char *key, long value)
+{
+	build_log_entry_s entry = {.duration_ms = value, .mtime_ns = value * 1000, .command_hash = value + 1,
+							   .digest = value + 2, .cache_key = {value + 3, value + 4}};
+	BuildLog.record(key, &entry);
+}
+static void record_entries(const char *prefix, int count)
+{
+	char key[32];
+	for (int i = 0; i < count; i++)
+	{
+		snprintf(key, sizeof(key), "%s%d", prefix, i);
+		record_entry(key, i);
+	}
+}
+static int is_logged(const char *key, long value)
+{
+	build_log_entry_s entry;
+	return BuildLog.lookup(key, &entry) && entry.duration_ms == value && entry.mtime_ns == value * 1000 &&
+		   entry.command_hash == (uint64_t)value + 1 && entry.digest == (uint64_t)value + 2 &&
+		   entry.cache_key[0] == (uint64_t)value + 3 && entry.cache_key[1] == (uint64_t)value + 4;
+}
+
+//	test cases - round trip
+static void test_log_round_trip(void)
+{
+	set_up();
+	Assert.isTrue(BuildLog.open(log_dir), "Log should open in %s", log_dir);
+	record_entry("obj/a.o", 11);
+	record_entry("obj/b.o", 12);
+	record_entry("obj/a.o", 13); // The latest record of a key wins
+	BuildLog.close();
+
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	Assert.isTrue(is_logged("obj/a.o", 13), "obj/a.o should hold its latest record");
+	Assert.isTrue(is_logged("obj/b.o", 12), "obj/b.o should be logged");
+	Assert.isFalse(is_logged("obj/c.o", 0), "obj/c.o was never recorded");
+	BuildLog.close();
+	tear_down();
+}
+static void test_log_journal_and_compaction(void)
+{
+	set_up();
+	Assert.isTrue(BuildLog.open(log_dir), "Log should open in %s", log_dir);
+	record_entries("seed", 100);
+	BuildLog.close();
+
+	// A small journal is kept behind the index; a large one is compacted into it on close
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	record_entries("small", 2);
+	BuildLog.close();
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	record_entries("large", 60);
+	BuildLog.close();
+
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	Assert.isTrue(is_logged("seed99", 99), "Indexed records should survive");
+	Assert.isTrue(is_logged("small1", 1), "Journaled records should survive");
+	Assert.isTrue(is_logged("large59", 59), "Compacted records should survive");
+	BuildLog.close();
+	tear_down();
+}
+
+//	test cases - crash recovery
+static void test_log_truncated_journal(void)
+{
+	set_up();
+	char path[128];
+	snprintf(path, sizeof(path), "%s/" BUILD_LOG_FILE, log_dir);
+	Assert.isTrue(BuildLog.open(log_dir), "Log should open in %s", log_dir);
+	record_entries("seed", 100);
+	BuildLog.close();
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	record_entry("first", 1);
+	record_entry("torn", 2);
+	BuildLog.close();
+
+	// Tear the last record as a crash in the middle of its write would
+	FILE *file = fopen(path, "r");
+	long size = -1;
+	if (file && fseek(file, 0, SEEK_END) == 0)
+		size = ftell(file);
+	if (file)
+		fclose(file);
+	Assert.isTrue(size > 0 && truncate(path, size - 1) == 0, "Log should be truncated");
+
+	Assert.isTrue(BuildLog.open(log_dir), "Log with a torn record should open");
+	Assert.isTrue(is_logged("seed0", 0), "Indexed records should survive");
+	Assert.isTrue(is_logged("first", 1), "Records before the torn one should survive");
+	Assert.isFalse(is_logged("torn", 2), "The torn record should be dropped");
+	record_entry("after", 3);
+	BuildLog.close();
+
+	// The torn bytes were cut off, so later appends stay readable
+	Assert.isTrue(BuildLog.open(log_dir), "Log should reopen");
+	Assert.isTrue(is_logged("after", 3), "Records appended after recovery should survive");
+	Assert.isTrue(is_logged("first", 1), "Records before the torn one should still survive");
+	BuildLog.close();
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_build_log_tests(void)
+{
+	testset("build_log_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Build Log Round Trip", test_log_round_trip);
+	testcase("Build Log Journal And Compaction", test_log_journal_and_compaction);
+	testcase("Build Log Truncated Journal", test_log_truncated_journal);
+}
@@ -0,0 +1,350 @@
+// test_executor.c
+#define _GNU_SOURCE
+#include "sigtest.h"
+#include "executor.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Test cases for the job executor, run with short `sh -c` jobs: exit statuses, timeouts and
+ * the kill grace period, the watchdog, interrupt forwarding, captured output (spilled past the
+ * threshold and printed one job at a time) and the SIGCHLD fallback when pidfds are unavailable.
+ */
+
+static char capture_path[64];
+static int is_pidfd_failing = 0; // pidfd_open fails as it would for a process out of descriptors
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_executor.log", "w");
+	// The executor logs through the application context; keep it quiet
+	char *args[] = {"sbuild", "--log=0", NULL};
+	App.init(2, args);
+}
+
+// Stand in for libc's syscall(2) so that the executor's pidfd_open can be made to fail
+long syscall(long number, ...)
+{
+	long args[6];
+	va_list list;
+	va_start(list, number);
+	for (int i = 0; i < 6; i++)
+		args[i] = va_arg(list, long);
+	va_end(list);
+	if (number == SYS_pidfd_open && is_pidfd_failing)
+	{
+		errno = EMFILE;
+		return -1;
+	}
+	long (*next)(long, ...) = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+	return next(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+//	helpers
+static exec_job_s job_of(const char *label, const char *command)
+{
+	exec_job_s job = {.label = (string)label, .command = (string)command};
+	return job;
+}
+// Start a job and wait for it to complete
+static ExecJob run_job(ExecJob job)
+{
+	return Executor.start(job) ? Executor.wait() : NULL;
+}
+// Send what the jobs print to `fd` (stdout or stderr) into the capture file; returns the saved descriptor
+static int capture_begin(int fd)
+{
+	fflush(NULL);
+	int saved = dup(fd);
+	int file = open(capture_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	dup2(file, fd);
+	close(file);
+	return saved;
+}
+static void capture_end(int fd, int saved)
+{
+	fflush(NULL);
+	dup2(saved, fd);
+	close(saved);
+}
+// Read the capture file; the caller frees the result
+static char *read_captured(long *size)
+{
+	struct stat st;
+	*size = stat(capture_path, &st) == 0 ? (long)st.st_size : 0;
+	char *text = calloc(1, *size + 1);
+	FILE *file = fopen(capture_path, "r");
+	if (file && text && fread(text, 1, *size, file) != (size_t)*size)
+		text[0] = '\0';
+	if (file)
+		fclose(file);
+	return text;
+}
+static int is_captured(const char *text)
+{
+	long size;
+	char *captured = read_captured(&size);
+	int is_found = captured && strstr(captured, text) != NULL;
+	free(captured);
+	return is_found;
+}
+static void set_up(int max_jobs, int watchdog)
+{
+	strcpy(capture_path, "/tmp/sbuild_exec_XXXXXX");
+	int fd = mkstemp(capture_path);
+	if (fd >= 0)
+		close(fd);
+	Executor.init(max_jobs, watchdog);
+}
+static void tear_down(void)
+{
+	Executor.shutdown();
+	is_pidfd_failing = 0;
+	unlink(capture_path);
+}
+
+//	test cases - exit status
+static void test_exit_status(void)
+{
+	set_up(2, 0);
+	exec_job_s exits = job_of("exits", "exit 3");
+	Assert.isTrue(run_job(&exits) == &exits && exits.status == 3, "Exit status should be 3, was %d", exits.status);
+
+	exec_job_s signalled = job_of("signalled", "kill -USR1 $$");
+	Assert.isTrue(run_job(&signalled) == &signalled && signalled.status == 128 + SIGUSR1,
+				  "A job killed by a signal should report 128 + signal, was %d", signalled.status);
+
+	char *missing_argv[] = {"/nonexistent/tool", NULL};
+	exec_job_s missing = job_of("missing", NULL);
+	missing.argv = missing_argv;
+	Assert.isFalse(Executor.start(&missing), "A missing program should not start");
+	Assert.isTrue(missing.status == EXEC_STATUS_SPAWN_FAILED, "Spawn failure should report %d, was %d",
+				  EXEC_STATUS_SPAWN_FAILED, missing.status);
+	Assert.isTrue(Executor.running() == 0 && Executor.wait() == NULL, "Nothing should be left running");
+	tear_down();
+}
+static void test_stdin_closed(void)
+{
+	set_up(1, 0);
+	// A command reading its input sees end-of-file instead of stalling the build
+	exec_job_s reads = job_of("reads", "read line");
+	Assert.isTrue(run_job(&reads) == &reads && reads.status != 0, "Reading stdin should fail at end-of-file");
+	tear_down();
+}
+
+//	test cases - timeouts
+static void test_timeout_kills_group(void)
+{
+	set_up(1, 0);
+	// The background sleep holds the output pipe: killing the group must still end the job promptly
+	exec_job_s slow = job_of("slow", "sleep 5 & wait");
+	slow.timeout_ms = 200;
+	int saved = capture_begin(STDERR_FILENO);
+	ExecJob done = run_job(&slow);
+	capture_end(STDERR_FILENO, saved);
+	Assert.isTrue(done == &slow && slow.timed_out, "The job should time out");
+	Assert.isTrue(slow.status == EXEC_STATUS_TIMED_OUT, "A timed out job should report %d, was %d", EXEC_STATUS_TIMED_OUT,
+				  slow.status);
+	Assert.isTrue(slow.duration_ms >= 200 && slow.duration_ms < EXEC_KILL_GRACE_MS,
+				  "The job should be killed at its timeout, took %ldms", slow.duration_ms);
+	Assert.isTrue(is_captured("slow timed out"), "The timeout should be reported");
+	tear_down();
+}
+static void test_cancel_abandons_after_grace(void)
+{
+	set_up(1, 0);
+	// The job ignores SIGTERM: after the grace period its slot is freed anyway
+	exec_job_s stubborn = job_of("stubborn", "trap '' TERM; sleep 10");
+	Assert.isTrue(Executor.start(&stubborn), "The job should start");
+	usleep(100 * 1000);
+	Executor.cancel(&stubborn);
+	int saved = capture_begin(STDERR_FILENO);
+	ExecJob done = Executor.wait();
+	capture_end(STDERR_FILENO, saved);
+	Assert.isTrue(done == &stubborn && stubborn.status == 128 + SIGKILL, "The job should be abandoned, status %d",
+				  stubborn.status);
+	Assert.isTrue(stubborn.duration_ms >= EXEC_KILL_GRACE_MS, "The job should get its grace period, took %ldms",
+				  stubborn.duration_ms);
+	Assert.isTrue(is_captured("stubborn did not exit after being killed"), "The abandonment should be reported");
+
+	// The freed slot runs the next job
+	exec_job_s next = job_of("next", "exit 0");
+	Assert.isTrue(Executor.has_slot() && run_job(&next) == &next && next.status == 0, "The slot should be reused");
+	tear_down();
+}
+
+//	test cases - watchdog
+static void test_watchdog_reports_overrun(void)
+{
+	set_up(2, 2);
+	// Expected 0.5s at factor 2: reported once past 1s
+	exec_job_s overrun = job_of("overrun", "sleep 1.3");
+	overrun.expected_ms = 500;
+	int saved = capture_begin(STDERR_FILENO);
+	ExecJob done = run_job(&overrun);
+	capture_end(STDERR_FILENO, saved);
+	Assert.isTrue(done == &overrun && overrun.status == 0, "A watched job should still complete");
+	Assert.isTrue(is_captured("[watchdog] overrun has been running for"), "The overrun should be reported");
+
+	// Limits under EXEC_WATCHDOG_MIN_MS are not watched
+	exec_job_s quick = job_of("quick", "sleep 1");
+	quick.expected_ms = 400;
+	saved = capture_begin(STDERR_FILENO);
+	done = run_job(&quick);
+	capture_end(STDERR_FILENO, saved);
+	Assert.isTrue(done == &quick && quick.status == 0, "A fast job should complete");
+	Assert.isFalse(is_captured("[watchdog]"), "A fast job should not be reported");
+	tear_down();
+}
+
+//	test cases - interrupts
+static void test_interrupt_forwarded(void)
+{
+	set_up(1, 0);
+	exec_job_s job = job_of("interrupted", "echo partial; sleep 5");
+	Assert.isTrue(Executor.start(&job), "The job should start");
+	usleep(100 * 1000);
+	kill(getpid(), SIGTERM); // Blocked by the executor: read from its signalfd by the next wait
+	int saved = capture_begin(STDOUT_FILENO);
+	ExecJob done = Executor.wait();
+	capture_end(STDOUT_FILENO, saved);
+	Assert.isTrue(done == &job && job.status == 128 + SIGTERM, "The job should end with SIGTERM, status %d", job.status);
+	Assert.isTrue(Executor.interrupted() == SIGTERM, "The interrupt should be recorded");
+	Assert.isFalse(is_captured("partial"), "Output of an interrupted job should be discarded");
+	tear_down();
+}
+static void test_second_interrupt_escalates(void)
+{
+	set_up(1, 0);
+	// The job ignores SIGINT; the second interrupt (from a helper process) escalates to SIGKILL
+	exec_job_s job = job_of("stubborn", "trap '' INT; sleep 10");
+	Assert.isTrue(Executor.start(&job), "The job should start");
+	usleep(100 * 1000);
+	pid_t helper = fork();
+	if (helper == 0)
+	{
+		usleep(300 * 1000);
+		kill(getppid(), SIGINT);
+		_exit(0);
+	}
+	kill(getpid(), SIGINT);
+	int saved = capture_begin(STDERR_FILENO);
+	ExecJob done = Executor.wait();
+	capture_end(STDERR_FILENO, saved);
+	waitpid(helper, NULL, 0);
+	Assert.isTrue(done == &job && job.status == 128 + SIGKILL, "The job should be killed, status %d", job.status);
+	Assert.isTrue(job.duration_ms < EXEC_KILL_GRACE_MS, "The kill should not wait for the grace period, took %ldms",
+				  job.duration_ms);
+	Assert.isTrue(Executor.interrupted() == SIGINT, "The interrupt should be recorded");
+	tear_down();
+}
+
+//	test cases - captured output
+static void test_output_spill(void)
+{
+	set_up(1, 0);
+	// Past EXEC_SPILL_THRESHOLD the output moves to a temp file; it is printed whole either way
+	exec_job_s loud = job_of("loud", "head -c 100000 /dev/zero | tr '\\0' x");
+	int saved = capture_begin(STDOUT_FILENO);
+	ExecJob done = run_job(&loud);
+	capture_end(STDOUT_FILENO, saved);
+	long size;
+	char *captured = read_captured(&size);
+	int is_whole = captured && size == 100000 && strspn(captured, "x") == 100000;
+	free(captured);
+	Assert.isTrue(done == &loud && loud.status == 0, "The job should succeed");
+	Assert.isTrue(is_whole, "All %d bytes should be printed, got %ld", 100000, size);
+	tear_down();
+}
+static void test_output_not_interleaved(void)
+{
+	set_up(2, 0);
+	// Both jobs write in two bursts while the other runs; each block is printed as one
+	exec_job_s a = job_of("a", "head -c 40000 /dev/zero | tr '\\0' a; sleep 0.2; head -c 40000 /dev/zero | tr '\\0' a");
+	exec_job_s b = job_of("b", "sleep 0.1; head -c 40000 /dev/zero | tr '\\0' b; sleep 0.2; head -c 40000 /dev/zero | tr '\\0' b");
+	int saved = capture_begin(STDOUT_FILENO);
+	int is_started = Executor.start(&a) && Executor.start(&b);
+	ExecJob first = Executor.wait();
+	ExecJob second = Executor.wait();
+	capture_end(STDOUT_FILENO, saved);
+	long size;
+	char *captured = read_captured(&size);
+	int switches = 0;
+	for (long i = 1; captured && i < size; i++)
+		switches += captured[i] != captured[i - 1];
+	free(captured);
+	Assert.isTrue(is_started && first && second && a.status == 0 && b.status == 0, "Both jobs should succeed");
+	Assert.isTrue(size == 160000 && switches == 1, "The blocks should not interleave (%ld bytes, %d switches)", size,
+				  switches);
+	tear_down();
+}
+
+//	test cases - SIGCHLD fallback
+static void test_signalfd_fallback(void)
+{
+	// Without pidfds at all the executor waits on SIGCHLD from the start
+	is_pidfd_failing = 1;
+	set_up(2, 0);
+	exec_job_s exits = job_of("exits", "exit 3");
+	exec_job_s slow = job_of("slow", "sleep 5");
+	slow.timeout_ms = 200;
+	int saved = capture_begin(STDERR_FILENO);
+	int is_started = Executor.start(&exits) && Executor.start(&slow);
+	ExecJob first = Executor.wait();
+	ExecJob second = Executor.wait();
+	capture_end(STDERR_FILENO, saved);
+	Assert.isTrue(is_started && first == &exits && exits.status == 3, "The first job should exit with 3, was %d",
+				  exits.status);
+	Assert.isTrue(second == &slow && slow.status == EXEC_STATUS_TIMED_OUT, "The second job should time out, status %d",
+				  slow.status);
+	tear_down();
+}
+static void test_pidfd_switch_mid_run(void)
+{
+	set_up(2, 0);
+	exec_job_s before = job_of("before", "sleep 0.3; exit 4");
+	Assert.isTrue(Executor.start(&before), "The job should start with a pidfd");
+
+	// pidfd_open fails for the next child: it and the running one are reaped through SIGCHLD
+	is_pidfd_failing = 1;
+	exec_job_s after = job_of("after", "exit 5");
+	Assert.isTrue(Executor.start(&after), "The job should start without a pidfd");
+	ExecJob first = Executor.wait();
+	ExecJob second = Executor.wait();
+	Assert.isTrue(first == &after && after.status == 5, "The job without a pidfd should exit with 5, was %d", after.status);
+	Assert.isTrue(second == &before && before.status == 4, "The job with a pidfd should exit with 4, was %d",
+				  before.status);
+
+	exec_job_s later = job_of("later", "exit 6");
+	Assert.isTrue(run_job(&later) == &later && later.status == 6, "Later jobs should run on SIGCHLD");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_executor_tests(void)
+{
+	testset("executor_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Exit Status", test_exit_status);
+	testcase("Stdin Closed", test_stdin_closed);
+	testcase("Timeout Kills Group", test_timeout_kills_group);
+	testcase("Cancel Abandons After Grace", test_cancel_abandons_after_grace);
+	testcase("Watchdog Reports Overrun", test_watchdog_reports_overrun);
+	testcase("Interrupt Forwarded", test_interrupt_forwarded);
+	testcase("Second Interrupt Escalates", test_second_interrupt_escalates);
+	testcase("Output Spill", test_output_spill);
+	testcase("Output Not Interleaved", test_output_not_interleaved);
+	testcase("Signalfd Fallback", test_signalfd_fallback);
+	testcase("Pidfd Switch Mid Run", test_pidfd_switch_mid_run);
+}
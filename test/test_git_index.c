@@ -0,0 +1,300 @@
+// test_git_index.c
+#include "sigtest.h"
+#include "git_index.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Test cases for git index change detection over scratch repositories: indexes of versions 2
+ * to 4, the files fsmonitor lists (through a hook of either protocol, or the daemon's socket)
+ * and the entries flagged in the index, and the entries git cannot vouch for.
+ */
+
+#define HOOK_V2 "#!/bin/sh\nprintf 'token\\0'\ncat .git/dirty 2>/dev/null\nexit 0\n"
+#define HOOK_V1 "#!/bin/sh\ncat .git/dirty 2>/dev/null\nexit 0\n"
+#define DAEMON_PASSES 2
+
+static char repo_dir[64];
+static char test_dir[4096];
+static char daemon_request[256];  // What the fake daemon was last asked
+static const char *daemon_answer; // What it answers (pkt-line payload, NUL-separated)
+static size_t daemon_answer_len;
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_git_index.log", "w");
+	// The git index logs through the application context; keep it quiet
+	char *args[] = {"sbuild", "--log=0", NULL};
+	App.init(2, args);
+}
+
+//	helpers
+static int write_file(const char *name, const char *content, size_t len)
+{
+	FILE *file = fopen(name, "w");
+	if (!file)
+		return 0;
+	fwrite(content, 1, len, file);
+	return fclose(file) == 0;
+}
+static int run(const char *format, ...)
+{
+	char command[4096];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(command, sizeof(command), format, args);
+	va_end(args);
+	return system(command);
+}
+// Make fsmonitor list the given NUL-terminated paths from now on
+static void set_dirty(const char *paths, size_t len)
+{
+	write_file(".git/dirty", paths, len);
+}
+// Run one build's worth of lookups of the given paths (NULL-terminated); returns a bit per path taken from the snapshot, -1 if the index is not used
+static int pass(const char *path, ...)
+{
+	FileStats.reset();
+	if (!GitIndex.open("."))
+		return -1;
+	int reused = 0, bit = 1;
+	va_list list;
+	va_start(list, path);
+	for (; path; path = va_arg(list, const char *), bit <<= 1)
+	{
+		file_stat_s st, actual;
+		if (!GitIndex.lookup(path, &st))
+			continue;
+		// What the snapshot gives must be what a stat would
+		FileStats.reset();
+		FileStats.get(path, &actual);
+		if (st.mtime_ns == actual.mtime_ns && st.size == actual.size)
+			reused |= bit;
+	}
+	va_end(list);
+	GitIndex.close();
+	return reused;
+}
+static int index_version(void)
+{
+	unsigned char header[8] = {0};
+	FILE *file = fopen(".git/index", "r");
+	if (file)
+	{
+		if (fread(header, 1, sizeof(header), file) != sizeof(header))
+			header[7] = 0;
+		fclose(file);
+	}
+	return header[7];
+}
+// A repository with three old tracked files, written at the given index version with fsmonitor data (from a hook of the given protocol)
+static void set_up(int version, int hook_version)
+{
+	const char *hook = hook_version == 1 ? HOOK_V1 : HOOK_V2;
+	if (!getcwd(test_dir, sizeof(test_dir)))
+		test_dir[0] = '\0';
+	strcpy(repo_dir, "/tmp/sbuild_git_XXXXXX");
+	if (!mkdtemp(repo_dir) || chdir(repo_dir) != 0)
+	{
+		repo_dir[0] = '\0';
+		return;
+	}
+	run("git init -q && mkdir -p src/deep && echo 'int a;' > src/a.c && echo '#define B' > src/deep/b.h && "
+		"echo '#define C' > src/deep/c.h && touch -d '-1 hour' src/a.c src/deep/b.h src/deep/c.h");
+	write_file(".git/hook.sh", hook, strlen(hook));
+	run("chmod +x .git/hook.sh && git config core.fsmonitor .git/hook.sh && git config core.fsmonitorHookVersion %d && "
+		"git add src && git update-index --index-version %d && git update-index --fsmonitor && git status --porcelain > /dev/null",
+		hook_version, version);
+}
+static void tear_down(void)
+{
+	char command[128];
+	snprintf(command, sizeof(command), "rm -rf %s", repo_dir);
+	if (chdir(test_dir) != 0 || system(command) != 0)
+		repo_dir[0] = '\0';
+	FileStats.reset();
+}
+// Fake fsmonitor daemon: answer each query on the git directory's socket
+static void *serve_daemon(void *data)
+{
+	int server = *(int *)data;
+	for (int i = 0; i < DAEMON_PASSES; i++)
+	{
+		int client = accept(server, NULL, NULL);
+		if (client < 0)
+			break;
+		// One pkt-line with the token, then a flush packet
+		char request[256] = {0};
+		size_t len = 0;
+		while (len < sizeof(request) - 1 && !(len >= 4 && memcmp(request + len - 4, "0000", 4) == 0))
+		{
+			ssize_t n = read(client, request + len, 1);
+			if (n <= 0)
+				break;
+			len += n;
+		}
+		memcpy(daemon_request, request, sizeof(request));
+		char header[8];
+		snprintf(header, sizeof(header), "%04x", (unsigned)daemon_answer_len + 4);
+		if (write(client, header, 4) != 4 || write(client, daemon_answer, daemon_answer_len) != (ssize_t)daemon_answer_len ||
+			write(client, "0000", 4) != 4)
+			daemon_request[0] = '\0';
+		close(client);
+	}
+	return NULL;
+}
+
+//	test cases - index formats
+static void test_index_versions(void)
+{
+	for (int version = 2; version <= 4; version++)
+	{
+		set_up(version, 2);
+		// An intent-to-add entry has the extended flags, which keep git from writing version 3 as 2 (and 2 as 3)
+		run(version > 2 ? "echo 'int n;' > src/n.c && git add -N src/n.c" : "echo 'int n;' > src/n.c");
+		Assert.isTrue(index_version() == version, "The index should be at version %d", version);
+
+		// The first build records what it read; the second takes it from the snapshot
+		Assert.isTrue(pass("src/a.c", "src/deep/b.h", "./src/deep/../deep/c.h", NULL) == 0, "Nothing should be reused at first");
+		int reused = pass("src/a.c", "src/deep/b.h", "./src/deep/../deep/c.h", "src/n.c", "src/none.c", NULL);
+		Assert.isTrue(reused == 7, "Version %d: every tracked file should be reused, got %x", version, reused);
+
+		// A staged change rewrites the entry (git too learns of the edit from fsmonitor)
+		set_dirty("src/a.c", sizeof("src/a.c"));
+		run("echo 'int a = 1;' > src/a.c && touch -d '-30 min' src/a.c && git add src/a.c");
+		set_dirty("", 0);
+		reused = pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL);
+		Assert.isTrue(reused == 6, "Version %d: the staged file should be stat'ed, got %x", version, reused);
+		tear_down();
+	}
+}
+
+//	test cases - fsmonitor
+static void test_fsmonitor_lists_changes(void)
+{
+	set_up(2, 2);
+	pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL);
+
+	// Files and directories the hook lists are stat'ed
+	set_dirty("src/a.c", sizeof("src/a.c"));
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 6, "A listed file should be stat'ed");
+	set_dirty("src/deep/", sizeof("src/deep/"));
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 1, "Files under a listed directory should be stat'ed");
+	set_dirty("/", sizeof("/"));
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 0, "\"/\" should leave every file to stat");
+	set_dirty("", 0);
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 7, "Nothing listed: every file should be reused");
+
+	// So are the entries the index flags as not checked since it was written
+	run("git update-index --no-fsmonitor-valid src/deep/b.h");
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 5, "A flagged entry should be stat'ed");
+
+	// A failing hook leaves every file to stat
+	write_file(".git/hook.sh", "#!/bin/sh\nexit 1\n", strlen("#!/bin/sh\nexit 1\n"));
+	Assert.isTrue(pass("src/a.c", "src/deep/c.h", NULL) == 0, "Without an answer nothing should be reused");
+	tear_down();
+}
+static void test_hook_protocol_1(void)
+{
+	set_up(2, 1);
+	pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL);
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 7, "Every file should be reused");
+
+	// Protocol 1 answers paths only
+	set_dirty("src/deep/c.h", sizeof("src/deep/c.h"));
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 3, "The listed file should be stat'ed");
+	tear_down();
+}
+static void test_daemon_lists_changes(void)
+{
+	set_up(2, 2);
+	pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL);
+
+	// core.fsmonitor=true asks the daemon on its socket, with the token of the index
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s/.git/fsmonitor--daemon.ipc", repo_dir);
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct timeval timeout = {.tv_sec = 5};
+	setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // A query never sent fails the test, not hangs it
+	Assert.isTrue(server >= 0 && bind(server, (struct sockaddr *)&address, sizeof(address)) == 0 && listen(server, 1) == 0,
+				  "The fake daemon should listen");
+	pthread_t thread;
+	pthread_create(&thread, NULL, serve_daemon, &server);
+	run("git config core.fsmonitor true");
+
+	daemon_answer = "token\0src/deep/b.h";
+	daemon_answer_len = sizeof("token\0src/deep/b.h");
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 5, "The file the daemon lists should be stat'ed");
+	Assert.isTrue(strcmp(daemon_request, "0009token0000") == 0, "The daemon should be asked since the token, got %s",
+				  daemon_request);
+	daemon_answer = "token";
+	daemon_answer_len = sizeof("token");
+	Assert.isTrue(pass("src/a.c", "src/deep/b.h", "src/deep/c.h", NULL) == 7, "Nothing listed: every file should be reused");
+	pthread_join(thread, NULL);
+	close(server);
+
+	// Without the daemon, nothing is reused
+	Assert.isTrue(pass("src/a.c", NULL) == -1, "The index should not be used without the daemon");
+	tear_down();
+}
+static void test_no_fsmonitor(void)
+{
+	set_up(2, 2);
+	Assert.isTrue(pass("src/a.c", NULL) == 0, "The index should be used with the hook");
+
+	// Finding unstaged edits without fsmonitor costs as much as the stats it would save
+	run("git config --unset core.fsmonitor");
+	Assert.isTrue(pass("src/a.c", NULL) == -1, "The index should not be used without core.fsmonitor");
+	run("git config core.fsmonitor false");
+	Assert.isTrue(pass("src/a.c", NULL) == -1, "The index should not be used with core.fsmonitor off");
+
+	// An index written without fsmonitor has no token to ask since
+	run("git update-index --no-fsmonitor && git config core.fsmonitor .git/hook.sh");
+	Assert.isTrue(pass("src/a.c", NULL) == -1, "The index should not be used without fsmonitor data");
+	tear_down();
+}
+
+//	test cases - entries git cannot vouch for
+static void test_racy_and_flagged_entries(void)
+{
+	set_up(3, 2);
+	// Racy: modified no earlier than the index was written; then assume-unchanged, skip-worktree and intent-to-add
+	set_dirty("src/deep/c.h", sizeof("src/deep/c.h"));
+	run("touch -d '+1 hour' src/deep/c.h && git add src/deep/c.h && echo 'int n;' > src/n.c && touch -d '-1 hour' src/n.c && "
+		"git update-index --assume-unchanged src/a.c && git update-index --skip-worktree src/deep/b.h && git add -N src/n.c && "
+		"echo 'int o;' > src/o.c && touch -d '-1 hour' src/o.c && git add src/o.c");
+	set_dirty("", 0);
+	Assert.isTrue(index_version() == 3, "The index should be at version 3");
+
+	pass("src/a.c", "src/deep/b.h", "src/deep/c.h", "src/n.c", "src/o.c", NULL);
+	int reused = pass("src/a.c", "src/deep/b.h", "src/deep/c.h", "src/n.c", "src/o.c", NULL);
+	Assert.isTrue(reused == 16, "Only the plain entry should be reused, got %x", reused);
+
+	// A conflict leaves its stages in the index
+	run("blob=$(git hash-object -w src/o.c) && git update-index --index-info <<EOF\n"
+		"0 0000000000000000000000000000000000000000\tsrc/o.c\n"
+		"100644 $blob 1\tsrc/o.c\n100644 $blob 2\tsrc/o.c\nEOF");
+	Assert.isTrue(pass("src/o.c", NULL) == 0, "A conflicted entry should be stat'ed");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_git_index_tests(void)
+{
+	testset("git_index_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Index Versions", test_index_versions);
+	testcase("Fsmonitor Lists Changes", test_fsmonitor_lists_changes);
+	testcase("Hook Protocol 1", test_hook_protocol_1);
+	testcase("Daemon Lists Changes", test_daemon_lists_changes);
+	testcase("No Fsmonitor", test_no_fsmonitor);
+	testcase("Racy And Flagged Entries", test_racy_and_flagged_entries);
+}
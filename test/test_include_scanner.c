@@ -0,0 +1,274 @@
+// test_include_scanner.c
+#include "sigtest.h"
+#include "include_scanner.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Test cases for the include scanner over a scratch tree: directives hidden in comments, literals
+ * and continued lines, computed includes, `#include_next` and `#import`, the search order of the
+ * includer's directory, `-iquote`, `-I` and `-include`, and files read again between batches.
+ */
+
+static char tree_dir[64];
+static char test_dir[4096];
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_include_scanner.log", "w");
+}
+
+//	helpers
+static int write_file(const char *name, const char *content)
+{
+	char command[256];
+	snprintf(command, sizeof(command), "mkdir -p $(dirname %s)", name);
+	FILE *file = system(command) == 0 ? fopen(name, "w") : NULL;
+	if (!file)
+		return 0;
+	fputs(content, file);
+	return fclose(file) == 0;
+}
+// Scan one unit of `source` with the given arguments (NULL-terminated); the caller frees the headers
+static char **scan(const char *source, ...)
+{
+	char *args[16];
+	int count = 0;
+	va_list list;
+	va_start(list, source);
+	for (char *arg = va_arg(list, char *); arg && count < 15; arg = va_arg(list, char *))
+		args[count++] = arg;
+	va_end(list);
+	args[count] = NULL;
+
+	char *sources[] = {(char *)source, NULL};
+	scan_unit_s unit = {.sources = sources, .args = args};
+	return IncludeScanner.scan(&unit, 1) == 1 ? unit.headers : NULL;
+}
+static int count_of(char **headers)
+{
+	int count = 0;
+	while (headers && headers[count])
+		count++;
+	return count;
+}
+static int has_header(char **headers, const char *path)
+{
+	for (; headers && *headers; headers++)
+	{
+		if (strcmp(*headers, path) == 0)
+			return 1;
+	}
+	return 0;
+}
+static void set_up(void)
+{
+	if (!getcwd(test_dir, sizeof(test_dir)))
+		test_dir[0] = '\0';
+	strcpy(tree_dir, "/tmp/sbuild_scan_XXXXXX");
+	if (!mkdtemp(tree_dir) || chdir(tree_dir) != 0)
+		tree_dir[0] = '\0';
+}
+static void tear_down(void)
+{
+	IncludeScanner.reset();
+	char command[128];
+	snprintf(command, sizeof(command), "rm -rf %s", tree_dir);
+	if (chdir(test_dir) != 0 || system(command) != 0)
+		tree_dir[0] = '\0';
+}
+
+//	test cases - parsing
+static void test_comments_and_literals(void)
+{
+	set_up();
+	const char *hidden[] = {"no1.h", "no2.h", "no3.h", "no4.h", "no5.h", "no6.h", "yes1.h", "yes2.h", "yes3.h", "yes4.h"};
+	char path[64];
+	for (size_t i = 0; i < sizeof(hidden) / sizeof(hidden[0]); i++)
+	{
+		snprintf(path, sizeof(path), "src/%s", hidden[i]);
+		write_file(path, "");
+	}
+	write_file("src/a.c", "// #include \"no1.h\"\n"
+						  "/* #include \"no2.h\"\n"
+						  "#include \"no3.h\" */\n"
+						  "const char *s = \"\\\"#include \\\"no4.h\\\"\";\n"
+						  "char c = '\"'; int x; #include \"no5.h\"\n"
+						  "#define LONG \\\n"
+						  "#include \"no6.h\"\n"
+						  "  #  include \"yes1.h\"\n"
+						  "#include /* between */ \"yes2.h\" // after\n"
+						  "# \\\n"
+						  "include \\\n"
+						  "\"yes3.h\"\n"
+						  "/* before */ #include <yes4.h>\n");
+
+	// Only real directives count; <yes4.h> is searched in the -I dirs, not next to the includer
+	char **headers = scan("src/a.c", "-Isrc", NULL);
+	Assert.isTrue(headers != NULL, "The unit should be known");
+	Assert.isTrue(has_header(headers, "src/yes1.h") && has_header(headers, "src/yes2.h") && has_header(headers, "src/yes3.h"),
+				  "Directives with spaces, comments and continued lines should be found");
+	Assert.isTrue(has_header(headers, "src/yes4.h"), "A directive after a comment should be found");
+	Assert.isTrue(count_of(headers) == 4, "Comments, literals and continued lines should hide the rest, got %d", count_of(headers));
+	free(headers);
+	tear_down();
+}
+static void test_computed_include(void)
+{
+	set_up();
+	write_file("src/h.h", "#define HEADER \"g.h\"\n#include HEADER\n");
+	write_file("src/a.c", "#include \"h.h\"\n");
+	write_file("src/b.c", "int b;\n");
+
+	// A computed include anywhere in the unit leaves its headers to the compiler
+	char *a_sources[] = {"src/a.c", NULL}, *b_sources[] = {"src/b.c", NULL}, *args[] = {NULL};
+	scan_unit_s units[] = {{.sources = a_sources, .args = args}, {.sources = b_sources, .args = args}};
+	Assert.isTrue(IncludeScanner.scan(units, 2) == 1, "Only the unit without a computed include should be known");
+	Assert.isTrue(units[0].headers == NULL, "The unit with a computed include should be unknown");
+	Assert.isTrue(units[1].headers && count_of(units[1].headers) == 0, "The other unit should have no headers");
+	free(units[1].headers);
+	tear_down();
+}
+static void test_include_next_and_import(void)
+{
+	set_up();
+	write_file("src/a.c", "#include_next <n.h>\n#import \"i.h\"\n");
+	write_file("inc/n.h", "#include \"deep.h\"\n");
+	write_file("inc/deep.h", "");
+	write_file("src/i.h", "");
+
+	char **headers = scan("src/a.c", "-I", "inc", NULL);
+	Assert.isTrue(has_header(headers, "inc/n.h") && has_header(headers, "src/i.h"),
+				  "#include_next and #import should be followed");
+	Assert.isTrue(has_header(headers, "inc/deep.h"), "Headers they include should be followed too");
+	Assert.isTrue(count_of(headers) == 3, "Three headers should be found, got %d", count_of(headers));
+	free(headers);
+	tear_down();
+}
+
+//	test cases - search order
+static void test_search_order(void)
+{
+	set_up();
+	write_file("src/a.c", "#include \"h.h\"\n#include <h.h>\n#include <sys.h>\n#include \"missing.h\"\n");
+	write_file("other/b.c", "#include \"h.h\"\n#include \"q.h\"\n");
+	write_file("src/h.h", "");
+	write_file("quote/h.h", "");
+	write_file("quote/q.h", "");
+	write_file("inc/h.h", "");
+	write_file("inc/q.h", "");
+	write_file("inc/g.h", "");
+	write_file("system/sys.h", "");
+	write_file("f.h", "");
+
+	// "name": the includer's directory first; <name>: the -I dirs only; system dirs and missing names are left out
+	char **headers = scan("src/a.c", "-iquote", "quote", "-Iinc", "-isystem", "system", NULL);
+	Assert.isTrue(has_header(headers, "src/h.h") && has_header(headers, "inc/h.h") && count_of(headers) == 2,
+				  "\"h.h\" should resolve next to the includer and <h.h> in -I, got %d header(s)", count_of(headers));
+	free(headers);
+
+	// Without it next to the includer, -iquote comes before -I
+	headers = scan("other/b.c", "-Iinc", "-iquote", "quote", NULL);
+	Assert.isTrue(has_header(headers, "quote/h.h") && has_header(headers, "quote/q.h") && count_of(headers) == 2,
+				  "-iquote should be searched before -I");
+	free(headers);
+
+	// -include is searched from the working directory, then along the search path
+	headers = scan("other/b.c", "-include", "f.h", "-include", "g.h", "-I", "inc/", NULL);
+	Assert.isTrue(has_header(headers, "f.h") && has_header(headers, "inc/g.h"), "Forced includes should be listed");
+	Assert.isTrue(has_header(headers, "inc/h.h") && has_header(headers, "inc/q.h") && count_of(headers) == 4,
+				  "The unit's own includes should follow -I");
+	free(headers);
+	tear_down();
+}
+
+//	test cases - batches
+static void test_rereads_between_batches(void)
+{
+	set_up();
+	write_file("src/a.c", "#include \"h.h\"\n");
+	write_file("src/h.h", "#include \"late.h\"\n");
+	char **headers = scan("src/a.c", NULL);
+	Assert.isTrue(count_of(headers) == 1 && has_header(headers, "src/h.h"), "A missing header should be left out");
+	free(headers);
+
+	// Resolutions hold for one batch: a header added since is found
+	write_file("src/late.h", "");
+	headers = scan("src/a.c", NULL);
+	Assert.isTrue(count_of(headers) == 2 && has_header(headers, "src/late.h"), "The added header should be found");
+	free(headers);
+
+	// A file whose size or mtime moved is read again
+	write_file("src/h.h", "#include \"late.h\"\n#include \"new.h\"\n");
+	write_file("src/new.h", "");
+	headers = scan("src/a.c", NULL);
+	Assert.isTrue(count_of(headers) == 3 && has_header(headers, "src/new.h"), "The edited header should be read again");
+	free(headers);
+
+	// One whose metadata did not move keeps its parse
+	Assert.isTrue(system("touch -r src/h.h src/a.c.stamp && printf '#include \"gone.h\"\\n#include \"new.h\"\\n' > src/h.h && "
+						 "touch -r src/a.c.stamp src/h.h") == 0,
+				  "The header should be rewritten in place");
+	write_file("src/gone.h", "");
+	headers = scan("src/a.c", NULL);
+	Assert.isTrue(count_of(headers) == 3 && !has_header(headers, "src/gone.h"), "An unchanged header should not be read again");
+	free(headers);
+
+	// A reset forgets every file
+	IncludeScanner.reset();
+	headers = scan("src/a.c", NULL);
+	Assert.isTrue(count_of(headers) == 3 && has_header(headers, "src/gone.h"), "After a reset the header should be read again");
+	free(headers);
+	tear_down();
+}
+static void test_parallel_units(void)
+{
+	set_up();
+	enum { UNIT_COUNT = 40 };
+	char names[UNIT_COUNT][32], content[64];
+	char *sources[UNIT_COUNT][2], *args[] = {"-Iinc", NULL};
+	scan_unit_s units[UNIT_COUNT];
+	write_file("inc/common.h", "#include \"shared.h\"\n");
+	write_file("inc/shared.h", "");
+	for (int i = 0; i < UNIT_COUNT; i++)
+	{
+		snprintf(names[i], sizeof(names[i]), "src/u%d.c", i);
+		snprintf(content, sizeof(content), "#include <common.h>\n#include \"u%d.h\"\n", i);
+		write_file(names[i], content);
+		snprintf(content, sizeof(content), "src/u%d.h", i);
+		write_file(content, "#include <shared.h>\n");
+		sources[i][0] = names[i];
+		sources[i][1] = NULL;
+		units[i] = (scan_unit_s){.sources = sources[i], .args = args};
+	}
+
+	// Units are spread over the threads; each lists its own header once and the shared ones
+	Assert.isTrue(IncludeScanner.scan(units, UNIT_COUNT) == UNIT_COUNT, "Every unit should be known");
+	int is_listed = 1;
+	for (int i = 0; i < UNIT_COUNT; i++)
+	{
+		snprintf(content, sizeof(content), "src/u%d.h", i);
+		is_listed = is_listed && count_of(units[i].headers) == 3 && has_header(units[i].headers, content) &&
+					has_header(units[i].headers, "inc/common.h") && has_header(units[i].headers, "inc/shared.h");
+		free(units[i].headers);
+	}
+	Assert.isTrue(is_listed, "Every unit should list its three headers");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_include_scanner_tests(void)
+{
+	testset("include_scanner_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Comments And Literals", test_comments_and_literals);
+	testcase("Computed Include", test_computed_include);
+	testcase("Include Next And Import", test_include_next_and_import);
+	testcase("Search Order", test_search_order);
+	testcase("Rereads Between Batches", test_rereads_between_batches);
+	testcase("Parallel Units", test_parallel_units);
+}
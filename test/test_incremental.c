@@ -0,0 +1,136 @@
+// test_incremental.c
+#include "sigtest.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Behaviour tests for incremental rebuilds, run against bin/sbuild in a scratch project:
+ * a static library replaces only the member that changed, and a rebuilt object identical to
+ * the previous one stops the rebuild there (early cutoff).
+ */
+
+#define PROJECT_CONFIG                                                                                       \
+	"{\"name\": \"incremental\", \"build_dir\": \"o/\", \"default_target\": \"m\", \"targets\": [\n"          \
+	" {\"name\": \"l\", \"type\": \"lib\", \"kind\": \"static\", \"sources\": [\"src/a.c\", \"src/b.c\"],\n"  \
+	"  \"build_dir\": \"o/\", \"out_dir\": \"o/\", \"compiler\": \"gcc\", \"compiler_flags\": [\"-c\"],\n"     \
+	"  \"output\": \"libl.a\"},\n"                                                                           \
+	" {\"name\": \"m\", \"type\": \"exe\", \"sources\": [\"src/m.c\"], \"build_dir\": \"o/\", \"out_dir\": \"o/\",\n" \
+	"  \"compiler\": \"gcc\", \"compiler_flags\": [\"-c\"],\n"                                                 \
+	"  \"linker_flags\": [\"-Wl,--undefined=a,--undefined=b\", \"-Lo\", \"-ll\"],\n"                         \
+	"  \"dependencies\": [\"l\"], \"output\": \"m\"}]}\n"
+
+static char sbuild[4096];
+static char project_dir[64];
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_incremental.log", "w");
+	if (!getcwd(sbuild, sizeof(sbuild) - 16))
+		sbuild[0] = '\0';
+	strcat(sbuild, "/bin/sbuild");
+}
+
+//	helpers
+static int write_file(const char *name, const char *content)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", project_dir, name);
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return 0;
+	fputs(content, file);
+	return fclose(file) == 0;
+}
+static int run(const char *format, ...)
+{
+	char command[8192], line[4096];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	snprintf(command, sizeof(command), "cd %s && %s", project_dir, line);
+	return system(command);
+}
+// Build the project; its output goes to `log_name`
+static int build(const char *log_name)
+{
+	return run("%s --build build.json --log=2 > %s 2>&1", sbuild, log_name);
+}
+// Check whether a build's output has a line containing `text` (and `also`, if given)
+static int is_logged(const char *log_name, const char *text, const char *also)
+{
+	char path[256], line[4096];
+	snprintf(path, sizeof(path), "%s/%s", project_dir, log_name);
+	FILE *file = fopen(path, "r");
+	int is_found = 0;
+	while (file && !is_found && fgets(line, sizeof(line), file))
+		is_found = strstr(line, text) && (!also || strstr(line, also));
+	if (file)
+		fclose(file);
+	return is_found;
+}
+static void set_up(void)
+{
+	strcpy(project_dir, "/tmp/sbuild_incremental_XXXXXX");
+	if (!mkdtemp(project_dir) || run("mkdir src") != 0)
+		return;
+	write_file("build.json", PROJECT_CONFIG);
+	write_file("src/a.c", "int a(void) { return 1; }\n");
+	write_file("src/b.c", "int b(void) { return 2; }\n");
+	write_file("src/m.c", "int main(void) { return 0; }\n");
+}
+static void tear_down(void)
+{
+	run("cd / && rm -rf %s", project_dir);
+}
+
+//	test cases - static libraries
+static void test_archive_member_update(void)
+{
+	set_up();
+	Assert.isTrue(build("first.log") == 0, "First build should succeed");
+
+	// Only the changed member is replaced; the other stays in the archive untouched
+	write_file("src/a.c", "int a(void) { return 5; }\n");
+	Assert.isTrue(build("second.log") == 0, "Rebuild should succeed");
+	Assert.isTrue(is_logged("second.log", "Executing: ar ", "o/src_a.o"), "The changed member should be archived");
+	Assert.isFalse(is_logged("second.log", "Executing: ar ", "o/src_b.o"), "The unchanged member should not be archived again");
+	Assert.isTrue(run("test \"$(ar t o/libl.a | sort | tr '\\n' ' ')\" = 'src_a.o src_b.o '") == 0,
+				  "The archive should hold both members once");
+	Assert.isTrue(run("ar p o/libl.a src_a.o | cmp -s - o/src_a.o") == 0, "The archive should hold the new object");
+	Assert.isTrue(is_logged("second.log", "Executing: ", "-o o/m.tmp"), "The executable should be relinked");
+	tear_down();
+}
+
+//	test cases - early cutoff
+static void test_unchanged_output_skips_dependents(void)
+{
+	set_up();
+	Assert.isTrue(build("first.log") == 0, "First build should succeed");
+
+	// A comment leaves the object byte-identical: the archive and the link are not run again
+	write_file("src/a.c", "int a(void) { return 1; }\n/* comment only */\n");
+	Assert.isTrue(build("second.log") == 0, "Rebuild should succeed");
+	Assert.isTrue(is_logged("second.log", "Executing: ", "src/a.c"), "The edited source should be compiled");
+	Assert.isTrue(is_logged("second.log", "o/src_a.o unchanged", NULL), "The object should be found unchanged");
+	Assert.isFalse(is_logged("second.log", "Executing: ar ", NULL), "The archive should not be updated");
+	Assert.isFalse(is_logged("second.log", "Executing: ", "-o o/m.tmp"), "The executable should not be relinked");
+
+	// Nothing is left to do afterwards
+	Assert.isTrue(build("third.log") == 0, "Third build should succeed");
+	Assert.isFalse(is_logged("third.log", "Executing: ", NULL), "Nothing should run again");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_incremental_tests(void)
+{
+	testset("incremental_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Archive Member Update", test_archive_member_update);
+	testcase("Unchanged Output Skips Dependents", test_unchanged_output_skips_dependents);
+}
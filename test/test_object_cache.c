@@ -0,0 +1,163 @@
+// test_object_cache.c
+#include "sigtest.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Behaviour tests for the object cache, run against bin/sbuild in scratch projects: the same
+ * tree checked out in two directories shares its cache entries, debug info included, also when
+ * headers are found through absolute paths into the checkout and into each user's home.
+ */
+
+#define HOME_PROJECT_CONFIG                                                                                    \
+	"{\"name\": \"cached\", \"build_dir\": \"o/\", \"default_target\": \"m\", \"targets\": [\n"                \
+	" {\"name\": \"m\", \"type\": \"exe\", \"sources\": [\"src/m.c\"], \"build_dir\": \"o/\", \"out_dir\": \"o/\",\n"  \
+	"  \"compiler\": \"gcc\", \"compiler_flags\": [\"-g\", \"-c\", \"-I%s/include\", \"-I%s/sdk\"],\n"              \
+	"  \"output\": \"m\"}]}\n"
+
+#define PROJECT_CONFIG                                                                                        \
+	"{\"name\": \"cached\", \"build_dir\": \"o/\", \"default_target\": \"m\", \"targets\": [\n"               \
+	" {\"name\": \"m\", \"type\": \"exe\", \"sources\": [\"src/m.c\"], \"build_dir\": \"o/\", \"out_dir\": \"o/\",\n" \
+	"  \"compiler\": \"gcc\", \"compiler_flags\": [\"-g\", \"-c\", \"-Iinclude\"], \"output\": \"m\"}]}\n"
+
+static char sbuild[4096];
+static char scratch_dir[64];
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_object_cache.log", "w");
+	if (!getcwd(sbuild, sizeof(sbuild) - 16))
+		sbuild[0] = '\0';
+	strcat(sbuild, "/bin/sbuild");
+}
+
+//	helpers
+static int write_file(const char *name, const char *content)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", scratch_dir, name);
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return 0;
+	fputs(content, file);
+	return fclose(file) == 0;
+}
+static int run(const char *format, ...)
+{
+	char command[8192], line[4096];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	snprintf(command, sizeof(command), "cd %s && %s", scratch_dir, line);
+	return system(command);
+}
+// Build a checkout with the scratch cache; its output goes to `<checkout>/build.log`
+static int build(const char *checkout)
+{
+	return run("cd %s && %s --build build.json --cache=%s/cache --log=2 > build.log 2>&1", checkout, sbuild, scratch_dir);
+}
+// Build a checkout as a user whose home is `home` (in the scratch directory)
+static int build_as(const char *home, const char *checkout)
+{
+	return run("cd %s && HOME=%s/%s %s --build build.json --cache=%s/cache --log=2 > build.log 2>&1", checkout, scratch_dir,
+			   home, sbuild, scratch_dir);
+}
+// Check whether a checkout's build output has a line containing `text`
+static int is_logged(const char *checkout, const char *text)
+{
+	char path[256], line[4096];
+	snprintf(path, sizeof(path), "%s/%s/build.log", scratch_dir, checkout);
+	FILE *file = fopen(path, "r");
+	int is_found = 0;
+	while (file && !is_found && fgets(line, sizeof(line), file))
+		is_found = strstr(line, text) != NULL;
+	if (file)
+		fclose(file);
+	return is_found;
+}
+// Lay out one checkout of the project
+static void write_checkout(const char *checkout)
+{
+	char name[128];
+	run("mkdir -p %s/src %s/include", checkout, checkout);
+	snprintf(name, sizeof(name), "%s/build.json", checkout);
+	write_file(name, PROJECT_CONFIG);
+	snprintf(name, sizeof(name), "%s/include/h.h", checkout);
+	write_file(name, "#define K 3\n");
+	snprintf(name, sizeof(name), "%s/src/m.c", checkout);
+	write_file(name, "#include \"h.h\"\nint f(void) { return K; }\nint main(void) { return f() - K; }\n");
+}
+// Lay out a user's home with an SDK header and a checkout of the project including it by absolute path
+static void write_home_checkout(const char *home)
+{
+	char name[256], checkout[128], content[1024];
+	snprintf(checkout, sizeof(checkout), "%s/repos/project", home);
+	write_checkout(checkout);
+	run("mkdir -p %s/sdk", home);
+	snprintf(name, sizeof(name), "%s/sdk/sdk.h", home);
+	write_file(name, "#define SDK 4\n");
+	snprintf(name, sizeof(name), "%s/src/m.c", checkout);
+	write_file(name, "#include \"h.h\"\n#include \"sdk.h\"\nint f(void) { return K + SDK; }\nint main(void) { return f() - 7; }\n");
+	char checkout_dir[256], home_dir[256];
+	snprintf(checkout_dir, sizeof(checkout_dir), "%s/%s", scratch_dir, checkout);
+	snprintf(home_dir, sizeof(home_dir), "%s/%s", scratch_dir, home);
+	snprintf(content, sizeof(content), HOME_PROJECT_CONFIG, checkout_dir, home_dir);
+	snprintf(name, sizeof(name), "%s/build.json", checkout);
+	write_file(name, content);
+}
+static void set_up(void)
+{
+	strcpy(scratch_dir, "/tmp/sbuild_cache_XXXXXX");
+	if (!mkdtemp(scratch_dir))
+		scratch_dir[0] = '\0';
+}
+static void tear_down(void)
+{
+	run("cd / && rm -rf %s", scratch_dir);
+}
+
+//	test cases - sharing between checkouts
+static void test_second_checkout_hits(void)
+{
+	set_up();
+	write_checkout("first");
+	write_checkout("second");
+
+	// Built with -g, the units would name their checkout's directory
+	Assert.isTrue(build("first") == 0, "The first checkout should build");
+	Assert.isTrue(is_logged("first", "Object cache: 0 hit(s), 2 miss(es)"), "The first checkout should fill the cache");
+	Assert.isTrue(build("second") == 0, "The second checkout should build");
+	Assert.isTrue(is_logged("second", "o/src_m.o taken from the object cache"), "The compile should hit");
+	Assert.isTrue(is_logged("second", "Object cache: 2 hit(s), 0 miss(es)"), "The compile and the link should hit");
+	Assert.isTrue(run("cmp -s first/o/m second/o/m") == 0, "Both checkouts should hold the same executable");
+	tear_down();
+}
+
+static void test_checkouts_in_other_homes_hit(void)
+{
+	set_up();
+	write_home_checkout("alice");
+	write_home_checkout("bob");
+
+	// Line markers name h.h under each checkout and sdk.h under each home, both by absolute path
+	Assert.isTrue(build_as("alice", "alice/repos/project") == 0, "Alice's checkout should build");
+	Assert.isTrue(build_as("bob", "bob/repos/project") == 0, "Bob's checkout should build");
+	Assert.isTrue(is_logged("bob/repos/project", "Object cache: 2 hit(s), 0 miss(es)"), "Bob's build should hit");
+	Assert.isTrue(run("cmp -s alice/repos/project/o/src_m.o bob/repos/project/o/src_m.o") == 0,
+				  "Both checkouts should hold the same object");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_object_cache_tests(void)
+{
+	testset("object_cache_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Second Checkout Hits", test_second_checkout_hits);
+	testcase("Checkouts In Other Homes Hit", test_checkouts_in_other_homes_hit);
+}
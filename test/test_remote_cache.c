@@ -0,0 +1,308 @@
+// test_remote_cache.c
+#include "sigtest.h"
+#include "remote_cache.h"
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Integration tests for the remote cache against `bin/sbuild --cache-server` on an ephemeral
+ * port: objects round-trip through HEAD, GET and PUT on kept-alive connections, compressed with
+ * zstd when libzstd is installed; entries that do not match their digest are misses and are
+ * replaced; queued uploads are finished before the cache closes, and before a build exits.
+ */
+
+#define PROJECT_CONFIG                                                                                        \
+	"{\"name\": \"remote\", \"build_dir\": \"o/\", \"default_target\": \"m\", \"targets\": [\n"               \
+	" {\"name\": \"m\", \"type\": \"exe\", \"sources\": [\"src/m.c\"], \"build_dir\": \"o/\", \"out_dir\": \"o/\",\n" \
+	"  \"compiler\": \"gcc\", \"compiler_flags\": [\"-c\"], \"output\": \"m\"}]}\n"
+#define ENTRY_HEADER_SIZE 24 // Magic, codec, permissions, object size, object digest
+#define UPLOAD_COUNT 16
+
+static char sbuild[4096];
+static char scratch_dir[64];
+static char url[128];
+static pid_t server_pid = -1;
+
+static void set_config(FILE **log_stream)
+{
+	*log_stream = fopen("logs/test_remote_cache.log", "w");
+	if (!getcwd(sbuild, sizeof(sbuild) - 16))
+		sbuild[0] = '\0';
+	strcat(sbuild, "/bin/sbuild");
+	// The remote cache logs through the application context; keep it quiet
+	char *args[] = {"sbuild", "--log=0", NULL};
+	App.init(2, args);
+}
+
+//	helpers
+static int run(const char *format, ...)
+{
+	char command[8192], line[4096];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	snprintf(command, sizeof(command), "cd %s && %s", scratch_dir, line);
+	return system(command);
+}
+// Path of a file in the scratch directory
+static const char *path_of(const char *name)
+{
+	static char paths[4][256];
+	static int next = 0;
+	char *path = paths[next++ % 4];
+	snprintf(path, sizeof(paths[0]), "%s/%s", scratch_dir, name);
+	return path;
+}
+// Path of the file the server keeps an entry in
+static const char *entry_of(const char *key)
+{
+	char name[256];
+	snprintf(name, sizeof(name), "served/%.2s/%s", key, key + 2);
+	return path_of(name);
+}
+static long size_of(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+// Read a byte of a file
+static int byte_at(const char *path, long offset)
+{
+	FILE *file = fopen(path, "r");
+	int byte = file && fseek(file, offset, SEEK_SET) == 0 ? fgetc(file) : EOF;
+	if (file)
+		fclose(file);
+	return byte;
+}
+// Flip a byte of a file in place
+static int flip_byte(const char *path, long offset)
+{
+	int byte = byte_at(path, offset);
+	FILE *file = byte == EOF ? NULL : fopen(path, "r+");
+	int is_flipped = file && fseek(file, offset, SEEK_SET) == 0 && fputc(byte ^ 0xff, file) != EOF;
+	if (file)
+		is_flipped = fclose(file) == 0 && is_flipped;
+	return is_flipped;
+}
+// Reopen the remote cache: the uploads queued so far are finished first
+static void reopen(void)
+{
+	RemoteCache.close();
+	RemoteCache.open(url);
+}
+// Find a port no one listens on (the kernel's choice of an ephemeral one)
+static int free_port(void)
+{
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+	socklen_t len = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0), port = 0;
+	if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && getsockname(fd, (struct sockaddr *)&addr, &len) == 0)
+		port = ntohs(addr.sin_port);
+	if (fd >= 0)
+		close(fd);
+	return port;
+}
+// Wait until the server accepts connections
+static int is_listening(int port)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		int is_connected = fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+		if (fd >= 0)
+			close(fd);
+		if (is_connected)
+			return 1;
+		usleep(50000);
+	}
+	return 0;
+}
+// Start a cache server over `served` and open the remote cache on it
+static void set_up(void)
+{
+	strcpy(scratch_dir, "/tmp/sbuild_remote_XXXXXX");
+	if (!mkdtemp(scratch_dir))
+		scratch_dir[0] = '\0';
+	int port = free_port();
+	char port_arg[64], dir_arg[128];
+	snprintf(port_arg, sizeof(port_arg), "--cache-server=%d", port);
+	snprintf(dir_arg, sizeof(dir_arg), "--cache=%s/served", scratch_dir);
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/cache", port);
+	fflush(NULL);
+	if ((server_pid = fork()) == 0)
+	{
+		FILE *log = freopen(path_of("server.log"), "w", stdout);
+		if (log)
+			dup2(fileno(log), STDERR_FILENO);
+		execl(sbuild, sbuild, port_arg, dir_arg, (char *)NULL);
+		_exit(127);
+	}
+	Assert.isTrue(server_pid > 0 && is_listening(port), "The cache server should listen on port %d", port);
+	Assert.isTrue(RemoteCache.open(url), "The remote cache should open");
+}
+static void tear_down(void)
+{
+	RemoteCache.close();
+	if (server_pid > 0)
+	{
+		kill(server_pid, SIGTERM);
+		waitpid(server_pid, NULL, 0);
+	}
+	server_pid = -1;
+	run("cd / && rm -rf %s", scratch_dir);
+}
+
+//	test cases - entries
+static void test_round_trip(void)
+{
+	set_up();
+	run("seq 1 20000 > object && chmod 755 object");
+
+	// HEAD finds nothing before the upload, GET then downloads on the same kept-alive connection
+	Assert.isFalse(RemoteCache.contains("ab0123456789"), "The entry should not exist yet");
+	Assert.isTrue(RemoteCache.store("ab0123456789", path_of("object")), "The object should be queued");
+	reopen();
+	Assert.isTrue(RemoteCache.contains("ab0123456789"), "HEAD should find the entry");
+	Assert.isTrue(RemoteCache.contains("ab0123456789"), "A second HEAD should find it on the same connection");
+	Assert.isTrue(RemoteCache.fetch("ab0123456789", path_of("fetched")), "GET after HEAD should download the entry");
+	Assert.isTrue(run("cmp -s object fetched") == 0, "The fetched object should be identical");
+	Assert.isTrue(run("test \"$(stat -c %%a fetched)\" = 755") == 0, "The object's permissions should be kept");
+
+	// An upload checks with HEAD first: an entry the server holds is not sent again
+	run("echo other > other");
+	Assert.isTrue(RemoteCache.store("ab0123456789", path_of("other")), "The other object should be queued");
+	reopen();
+	Assert.isTrue(RemoteCache.fetch("ab0123456789", path_of("fetched")) && run("cmp -s object fetched") == 0,
+				  "The held entry should not be replaced");
+
+	// A missing entry is a miss that leaves no file
+	Assert.isFalse(RemoteCache.fetch("cd0123456789", path_of("missing")), "A missing entry should be a miss");
+	Assert.isTrue(size_of(path_of("missing")) < 0, "A miss should leave no file");
+	tear_down();
+}
+static void test_zstd_entries(void)
+{
+	set_up();
+	void *lib = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+	int has_zstd = lib != NULL;
+	if (lib)
+		dlclose(lib);
+	run("seq 1 50000 > text && head -c 65536 /dev/urandom > noise");
+	RemoteCache.store("aa0000000001", path_of("text"));
+	RemoteCache.store("aa0000000002", path_of("noise"));
+	reopen();
+
+	// Compressible objects are stored compressed when libzstd is installed; noise never is
+	const char *text_entry = entry_of("aa0000000001"), *noise_entry = entry_of("aa0000000002");
+	Assert.isTrue(byte_at(text_entry, 4) == has_zstd, "The text should be stored %s", has_zstd ? "with zstd" : "plain");
+	Assert.isTrue(!has_zstd || size_of(text_entry) < size_of(path_of("text")) / 2, "The compressed entry should be smaller");
+	Assert.isTrue(byte_at(noise_entry, 4) == 0 && size_of(noise_entry) == 65536 + ENTRY_HEADER_SIZE,
+				  "Noise should be stored plain");
+	Assert.isTrue(RemoteCache.fetch("aa0000000001", path_of("text.out")) && run("cmp -s text text.out") == 0,
+				  "The compressed entry should decompress to the object");
+	Assert.isTrue(RemoteCache.fetch("aa0000000002", path_of("noise.out")) && run("cmp -s noise noise.out") == 0,
+				  "The plain entry should round-trip");
+	tear_down();
+}
+static void test_corrupt_entry_rejected(void)
+{
+	set_up();
+	run("head -c 4096 /dev/urandom > noise && seq 1 5000 > text");
+	RemoteCache.store("bb0000000001", path_of("noise"));
+	RemoteCache.store("bb0000000002", path_of("text"));
+	reopen();
+
+	// A damaged object, or a damaged digest, does not match: a miss leaving no file
+	Assert.isTrue(flip_byte(entry_of("bb0000000001"), ENTRY_HEADER_SIZE + 100), "The stored object should be damaged");
+	Assert.isTrue(RemoteCache.contains("bb0000000001"), "HEAD alone cannot tell the entry is corrupt");
+	Assert.isFalse(RemoteCache.fetch("bb0000000001", path_of("noise.out")), "A damaged object should be rejected");
+	Assert.isTrue(size_of(path_of("noise.out")) < 0, "A rejected entry should leave no file");
+	Assert.isTrue(flip_byte(entry_of("bb0000000002"), 16), "The stored digest should be damaged");
+	Assert.isFalse(RemoteCache.fetch("bb0000000002", path_of("text.out")), "An object not matching its digest should be rejected");
+
+	// Storing the object again replaces the corrupt entry, though HEAD finds one
+	long damaged_size = size_of(entry_of("bb0000000001"));
+	Assert.isTrue(RemoteCache.store("bb0000000001", path_of("noise")), "The object should be queued again");
+	reopen();
+	Assert.isTrue(size_of(entry_of("bb0000000001")) == damaged_size, "The entry should keep its size");
+	Assert.isTrue(RemoteCache.fetch("bb0000000001", path_of("noise.out")) && run("cmp -s noise noise.out") == 0,
+				  "The replaced entry should be a hit");
+	tear_down();
+}
+
+//	test cases - uploads
+static void test_uploads_drain_at_close(void)
+{
+	set_up();
+	run("head -c 524288 /dev/urandom > object");
+
+	// Closing waits for every queued upload
+	char key[32];
+	int is_queued = 1;
+	for (int i = 0; i < UPLOAD_COUNT; i++)
+	{
+		snprintf(key, sizeof(key), "dd%010d", i);
+		is_queued = is_queued && RemoteCache.store(key, path_of("object"));
+	}
+	Assert.isTrue(is_queued, "Every object should be queued");
+	RemoteCache.close();
+	int stored = 0;
+	for (int i = 0; i < UPLOAD_COUNT; i++)
+	{
+		snprintf(key, sizeof(key), "dd%010d", i);
+		stored += size_of(entry_of(key)) == 524288 + ENTRY_HEADER_SIZE;
+	}
+	Assert.isTrue(stored == UPLOAD_COUNT, "Every upload should be finished at close, got %d", stored);
+	tear_down();
+}
+static void test_builds_share_through_server(void)
+{
+	set_up();
+	FILE *file = NULL;
+	for (int i = 0; i < 2; i++)
+	{
+		const char *checkout = i == 0 ? "first" : "second";
+		run("mkdir -p %s/src && echo 'int main(void) { return 0; }' > %s/src/m.c", checkout, checkout);
+		char name[64];
+		snprintf(name, sizeof(name), "%s/build.json", checkout);
+		if ((file = fopen(path_of(name), "w")))
+		{
+			fputs(PROJECT_CONFIG, file);
+			fclose(file);
+		}
+	}
+
+	// The first build's uploads are finished before it exits; the second, without a local cache, hits them
+	Assert.isTrue(run("cd first && %s --build build.json --remote-cache=%s --log=2 > build.log 2>&1", sbuild, url) == 0,
+				  "The first checkout should build");
+	Assert.isTrue(run("test $(find served -type f | wc -l) -eq 2") == 0, "The compile and the link should be uploaded by exit");
+	Assert.isTrue(run("cd second && %s --build build.json --remote-cache=%s --log=2 > build.log 2>&1", sbuild, url) == 0,
+				  "The second checkout should build");
+	Assert.isTrue(run("grep -q 'Object cache: 2 hit(s), 0 miss(es)' second/build.log") == 0, "The second build should hit");
+	Assert.isTrue(run("cmp -s first/o/m second/o/m") == 0, "Both checkouts should hold the same executable");
+	tear_down();
+}
+
+// Register test cases
+__attribute__((constructor)) void init_remote_cache_tests(void)
+{
+	testset("remote_cache_set", set_config, NULL);
+	writelnf("Test Source: %s", __FILE__);
+
+	testcase("Round Trip", test_round_trip);
+	testcase("Zstd Entries", test_zstd_entries);
+	testcase("Corrupt Entry Rejected", test_corrupt_entry_rejected);
+	testcase("Uploads Drain At Close", test_uploads_drain_at_close);
+	testcase("Builds Share Through Server", test_builds_share_through_server);
+}